@@ -10,15 +10,20 @@
    - Misc functions/constants: RND(), INT(), SGN(), PI, LEN(), ASC(), VAL(), CHR$(), STR$()
    - RT-11-style helpers usable in expressions: POS(hay$,needle$), TAB(n) (returns n), SEG$(s$,start,len), TRM$(s$)
    Notes:
-   - String-returning funcs in numeric context coerce via atof("") per existing interpreter behavior.
+   - Expressions evaluate to a typed Value (parse.h): a number, or a string held as a
+     pointer + length into its source, copied only when the bytes change. '+' joins text
+     when either side is a string, two strings compare by bytes, and a string used as a
+     number (parse_rel, arithmetic) goes through atof once, where it is consumed.
 
    Created by Yuri Starikov with ChatGPT 5.0
 */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <ctype.h>
+#include <limits.h>
 
 #include "runtime.h"
 #include "parse.h"
@@ -33,19 +38,129 @@ void lx_init(Lexer*lx,const char*s)
     lx->s=s ? s : "";
     lx->i=0; 
     lx->cur.type=T_END; 
-    lx->cur.text[0]=0; 
+    lx->cur.text=""; 
+    lx->cur.len=0; 
     lx->cur.number=0.0; 
+    lx->tk=NULL;
+    lx->pool=NULL;
+}
+
+/* Position the lexer on statement 'seg' of a crunched line; tokens are replayed, not re-scanned */
+void lx_init_crunched(Lexer* lx, const CrunchLine* cl, int seg)
+{
+    lx_init(lx, cl->pool + cl->segs[seg].src);
+    lx->tk = cl->toks + cl->segs[seg].first;
+    lx->pool = cl->pool;
+}
+
+/* Keywords: perfect hash, one probe per identifier.
+   The hash folds case with & 0xDF (exact for letters; keywords are letters only) and is
+   computed while the identifier is scanned. The slots below were generated offline for
+   this hash; when adding a keyword, regenerate them (any multiplier that keeps every
+   keyword in its own slot will do) - lx_kw_selftest reports collisions. */
+#define KW_SLOTS 128
+#define KW_HASH_STEP(h, c) ((h) * 67215u + ((unsigned)(c) & 0xDFu))
+#define KW_HASH_SLOT(h) (((h) ^ ((h) >> 16)) & (KW_SLOTS - 1))
+
+typedef struct { const char* kw; size_t len; TokType type; } KwEntry;
+
+static const KwEntry g_kw[KW_SLOTS] = {
+    [  0] = { "OFF", 3, T_OFF },
+    [  3] = { "DEFINT", 6, T_DEFINT },
+    [  5] = { "END", 3, T_ENDKW },
+    [  6] = { "PRINT", 5, T_PRINT },
+    [  8] = { "DATA", 4, T_DATA },
+    [ 11] = { "NEXT", 4, T_NEXT },
+    [ 18] = { "QUIT", 4, T_QUIT },
+    [ 19] = { "NOT", 3, T_NOT },
+    [ 28] = { "RENUM", 5, T_RENUM },
+    [ 31] = { "STEP", 4, T_STEP },
+    [ 32] = { "READ", 4, T_READ },
+    [ 33] = { "XOR", 3, T_XOR },
+    [ 34] = { "OR", 2, T_OR },
+    [ 39] = { "GOSUB", 5, T_GOSUB },
+    [ 41] = { "TRACE", 5, T_TRACE },
+    [ 46] = { "AND", 3, T_AND },
+    [ 49] = { "FOR", 3, T_FOR },
+    [ 52] = { "SAVE", 4, T_SAVE },
+    [ 53] = { "OUTPUT", 6, T_OUTPUTKW },
+    [ 55] = { "GOTO", 4, T_GOTO },
+    [ 56] = { "CLOSE", 5, T_CLOSE },
+    [ 57] = { "SAVEVARS", 8, T_SAVEVARS },
+    [ 60] = { "ELSE", 4, T_ELSE },
+    [ 62] = { "ON", 2, T_ONKW },
+    [ 63] = { "INPUT", 5, T_INPUT },
+    [ 64] = { "REM", 3, T_REM },
+    [ 66] = { "HELP", 4, T_HELP },
+    [ 69] = { "THEN", 4, T_THEN },
+    [ 71] = { "IF", 2, T_IF },
+    [ 77] = { "APPEND", 6, T_APPEND },
+    [ 78] = { "LOAD", 4, T_LOAD },
+    [ 79] = { "RESTORE", 7, T_RESTORE },
+    [ 80] = { "BYE", 3, T_BYE },
+    [ 84] = { "RETURN", 6, T_RETURN },
+    [ 85] = { "VARS", 4, T_VARS },
+    [ 88] = { "LET", 3, T_LET },
+    [ 90] = { "LIST", 4, T_LIST },
+    [ 96] = { "AS", 2, T_AS },
+    [ 97] = { "RUN", 3, T_RUN },
+    [ 99] = { "OPEN", 4, T_OPEN },
+    [102] = { "STACK", 5, T_STACK },
+    [105] = { "ARRAYS", 6, T_ARRAYS },
+    [107] = { "DUMP", 4, T_DUMP },
+    [109] = { "TO", 2, T_TO },
+    [117] = { "NEW", 3, T_NEW },
+    [119] = { "DIM", 3, T_DIM },
+    [123] = { "LINE", 4, T_LINE },
+    [125] = { "LOADVARS", 8, T_LOADVARS },
+    [127] = { "STOP", 4, T_STOP },
+};
+
+static int kw_match(const char* kw, const char* s, size_t len) {
+    size_t i;
+    for (i = 0; i < len; i++) if (kw[i] != (char)toupper((unsigned char)s[i])) return 0;
+    return 1;
+}
+
+/* 0 if every keyword in g_kw hashes to its own slot */
+int lx_kw_selftest(void) {
+    int i, bad = 0;
+    for (i = 0; i < KW_SLOTS; i++) {
+        const char* p;
+        unsigned h = 0;
+        if (!g_kw[i].kw) continue;
+        for (p = g_kw[i].kw; *p; p++) h = KW_HASH_STEP(h, (unsigned char)*p);
+        if ((int)KW_HASH_SLOT(h) != i || strlen(g_kw[i].kw) != g_kw[i].len) { printf("ERROR: keyword %s not in its hash slot\n", g_kw[i].kw); bad++; }
+    }
+    return bad ? -1 : 0;
+}
+
+CrunchTok* lx_site(const Lexer* lx) {
+    /* replay has already stepped past the current token's record */
+    return lx->tk && lx->cur.type == T_IDENT ? (CrunchTok*)(lx->tk - 1) : NULL;
 }
 
 void lx_next(Lexer* lx) {
+    if (lx->tk) {
+        const CrunchTok* t = lx->tk;
+        lx->cur.type = t->type;
+        lx->i = (size_t)t->end;
+        if (t->type == T_NUMBER) lx->cur.number = t->number;
+        if (t->text >= 0) { lx->cur.text = lx->pool + t->text; lx->cur.len = t->len; }
+        else if (t->type == T_END) { lx->cur.text = ""; lx->cur.len = 0; return; }  /* stay on T_END like the scanner */
+        lx->tk++;
+        return;
+    }
+
     lx_skip_space(lx);
-    if (!lx->s[lx->i]) { lx->cur.type = T_END; lx->cur.text[0] = 0; return; }
+    if (!lx->s[lx->i]) { lx->cur.type = T_END; lx->cur.text = ""; lx->cur.len = 0; return; }
 
     /* NEW: treat ':' and '\' as end-of-statement markers for this segment.
        Do NOT consume them here; exec_multi in main.cpp will split on them. */
     if (lx->s[lx->i] == ':' || lx->s[lx->i] == '\\') {
         lx->cur.type = T_END;
-        lx->cur.text[0] = 0;
+        lx->cur.text = "";
+        lx->cur.len = 0;
         return;
     }
 
@@ -66,74 +181,27 @@ void lx_next(Lexer* lx) {
     if (lx->s[lx->i] == '"') {
         size_t start; lx->i++; start = lx->i;
         while (lx->s[lx->i] && lx->s[lx->i] != '"') lx->i++;
-        { size_t len = lx->i - start; if (len > 127) len = 127; memcpy(lx->cur.text, lx->s + start, len); lx->cur.text[len] = 0; lx->cur.type = T_STRING; }
+        lx->cur.text = lx->s + start; lx->cur.len = (int)(lx->i - start); lx->cur.type = T_STRING;
         if (lx->s[lx->i] == '"') lx->i++;
         return;
     }
 
-    /* identifier / keyword (letters, _, may include $ at end) */
+    /* identifier / keyword (letters, _, may include $ or % at end) */
     if (isalpha((unsigned char)lx->s[lx->i]) || lx->s[lx->i] == '_') {
-        size_t start = lx->i++;
-        while (isalnum((unsigned char)lx->s[lx->i]) || lx->s[lx->i] == '_' || lx->s[lx->i] == '$') lx->i++;
+        size_t start = lx->i, len;
+        unsigned h = 0;
+        while (isalnum((unsigned char)lx->s[lx->i]) || lx->s[lx->i] == '_' || lx->s[lx->i] == '$' || lx->s[lx->i] == '%') {
+            h = KW_HASH_STEP(h, (unsigned char)lx->s[lx->i]);
+            lx->i++;
+        }
+        len = lx->i - start;
         {
-            char t[128], u[128]; size_t len = lx->i - start; if (len > 127) len = 127; memcpy(t, lx->s + start, len); t[len] = 0;
-            { size_t k; for (k = 0; k < len; k++) { u[k] = (char)toupper((unsigned char)t[k]); } u[len] = 0; }
-
-            /* Statement/command keywords */
-            if (!strcmp(u, "LET")) { lx->cur.type = T_LET; return; }
-            if (!strcmp(u, "PRINT") || !strcmp(u, "?")) { lx->cur.type = T_PRINT; return; }
-            if (!strcmp(u, "INPUT")) { lx->cur.type = T_INPUT; return; }
-            if (!strcmp(u, "LINE")) { lx->cur.type = T_LINE; return; }
-            if (!strcmp(u, "IF")) { lx->cur.type = T_IF; return; }
-            if (!strcmp(u, "ELSE")) { lx->cur.type = T_ELSE; return; }
-            if (!strcmp(u, "THEN")) { lx->cur.type = T_THEN; return; }
-            if (!strcmp(u, "GOTO")) { lx->cur.type = T_GOTO; return; }
-            if (!strcmp(u, "END")) { lx->cur.type = T_ENDKW; return; }
-            if (!strcmp(u, "STOP")) { lx->cur.type = T_STOP; return; }
-            if (!strcmp(u, "REM")) { lx->cur.type = T_REM; return; }
-            if (!strcmp(u, "RUN")) { lx->cur.type = T_RUN; return; }
-            if (!strcmp(u, "NEW")) { lx->cur.type = T_NEW; return; }
-            if (!strcmp(u, "LIST")) { lx->cur.type = T_LIST; return; }
-            if (!strcmp(u, "SAVE")) { lx->cur.type = T_SAVE; return; }
-            if (!strcmp(u, "LOAD")) { lx->cur.type = T_LOAD; return; }
-            if (!strcmp(u, "SAVEVARS")) { lx->cur.type = T_SAVEVARS; return; }
-            if (!strcmp(u, "LOADVARS")) { lx->cur.type = T_LOADVARS; return; }
-            if (!strcmp(u, "FOR")) { lx->cur.type = T_FOR; return; }
-            if (!strcmp(u, "TO")) { lx->cur.type = T_TO; return; }
-            if (!strcmp(u, "STEP")) { lx->cur.type = T_STEP; return; }
-            if (!strcmp(u, "NEXT")) { lx->cur.type = T_NEXT; return; }
-            if (!strcmp(u, "GOSUB")) { lx->cur.type = T_GOSUB; return; }
-            if (!strcmp(u, "RETURN")) { lx->cur.type = T_RETURN; return; }
-            if (!strcmp(u, "OPEN")) { lx->cur.type = T_OPEN; return; }
-            if (!strcmp(u, "CLOSE")) { lx->cur.type = T_CLOSE; return; }
-            if (!strcmp(u, "AS")) { lx->cur.type = T_AS; return; }
-            if (!strcmp(u, "APPEND")) { lx->cur.type = T_APPEND; return; }
-            if (!strcmp(u, "OUTPUT")) { lx->cur.type = T_OUTPUTKW; return; }
-            if (!strcmp(u, "DIM")) { lx->cur.type = T_DIM; return; }
-            if (!strcmp(u, "DATA")) { lx->cur.type = T_DATA; return; }
-            if (!strcmp(u, "READ")) { lx->cur.type = T_READ; return; }
-            if (!strcmp(u, "RESTORE")) { lx->cur.type = T_RESTORE; return; }
-            if (!strcmp(u, "TRACE")) { lx->cur.type = T_TRACE; return; }
-            if (!strcmp(u, "ON")) { lx->cur.type = T_ONKW; return; }
-            if (!strcmp(u, "OFF")) { lx->cur.type = T_OFF; return; }
-            if (!strcmp(u, "DUMP")) { lx->cur.type = T_DUMP; return; }
-            if (!strcmp(u, "VARS")) { lx->cur.type = T_VARS; return; }
-            if (!strcmp(u, "ARRAYS")) { lx->cur.type = T_ARRAYS; return; }
-            if (!strcmp(u, "STACK")) { lx->cur.type = T_STACK; return; }
-            if (!strcmp(u, "QUIT")) { lx->cur.type = T_QUIT; return; }
-            if (!strcmp(u, "RENUM")) { lx->cur.type = T_RENUM; return; }
-            if (!strcmp(u, "BYE")) { lx->cur.type = T_BYE; return; }
-
-            /* logical ops */
-            if (!strcmp(u, "AND")) { lx->cur.type = T_AND; return; }
-            if (!strcmp(u, "OR")) { lx->cur.type = T_OR;  return; }
-            if (!strcmp(u, "XOR")) { lx->cur.type = T_XOR; return; }
-            if (!strcmp(u, "NOT")) { lx->cur.type = T_NOT; return; }
-            if (!strcmp(u, "HELP")) { lx->cur.type = T_HELP; return; }
-            
-            /* default ident */
-            lx->cur.type = T_IDENT; strncpy(lx->cur.text, t, sizeof(lx->cur.text) - 1); lx->cur.text[sizeof(lx->cur.text) - 1] = 0; return;
+            const KwEntry* k = &g_kw[KW_HASH_SLOT(h)];
+            if (k->len == len && kw_match(k->kw, lx->s + start, len)) { lx->cur.type = k->type; return; }
         }
+        /* default ident */
+        lx->cur.text = lx->s + start; lx->cur.len = (int)len;
+        lx->cur.type = T_IDENT; return;
     }
 
     /* single-char tokens */
@@ -163,416 +231,544 @@ void lx_next(Lexer* lx) {
    factor (numbers, vars, arrays, funcs, (expr), unary -, unary NOT)
    ^        (right-assoc)
    * /
-   + -
-   relations (=, <>, <, >, <=, >=)  -> boolean 0/1
+   + -      ('+' joins text when either side is a string)
+   relations (=, <>, <, >, <=, >=)  -> boolean 0/1; two strings compare by bytes
    AND / OR / XOR (bitwise on ints)
 */
 
-static double parse_factor(Lexer*lx);
-static double parse_power(Lexer* lx); 
-static double parse_term(Lexer*lx);
-static double parse_expr(Lexer*lx);
-static double parse_relation(Lexer* lx);
-static double parse_logic(Lexer* lx);
+/* RND() value; shared with the compiled evaluator so both draw from one sequence */
+double fn_rnd(void) {
+    static int seeded = 0;
+    if (!seeded) { srand(1); seeded = 1; } /* deterministic unless you later add RANDOMIZE */
+    return (double)rand() / (double)RAND_MAX;
+}
 
-/* helpers to uppercase a local copy of identifier */
+/* ---------- Typed values ----------
+   parse_value's result. A string either points at bytes that live elsewhere (token text,
+   a variable, an array element) or at 'own', a heap copy made only when the bytes change
+   (concatenation, a substring that is not a suffix, STR$ / CHR$, a number used as text). */
+static void val_setnum(Value* v, double d) { v->str = 0; v->num = d; v->s = ""; v->len = 0; v->own = NULL; v->src = NULL; v->isint = 0; }
+static void val_setint(Value* v, BasInt i) { val_setnum(v, (double)i); v->isint = 1; v->inum = i; }
+static void val_setref(Value* v, const char* s, int len) { v->str = 1; v->num = 0.0; v->s = s; v->len = len; v->own = NULL; v->src = NULL; v->isint = 0; }
+
+/* a stored variable / element string, "" when there is none */
+static void val_setstored(Value* v, const BasStr* b) {
+    if (!b) { val_setref(v, "", 0); return; }
+    val_setref(v, bstr_ptr(b), b->len);
+    v->src = b;
+}
 
-static void upcopy(char* dst, const char* src, size_t cap) {
-    size_t i; if (cap == 0) return;
-    for (i = 0; src && src[i] && i + 1 < cap; ++i) dst[i] = (char)toupper((unsigned char)src[i]);
-    dst[i] = 0;
+/* replace v with a copy of p[0..n) (p must not point into v->own) */
+static void val_copy(Value* v, const char* p, int n) {
+    char* b = (char*)malloc((size_t)n + 1);
+    free(v->own);
+    if (!b) { printf("ERROR: OUT OF STRING SPACE\n"); val_setref(v, "", 0); return; }
+    memcpy(b, p, (size_t)n); b[n] = 0;
+    v->str = 1; v->s = b; v->len = n; v->own = b; v->src = NULL; v->isint = 0;
 }
 
-static double parse_factor(Lexer* lx) {
-    Token t = lx->cur;
+void val_free(Value* v) {
+    free(v->own);
+    v->own = NULL;
+}
 
-    /* unary */
-    if (t.type == T_MINUS) { lx_next(lx); return -parse_factor(lx); }
-    if (t.type == T_PLUS) { lx_next(lx); return  parse_factor(lx); }
-    if (t.type == T_NOT) { lx_next(lx); { long v = (long)parse_factor(lx); return (double)(~v); } }
+double val_num(const Value* v) {
+    return v->str ? atof(v->s) : v->num;
+}
 
-    if (t.type == T_NUMBER) { double v = t.number; lx_next(lx); return v; }
+const char* val_text(Value* v) {
+    if (!v->str) {
+        char buf[64];
+        if (v->isint) _snprintf(buf, sizeof(buf), "%lld", v->inum);
+        else _snprintf(buf, sizeof(buf), "%.15g", v->num);
+        val_setref(v, "", 0);
+        val_copy(v, buf, (int)strlen(buf));
+    }
+    return v->s;
+}
 
-    if (t.type == T_STRING) {
-        /* numeric context: coerce string literal with atof() */
-        double v = atof(t.text);
-        lx_next(lx);
-        return v;
+/* keep bytes [off, off + n) of string v */
+static void val_slice(Value* v, int off, int n) {
+    if (off || n != v->len) v->src = NULL;
+    if (v->own) { memmove(v->own, v->own + off, (size_t)n); v->own[n] = 0; v->s = v->own; v->len = n; }
+    else if (off + n == v->len) { v->s += off; v->len = n; }
+    else val_copy(v, v->s + off, n);
+}
+
+/* l = l + r (either side may be a number, which joins as its val_text); frees r */
+static void val_concat(Value* l, Value* r) {
+    int n;
+    char* p;
+    val_text(l); val_text(r);
+    n = l->len + r->len;
+    if (l->own) p = (char*)realloc(l->own, (size_t)n + 1);
+    else { p = (char*)malloc((size_t)n + 1); if (p) memcpy(p, l->s, (size_t)l->len); }
+    if (!p) { printf("ERROR: OUT OF STRING SPACE\n"); val_free(r); return; }
+    memcpy(p + l->len, r->s, (size_t)r->len); p[n] = 0;
+    l->own = p; l->s = p; l->len = n; l->src = NULL;
+    val_free(r);
+}
+
+int str_compare(const char* a, int al, const char* b, int bl) {
+    int c = memcmp(a, b, (size_t)(al < bl ? al : bl));
+    if (c) return c;
+    return (al > bl) - (al < bl);
+}
+
+/* The part of s (length sl) that SEG$ / MID$ / LEFT$ / RIGHT$ / TRM$ keep, as an offset
+   (*off) and a length; SEG$ and MID$ run to the end when the length is missing or <= 0 */
+int str_span(int fn, const char* s, int sl, double a, double b, int* off) {
+    int i0, n;
+    switch (fn) {
+    case SF_SEG: case SF_MID: {
+        int start = (int)a, len = (int)b;
+        if (start < 1) start = 1;
+        i0 = start - 1; if (i0 > sl) i0 = sl;
+        n = len > 0 ? len : sl - i0; if (i0 + n > sl) n = sl - i0; if (n < 0) n = 0;
+        *off = i0;
+        return n;
+    }
+    case SF_LEFT: case SF_RIGHT:
+        n = (int)a; if (n < 0) n = 0; if (n > sl) n = sl;
+        *off = fn == SF_LEFT ? 0 : sl - n;
+        return n;
+    case SF_TRM:
+        i0 = 0; n = sl;
+        while (i0 < n && isspace((unsigned char)s[i0])) i0++;
+        while (n > i0 && isspace((unsigned char)s[n - 1])) n--;
+        *off = i0;
+        return n - i0;
     }
+    *off = 0;
+    return sl;
+}
 
-    if (t.type == T_LPAREN) {
-        double v; lx_next(lx); v = parse_logic(lx); /* full precedence inside parens */
+/* ---------- String functions ----------
+   Called with the function name as the current token, like the builtins below; the
+   string operand is any expression (a number is taken as its %.15g text). */
+static void sv_arg(Lexer* lx, Value* v) {
+    parse_value(lx, v);
+    val_text(v);
+}
+
+/* FN ( string ) with optional parentheses */
+static void sv_arg1(Lexer* lx, Value* v) {
+    lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
+    sv_arg(lx, v);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+}
+
+/* CHR$(n): one byte, n clamped to 0..255 */
+static void sv_chr(Lexer* lx, Value* v) {
+    int code; char ch;
+    lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
+    code = (int)parse_rel(lx);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    if (code < 0) code = 0;
+    if (code > 255) code = 255;
+    ch = (char)code;
+    val_setref(v, "", 0);
+    val_copy(v, &ch, 1);
+}
+
+static void sv_str(Lexer* lx, Value* v) {
+    BasInt i; double d;
+    lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
+    if (parse_int(lx, &i, &d)) val_setint(v, i);
+    else val_setnum(v, d);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    val_text(v);
+}
+
+/* SEG$ / MID$ (s$, start[, len]), LEFT$ / RIGHT$ (s$, n), TRM$(s$) */
+static void sv_span(Lexer* lx, Value* v, int fn, int nargs) {
+    double a = fn == SF_SEG || fn == SF_MID ? 1.0 : 0.0, b = 0.0;
+    int off, n;
+    lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
+    sv_arg(lx, v);
+    if (nargs > 0 && lx->cur.type == T_COMMA) { lx_next(lx); a = parse_rel(lx); }
+    if (nargs > 1 && lx->cur.type == T_COMMA) { lx_next(lx); b = parse_rel(lx); }
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    n = str_span(fn, v->s, v->len, a, b, &off);
+    val_slice(v, off, n);
+}
+
+static void sv_seg(Lexer* lx, Value* v) { sv_span(lx, v, SF_SEG, 2); }
+static void sv_mid(Lexer* lx, Value* v) { sv_span(lx, v, SF_MID, 2); }
+static void sv_left(Lexer* lx, Value* v) { sv_span(lx, v, SF_LEFT, 1); }
+static void sv_right(Lexer* lx, Value* v) { sv_span(lx, v, SF_RIGHT, 1); }
+static void sv_trm(Lexer* lx, Value* v) { sv_span(lx, v, SF_TRM, 0); }
+
+/* a string function in numeric context (the registered handler) */
+static double sv_num(Lexer* lx, void (*sv)(Lexer*, Value*)) {
+    Value v; double d;
+    sv(lx, &v);
+    d = val_num(&v);
+    val_free(&v);
+    return d;
+}
+
+/* ---------- Builtin functions ----------
+   parse_value looks identifiers up here before treating them as variables. Each
+   handler is called with the function name as the current token and parses its own
+   arguments. The registry is an open-addressed hash table keyed case-insensitively;
+   builtin_register adds or replaces entries. */
+static double bi_rnd(Lexer* lx) {
+    lx_next(lx); if (lx->cur.type == T_LPAREN) { lx_next(lx); /* optional arg ignored */ (void)parse_rel(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); }
+    return fn_rnd();
+}
+
+static double bi_int(Lexer* lx) {
+    lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
+    { double v = parse_rel(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); return floor(v); }
+}
+
+static double bi_sgn(Lexer* lx) {
+    lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
+    { double v = parse_rel(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); return (v > 0) - (v < 0); }
+}
+
+static double bi_log10(Lexer* lx) {
+    lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
+    { double v = parse_rel(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); return log10(v); }
+}
+
+static double bi_len(Lexer* lx) {
+    /* LEN(string) -> number */
+    Value v; double n;
+    sv_arg1(lx, &v);
+    n = (double)v.len;
+    val_free(&v);
+    return n;
+}
+
+static double bi_asc(Lexer* lx) {
+    /* ASC(string) -> numeric code of first char (0 if empty) */
+    Value v; double c;
+    sv_arg1(lx, &v);
+    c = v.len ? (double)(unsigned char)v.s[0] : 0.0;
+    val_free(&v);
+    return c;
+}
+
+static double bi_val(Lexer* lx) {
+    /* VAL(string) -> number */
+    Value v; double out;
+    sv_arg1(lx, &v);
+    out = atof(v.s);
+    val_free(&v);
+    return out;
+}
+
+/* EOF(n) -> -1 at end of file (or invalid), 0 otherwise */
+static double bi_eof(Lexer* lx) {
+    lx_next(lx);
+    if (lx->cur.type == T_LPAREN) lx_next(lx);
+    double v = parse_rel(lx);          /* channel number */
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    return fn_eof((int)v);
+}
+
+/* CHR$ and STR$ in numeric context: the atof of the string */
+static double bi_chr_s(Lexer* lx) { return sv_num(lx, sv_chr); }
+static double bi_str_s(Lexer* lx) { return sv_num(lx, sv_str); }
+
+/* an integer operand (MOD, IDIV, NOT): exact, or the number truncated */
+static BasInt val_int(const Value* v) { return v->isint ? v->inum : num_trunc(val_num(v)); }
+
+/* MOD(x,y) integer remainder; IDIV(x,y) integer division */
+static void val_moddiv(Lexer* lx, Value* v, int mod) {
+    BasInt a, b, r;
+    lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
+    parse_value(lx, v); a = val_int(v); val_free(v);
+    if (lx->cur.type == T_COMMA) lx_next(lx);
+    parse_value(lx, v); b = val_int(v); val_free(v);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    if (mod ? int_mod(a, b, &r) : int_idiv(a, b, &r)) val_setint(v, r);
+    else val_setnum(v, (double)a / (double)b);
+}
+
+static void iv_mod(Lexer* lx, Value* v) { val_moddiv(lx, v, 1); }
+static void iv_idiv(Lexer* lx, Value* v) { val_moddiv(lx, v, 0); }
+static double bi_mod(Lexer* lx) { return sv_num(lx, iv_mod); }
+static double bi_idiv(Lexer* lx) { return sv_num(lx, iv_idiv); }
+
+/* PI constant (no args; optional parentheses tolerated) */
+static double bi_pi(Lexer* lx) {
+    lx_next(lx);
+    if (lx->cur.type == T_LPAREN) { lx_next(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); }
+    return 3.14159265358979323846;
+}
+
+/* POS(hay$, needle$) -> 1-based index (0 if not found) */
+/* POS() -> current print column (1-based) */
+static double bi_pos(Lexer* lx) {
+    lx_next(lx);
+    if (lx->cur.type == T_LPAREN) {
+        lx_next(lx);
         if (lx->cur.type == T_RPAREN) lx_next(lx);
-        return v;
     }
+    return (double)(g_print_col + 1);
+}
 
+/* INSTR(hay$, needle$) -> 1-based index (0 if not found) */
+static double bi_instr(Lexer* lx) {
+    Value hay, nee; const char* p; double ret;
+    lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
+    sv_arg(lx, &hay);
+    if (lx->cur.type == T_COMMA) lx_next(lx);
+    sv_arg(lx, &nee);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    p = strstr(hay.s, nee.s);
+    ret = p ? (double)(p - hay.s) + 1.0 : 0.0;
+    val_free(&hay); val_free(&nee);
+    return ret;
+}
 
-    if (t.type == T_IDENT)
-    {
-        /* handle functions / constants first */
-        char fname[32]; upcopy(fname, t.text, sizeof(fname));
+/* TAB(n)  in numeric context just returns n (PRINT handles spacing) */
+static double bi_tab(Lexer* lx) {
+    lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
+    { double v = parse_rel(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); return v; }
+}
 
-        /* --- numeric-returning classic math --- */
+/* SEG$, LEFT$, RIGHT$, MID$, TRM$ (and CHR$ / STR$ above) through the registry: a
+   caller that wants a number gets the string's atof */
+static double bi_seg_s(Lexer* lx) { return sv_num(lx, sv_seg); }
+static double bi_left_s(Lexer* lx) { return sv_num(lx, sv_left); }
+static double bi_right_s(Lexer* lx) { return sv_num(lx, sv_right); }
+static double bi_mid_s(Lexer* lx) { return sv_num(lx, sv_mid); }
+static double bi_trm_s(Lexer* lx) { return sv_num(lx, sv_trm); }
+
+static double bi_atn(Lexer* lx) {
+    lx_next(lx);
+    if (lx->cur.type == T_LPAREN) lx_next(lx);
+    double v = parse_rel(lx);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    return atan(v);
+}
 
-        /* List of supported functions: one argument unless POW (two) */
-        if (!strcmp(fname, "RND")) {
-            static int seeded = 0;
-            lx_next(lx); if (lx->cur.type == T_LPAREN) { lx_next(lx); /* optional arg ignored */ (void)parse_rel(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); }
-            if (!seeded) { srand(1); seeded = 1; } /* deterministic unless you later add RANDOMIZE */
-            return (double)rand() / (double)RAND_MAX;
-        }
+static double bi_cos(Lexer* lx) {
+    lx_next(lx);
+    if (lx->cur.type == T_LPAREN) lx_next(lx);
+    double v = parse_rel(lx);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    return cos(v);
+}
 
-        if (!strcmp(fname, "INT")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            { double v = parse_rel(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); return floor(v); }
-        }
-        if (!strcmp(fname, "SGN")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            { double v = parse_rel(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); return (v > 0) - (v < 0); }
-        }
-        if (!strcmp(fname, "LOG10")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            { double v = parse_rel(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); return log10(v); }
-        }
+static double bi_sin(Lexer* lx) {
+    lx_next(lx);
+    if (lx->cur.type == T_LPAREN) lx_next(lx);
+    double v = parse_rel(lx);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    return sin(v);
+}
 
-        if (!strcmp(fname, "LEN")) {
-            /* LEN(string) -> number */
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            {
-                double n = 0.0;
-                if (lx->cur.type == T_STRING) { n = (double)strlen(lx->cur.text); lx_next(lx); }
-                else if (lx->cur.type == T_IDENT) {
-                    /* string var or string array element or STR$/CHR$ call */
-                    char nbuf[32]; strncpy(nbuf, lx->cur.text, sizeof(nbuf) - 1); nbuf[sizeof(nbuf) - 1] = 0;
-                    if (is_string_var_name(nbuf)) {
-                        lx_next(lx);
-                        if (lx->cur.type == T_LPAREN) {
-                            /* string array element */
-                            int subs[MAX_DIMS], nsubs = 0; SArray* sa = sarray_find(nbuf);
-                            lx_next(lx);
-                            while (lx->cur.type != T_RPAREN && lx->cur.type != T_END) {
-                                if (nsubs >= MAX_DIMS) { printf("ERROR: TOO MANY SUBSCRIPTS\n"); break; }
-                                subs[nsubs++] = (int)parse_rel(lx);
-                                if (lx->cur.type == T_COMMA) { lx_next(lx); continue; }
-                                else break;
-                            }
-                            if (lx->cur.type == T_RPAREN) lx_next(lx);
-                            { const char* s = sa ? sarray_get(sa, subs, nsubs) : ""; n = (double)strlen(s); }
-                        }
-                        else {
-                            Variable* v = find_var(nbuf); const char* s = (v && v->type == VT_STR && v->str) ? v->str : ""; n = (double)strlen(s);
-                        }
-                    }
-                    else {
-                        /* maybe STR$() or CHR$()? Treat as 0 length if unknown here */
-                        n = 0.0;
-                    }
-                }
-                if (lx->cur.type == T_RPAREN) lx_next(lx);
-                return n;
-            }
-        }
-        if (!strcmp(fname, "ASC")) {
-            /* ASC(string) -> numeric code of first char (0 if empty) */
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            {
-                int c = 0;
-                if (lx->cur.type == T_STRING) { c = (unsigned char)lx->cur.text[0]; lx_next(lx); }
-                else if (lx->cur.type == T_IDENT && is_string_var_name(lx->cur.text)) {
-                    char nbuf[32]; strncpy(nbuf, lx->cur.text, sizeof(nbuf) - 1); nbuf[sizeof(nbuf) - 1] = 0; lx_next(lx);
-                    if (lx->cur.type == T_LPAREN) {
-                        int subs[MAX_DIMS], nsubs = 0; SArray* sa = sarray_find(nbuf); lx_next(lx);
-                        while (lx->cur.type != T_RPAREN && lx->cur.type != T_END) {
-                            if (nsubs >= MAX_DIMS) { printf("ERROR: TOO MANY SUBSCRIPTS\n"); break; }
-                            subs[nsubs++] = (int)parse_rel(lx);
-                            if (lx->cur.type == T_COMMA) { lx_next(lx); continue; }
-                            else break;
-                        }
-                        if (lx->cur.type == T_RPAREN) lx_next(lx);
-                        { const char* s = sa ? sarray_get(sa, subs, nsubs) : ""; c = (unsigned char)(s[0] ? s[0] : 0); }
-                    }
-                    else {
-                        Variable* v = find_var(nbuf); const char* s = (v && v->type == VT_STR && v->str) ? v->str : ""; c = (unsigned char)(s[0] ? s[0] : 0);
-                    }
-                }
-                if (lx->cur.type == T_RPAREN) lx_next(lx);
-                return (double)c;
-            }
-        }
-        if (!strcmp(fname, "VAL")) {
-            /* VAL(string) -> number */
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            {
-                double out = 0.0;
-                if (lx->cur.type == T_STRING) { out = atof(lx->cur.text); lx_next(lx); }
-                else if (lx->cur.type == T_IDENT && is_string_var_name(lx->cur.text)) {
-                    Variable* v = find_var(lx->cur.text); const char* s = (v && v->type == VT_STR && v->str) ? v->str : ""; out = atof(s); lx_next(lx);
-                }
-                if (lx->cur.type == T_RPAREN) lx_next(lx);
-                return out;
-            }
-        }
+static double bi_tan(Lexer* lx) {
+    lx_next(lx);
+    if (lx->cur.type == T_LPAREN) lx_next(lx);
+    double v = parse_rel(lx);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    return tan(v);
+}
 
-        /* EOF(n) -> -1 at end of file (or invalid), 0 otherwise */
-        if (!strcmp(fname, "EOF")) {
-            lx_next(lx);
-            if (lx->cur.type == T_LPAREN) lx_next(lx);
-            double v = parse_rel(lx);          /* channel number */
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            return fn_eof((int)v);
-        }
+static double bi_exp(Lexer* lx) {
+    lx_next(lx);
+    if (lx->cur.type == T_LPAREN) lx_next(lx);
+    double v = parse_rel(lx);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    return exp(v);
+}
 
-        /* NOTE: CHR$ and STR$ return strings; in numeric context they coerce via atof(""). */
-        if (!strcmp(fname, "CHR$")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            { int code = (int)parse_rel(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); char tmp[4]; tmp[0] = (char)code; tmp[1] = 0; return atof(tmp); }
-        }
-        if (!strcmp(fname, "STR$")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            { double v = parse_rel(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); char buf[64]; _snprintf(buf, sizeof(buf), "%.15g", v); return atof(buf); }
-        }
+static double bi_log(Lexer* lx) {
+    /* natural log */
+    lx_next(lx);
+    if (lx->cur.type == T_LPAREN) lx_next(lx);
+    double v = parse_rel(lx);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    return log(v);
+}
 
-        /* PI constant (no args; optional parentheses tolerated) */
-        if (!strcmp(fname, "PI")) {
-            lx_next(lx);
-            if (lx->cur.type == T_LPAREN) { lx_next(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); }
-            return 3.14159265358979323846;
-        }
+static double bi_pow(Lexer* lx) {
+    /* two args */
+    lx_next(lx);
+    if (lx->cur.type == T_LPAREN) lx_next(lx);
+    double b = parse_rel(lx);
+    if (lx->cur.type == T_COMMA) { lx_next(lx); }
+    double e = parse_rel(lx);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    return pow(b, e);
+}
 
-        /* POS(hay$, needle$) -> 1-based index (0 if not found) */
-        /* POS() -> current print column (1-based) */
-        if (!strcmp(fname, "POS")) {
-            lx_next(lx);
-            if (lx->cur.type == T_LPAREN) {
-                lx_next(lx);
-                if (lx->cur.type == T_RPAREN) lx_next(lx);
-            }
-            return (double)(g_print_col + 1);
-        }
+static double bi_sqr(Lexer* lx) {
+    /* sqrt */
+    lx_next(lx);
+    if (lx->cur.type == T_LPAREN) lx_next(lx);
+    double v = parse_rel(lx);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    return sqrt(v);
+}
 
-        /* INSTR(hay$, needle$) -> 1-based index (0 if not found) */
-        if (!strcmp(fname, "INSTR")) {
-            char* p1 = NULL, * p2 = NULL;
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            {
-                const char* hay = NULL, * nee = NULL;
-                if (lx->cur.type == T_STRING) {
-                    hay = lx->cur.text;
-                    p1 = (char*)malloc(strlen(hay) + 1);
-                    if (p1 != NULL)
-                        strcpy(p1, hay);
-                    else
-                        return 0.0;
-                    lx_next(lx);
-                }
-                else if (lx->cur.type == T_IDENT && is_string_var_name(lx->cur.text)) {
-                    Variable* v = find_var(lx->cur.text); hay = (v && v->type == VT_STR && v->str) ? v->str : ""; lx_next(lx);
-                }
-                if (lx->cur.type == T_COMMA) lx_next(lx);
-
-                if (lx->cur.type == T_STRING)
-                {
-                    nee = lx->cur.text;
-                    p2 = (char*)malloc(strlen(nee) + 1);
-                    if (p2 != NULL)
-                        strcpy(p2, nee);
-                    else
-                        return 0.0;
-                    lx_next(lx);
-                }
-
-                else if (lx->cur.type == T_IDENT && is_string_var_name(lx->cur.text)) {
-                    Variable* v = find_var(lx->cur.text); nee = (v && v->type == VT_STR && v->str) ? v->str : ""; lx_next(lx);
-                }
-                if (lx->cur.type == T_RPAREN) lx_next(lx);
-                if (!p1 || !p2) return 0.0;
-                {
-                    const char* p = strstr(p1, p2);
-                    int reti = (int)(p - p1);
-                    double ret = (double)(reti);
-                    ret++;
-                    free(p1);
-                    free(p2);
-                    return p ? ret : 0.0;
-                }
-            }
-        }
+static double bi_abs(Lexer* lx) {
+    lx_next(lx);
+    if (lx->cur.type == T_LPAREN) lx_next(lx);
+    double v = parse_rel(lx);
+    if (lx->cur.type == T_RPAREN) lx_next(lx);
+    return fabs(v);
+}
 
-        /* TAB(n)  in numeric context just returns n (PRINT handles spacing) */
-        if (!strcmp(fname, "TAB")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            { double v = parse_rel(lx); if (lx->cur.type == T_RPAREN) lx_next(lx); return v; }
-        }
+#define BI_SLOTS 128
+
+static const Builtin g_builtin_defs[] = {
+    { "RND", -1, BI_NUM, bi_rnd },
+    { "INT", 1, BI_NUM, bi_int },
+    { "SGN", 1, BI_NUM, bi_sgn },
+    { "LOG10", 1, BI_NUM, bi_log10 },
+    { "LEN", 1, BI_NUM, bi_len },
+    { "ASC", 1, BI_NUM, bi_asc },
+    { "VAL", 1, BI_NUM, bi_val },
+    { "EOF", 1, BI_NUM, bi_eof },
+    { "CHR$", 1, BI_STR, bi_chr_s },
+    { "STR$", 1, BI_STR, bi_str_s },
+    { "PI", 0, BI_NUM, bi_pi },
+    { "POS", 0, BI_NUM, bi_pos },
+    { "INSTR", 2, BI_NUM, bi_instr },
+    { "TAB", 1, BI_NUM, bi_tab },
+    { "SEG$", 3, BI_STR, bi_seg_s },
+    { "LEFT$", 2, BI_STR, bi_left_s },
+    { "RIGHT$", 2, BI_STR, bi_right_s },
+    { "MID$", -1, BI_STR, bi_mid_s },
+    { "TRM$", 1, BI_STR, bi_trm_s },
+    { "MOD", 2, BI_NUM, bi_mod },
+    { "IDIV", 2, BI_NUM, bi_idiv },
+    { "ATN", 1, BI_NUM, bi_atn },
+    { "COS", 1, BI_NUM, bi_cos },
+    { "SIN", 1, BI_NUM, bi_sin },
+    { "TAN", 1, BI_NUM, bi_tan },
+    { "EXP", 1, BI_NUM, bi_exp },
+    { "LOG", 1, BI_NUM, bi_log },
+    { "POW", 2, BI_NUM, bi_pow },
+    { "SQR", 1, BI_NUM, bi_sqr },
+    { "ABS", 1, BI_NUM, bi_abs },
+    { NULL, 0, BI_NUM, NULL }
+};
+
+static Builtin g_builtins[BI_SLOTS];
+static int g_builtin_count = 0;
+static int g_builtins_ready = 0;
+
+static unsigned bi_hash(const char* name) {
+    unsigned h = 2166136261u;
+    for (; *name; name++) h = (h ^ (unsigned)toupper((unsigned char)*name)) * 16777619u;
+    return h;
+}
 
-        /* SEG$(s$, start, len)  numeric context coerces with atof result */
-        if (!strcmp(fname, "SEG$")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            {
-                const char* s = ""; int start = 1, len = 0;
-                if (lx->cur.type == T_STRING) { s = lx->cur.text; lx_next(lx); }
-                else if (lx->cur.type == T_IDENT && is_string_var_name(lx->cur.text)) {
-                    Variable* v = find_var(lx->cur.text); s = (v && v->type == VT_STR && v->str) ? v->str : ""; lx_next(lx);
-                }
-                if (lx->cur.type == T_COMMA) { lx_next(lx); start = (int)parse_rel(lx); }
-                if (lx->cur.type == T_COMMA) { lx_next(lx); len = (int)parse_rel(lx); }
-                if (lx->cur.type == T_RPAREN) lx_next(lx);
-                if (start < 1) start = 1; if (len < 0) len = 0;
-                {
-                    int sl = (int)strlen(s); int i0 = start - 1; if (i0 > sl) i0 = sl; if (i0 < 0) i0 = 0;
-                    int l = len; if (i0 + l > sl) l = sl - i0; if (l < 0) l = 0;
-                    char tmp[1024]; if (l > (int)sizeof(tmp) - 1) l = (int)sizeof(tmp) - 1;
-                    memcpy(tmp, s + i0, l); tmp[l] = 0; return atof(tmp);
-                }
-            }
-        }
+/* entry name is stored uppercase */
+static int bi_match(const char* upper, const char* name) {
+    for (; *upper && *name; upper++, name++) if (*upper != (char)toupper((unsigned char)*name)) return 0;
+    return *upper == *name;
+}
 
-        /* LEFT$(s$, n) */
-        if (!strcmp(fname, "LEFT$")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            const char* s = ""; int n = 0;
-            if (lx->cur.type == T_STRING) { s = lx->cur.text; lx_next(lx); }
-            else if (lx->cur.type == T_IDENT && is_string_var_name(lx->cur.text)) {
-                Variable* v = find_var(lx->cur.text); s = (v && v->type == VT_STR && v->str) ? v->str : ""; lx_next(lx);
-            }
-            if (lx->cur.type == T_COMMA) { lx_next(lx); n = (int)parse_logic(lx); }
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            int sl = (int)strlen(s); if (n < 0) n = 0; if (n > sl) n = sl;
-            char tmp[1024]; int l = n; if (l > (int)sizeof(tmp) - 1) l = (int)sizeof(tmp) - 1;
-            memcpy(tmp, s, l); tmp[l] = 0; return atof(tmp);
-        }
+static Builtin* bi_slot(const char* name) {
+    unsigned i = bi_hash(name) & (BI_SLOTS - 1);
+    while (g_builtins[i].name && !bi_match(g_builtins[i].name, name)) i = (i + 1) & (BI_SLOTS - 1);
+    return &g_builtins[i];
+}
 
-        /* RIGHT$(s$, n) */
-        if (!strcmp(fname, "RIGHT$")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            const char* s = ""; int n = 0;
-            if (lx->cur.type == T_STRING) { s = lx->cur.text; lx_next(lx); }
-            else if (lx->cur.type == T_IDENT && is_string_var_name(lx->cur.text)) {
-                Variable* v = find_var(lx->cur.text); s = (v && v->type == VT_STR && v->str) ? v->str : ""; lx_next(lx);
-            }
-            if (lx->cur.type == T_COMMA) { lx_next(lx); n = (int)parse_logic(lx); }
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            int sl = (int)strlen(s); if (n < 0) n = 0; if (n > sl) n = sl;
-            int i0 = sl - n; if (i0 < 0) i0 = 0;
-            char tmp[1024]; int l = sl - i0; if (l > (int)sizeof(tmp) - 1) l = (int)sizeof(tmp) - 1;
-            memcpy(tmp, s + i0, l); tmp[l] = 0; return atof(tmp);
-        }
+static void builtins_init(void) {
+    int i;
+    if (g_builtins_ready) return;
+    g_builtins_ready = 1;
+    for (i = 0; g_builtin_defs[i].name; i++)
+        builtin_register(g_builtin_defs[i].name, g_builtin_defs[i].nargs, g_builtin_defs[i].ret, g_builtin_defs[i].fn);
+}
 
-        /* MID$(s$, start[, len]) -> same as SEG$ */
-        if (!strcmp(fname, "MID$")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            const char* s = ""; int start = 1, len = 0;
-            if (lx->cur.type == T_STRING) { s = lx->cur.text; lx_next(lx); }
-            else if (lx->cur.type == T_IDENT && is_string_var_name(lx->cur.text)) {
-                Variable* v = find_var(lx->cur.text); s = (v && v->type == VT_STR && v->str) ? v->str : ""; lx_next(lx);
-            }
-            if (lx->cur.type == T_COMMA) { lx_next(lx); start = (int)parse_logic(lx); }
-            if (lx->cur.type == T_COMMA) { lx_next(lx); len = (int)parse_logic(lx); }
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            if (start < 1) start = 1; int sl = (int)strlen(s); int i0 = start - 1; if (i0 > sl) i0 = sl;
-            int l = (len > 0 ? len : (sl - i0)); if (i0 + l > sl) l = sl - i0; if (l < 0) l = 0;
-            char tmp[1024]; if (l > (int)sizeof(tmp) - 1) l = (int)sizeof(tmp) - 1;
-            memcpy(tmp, s + i0, l); tmp[l] = 0; return atof(tmp);
-        }
+int builtin_register(const char* name, int nargs, BuiltinType ret, BuiltinFn fn) {
+    Builtin* b;
+    char* up;
+    size_t i, n;
+    builtins_init();
+    if (!name || !name[0] || !fn) return -1;
+    b = bi_slot(name);
+    if (!b->name) {
+        if (g_builtin_count >= BI_SLOTS / 2) { printf("ERROR: BUILTIN TABLE FULL\n"); return -1; }
+        n = strlen(name);
+        up = (char*)malloc(n + 1);
+        if (!up) return -1;
+        for (i = 0; i <= n; i++) up[i] = (char)toupper((unsigned char)name[i]);
+        b->name = up;
+        g_builtin_count++;
+    }
+    b->nargs = nargs;
+    b->ret = ret;
+    b->fn = fn;
+    return 0;
+}
 
-        /* TRM$(s$)  trims leading and trailing spaces; numeric context coerces */
-        if (!strcmp(fname, "TRM$")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            {
-                const char* s = ""; if (lx->cur.type == T_STRING) { s = lx->cur.text; lx_next(lx); }
-                else if (lx->cur.type == T_IDENT && is_string_var_name(lx->cur.text)) {
-                    Variable* v = find_var(lx->cur.text); s = (v && v->type == VT_STR && v->str) ? v->str : ""; lx_next(lx);
-                }
-                if (lx->cur.type == T_RPAREN) lx_next(lx);
-                {
-                    char buf[1024]; size_t n = strlen(s), a = 0, b = n;
-                    while (a < b && isspace((unsigned char)s[a])) a++;
-                    while (b > a && isspace((unsigned char)s[b - 1])) b--;
-                    { size_t l = b - a; if (l > sizeof(buf) - 1) l = sizeof(buf) - 1; memcpy(buf, s + a, l); buf[l] = 0; return atof(buf); }
-                }
-            }
-        }
+const Builtin* builtin_find(const char* name) {
+    const Builtin* b;
+    builtins_init();
+    b = bi_slot(name);
+    return b->name ? b : NULL;
+}
 
-        /* MOD(x,y) integer remainder; IDIV(x,y) integer division */
-        if (!strcmp(fname, "MOD")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            long a = (long)parse_logic(lx); if (lx->cur.type == T_COMMA) lx_next(lx);
-            long b = (long)parse_logic(lx); if (lx->cur.type == T_RPAREN) lx_next(lx);
-            if (b == 0) return 0.0;
-            return (double)(a % b);
-        }
-        if (!strcmp(fname, "IDIV")) {
-            lx_next(lx); if (lx->cur.type == T_LPAREN) lx_next(lx);
-            long a = (long)parse_logic(lx); if (lx->cur.type == T_COMMA) lx_next(lx);
-            long b = (long)parse_logic(lx); if (lx->cur.type == T_RPAREN) lx_next(lx);
-            if (b == 0) return 0.0;
-            return (double)(a / b);
-        }
+/* registry handlers whose value is not a plain double (string functions, and MOD / IDIV,
+   which are integers): parse_value calls the typed form */
+static const struct { BuiltinFn fn; void (*sv)(Lexer*, Value*); } g_val_builtins[] = {
+    { bi_chr_s, sv_chr }, { bi_str_s, sv_str }, { bi_seg_s, sv_seg }, { bi_left_s, sv_left },
+    { bi_right_s, sv_right }, { bi_mid_s, sv_mid }, { bi_trm_s, sv_trm },
+    { bi_mod, iv_mod }, { bi_idiv, iv_idiv }, { NULL, NULL }
+};
 
+static void val_factor(Lexer* lx, Value* v) {
+    Token t = lx->cur;
 
-        if (strcmp(fname, "ATN") == 0) {
-            lx_next(lx);
-            if (lx->cur.type == T_LPAREN) lx_next(lx);
-            double v = parse_rel(lx);
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            return atan(v);
-        }
-        if (strcmp(fname, "COS") == 0) {
-            lx_next(lx);
-            if (lx->cur.type == T_LPAREN) lx_next(lx);
-            double v = parse_rel(lx);
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            return cos(v);
-        }
-        if (strcmp(fname, "SIN") == 0) {
-            lx_next(lx);
-            if (lx->cur.type == T_LPAREN) lx_next(lx);
-            double v = parse_rel(lx);
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            return sin(v);
-        }
-        if (strcmp(fname, "TAN") == 0) {
-            lx_next(lx);
-            if (lx->cur.type == T_LPAREN) lx_next(lx);
-            double v = parse_rel(lx);
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            return tan(v);
-        }
-        if (strcmp(fname, "EXP") == 0) {
-            lx_next(lx);
-            if (lx->cur.type == T_LPAREN) lx_next(lx);
-            double v = parse_rel(lx);
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            return exp(v);
-        }
-        if (strcmp(fname, "LOG") == 0) { /* natural log */
-            lx_next(lx);
-            if (lx->cur.type == T_LPAREN) lx_next(lx);
-            double v = parse_rel(lx);
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            return log(v);
-        }
-        if (strcmp(fname, "POW") == 0) { /* two args */
-            lx_next(lx);
-            if (lx->cur.type == T_LPAREN) lx_next(lx);
-            double b = parse_rel(lx);
-            if (lx->cur.type == T_COMMA) { lx_next(lx); }
-            double e = parse_rel(lx);
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            return pow(b, e);
-        }
-        if (strcmp(fname, "SQR") == 0) { /* sqrt */
-            lx_next(lx);
-            if (lx->cur.type == T_LPAREN) lx_next(lx);
-            double v = parse_rel(lx);
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            return sqrt(v);
-        }
-        if (strcmp(fname, "ABS") == 0) {
-            lx_next(lx);
-            if (lx->cur.type == T_LPAREN) lx_next(lx);
-            double v = parse_rel(lx);
-            if (lx->cur.type == T_RPAREN) lx_next(lx);
-            return fabs(v);
+    /* unary: the operand is used as a number */
+    if (t.type == T_MINUS || t.type == T_PLUS || t.type == T_NOT) {
+        double d;
+        lx_next(lx);
+        val_factor(lx, v);
+        if (t.type == T_NOT) { BasInt i = val_int(v); val_free(v); val_setint(v, ~i); return; }
+        if (v->isint && (t.type == T_PLUS || v->inum != LLONG_MIN)) { val_setint(v, t.type == T_MINUS ? -v->inum : v->inum); return; }
+        d = val_num(v);
+        val_free(v);
+        if (t.type == T_MINUS) d = -d;
+        val_setnum(v, d);
+        return;
+    }
+
+    if (t.type == T_NUMBER) {
+        /* a whole literal is an integer (as Node.isint in compile.cpp) */
+        if (t.number == floor(t.number) && fabs(t.number) < 9007199254740992.0) val_setint(v, (BasInt)t.number);
+        else val_setnum(v, t.number);
+        lx_next(lx);
+        return;
+    }
+
+    if (t.type == T_STRING) {
+        /* crunched text is NUL-terminated in place; a raw scan stops at the closing quote */
+        val_setref(v, t.text, t.len);
+        if (t.text[t.len]) { val_setref(v, "", 0); val_copy(v, t.text, t.len); }
+        lx_next(lx);
+        return;
+    }
+
+    if (t.type == T_LPAREN) {
+        lx_next(lx); parse_value(lx, v); /* full precedence inside parens */
+        if (lx->cur.type == T_RPAREN) lx_next(lx);
+        return;
+    }
+
+    if (t.type == T_IDENT)
+    {
+        CrunchTok* site = lx_site(lx);
+        /* builtin function or constant? (a site that resolved to a variable is not one) */
+        const Builtin* bi = site && site->ic ? NULL : builtin_find(t.text);
+        if (bi) {
+            int i;
+            for (i = 0; g_val_builtins[i].fn; i++)
+                if (g_val_builtins[i].fn == bi->fn) { g_val_builtins[i].sv(lx, v); return; }
+            val_setnum(v, bi->fn(lx));
+            return;
         }
 
         /* If not a recognized function: variable / array lookup 
@@ -591,95 +787,142 @@ static double parse_factor(Lexer* lx) {
             }
             if (lx->cur.type == T_RPAREN) lx_next(lx);
             if (isStrName) {
-                SArray* sa = sarray_find(t.text);
-                const char* sval = sa ? sarray_get(sa, subs, nsubs) : "";
-                return (double)atof(sval);
+                SArray* sa = sarray_find_at(site, t.text);
+                val_setstored(v, sa ? sarray_at(sa, subs, nsubs) : NULL);
             }
             else {
-                Array* a = array_find(t.text);
-                if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", t.text); return 0.0; }
-                return array_get(a, subs, nsubs);
+                Array* a = array_find_at(site, t.text);
+                int k;
+                if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", t.text); val_setnum(v, 0.0); return; }
+                if (a->idata && (k = array_index(a, subs, nsubs)) >= 0) val_setint(v, a->idata[k]);
+                else val_setnum(v, array_get(a, subs, nsubs));
             }
+            return;
         }
         /* scalar variable fallback */
-        {
-            Variable* v = find_var(t.text);
-            if (!v) return 0.0;
-            return v->type == VT_NUM ? v->num : (double)atof(v->str ? v->str : "0");
+        if (is_string_var_name(t.text)) {
+            val_setstored(v, var_bstr(find_var_at(site, t.text)));
         }
+        else {
+            int slot = find_var_at(site, t.text);
+            if (slot >= 0 && g_var_type[slot] == VT_INT) val_setint(v, g_var_int[slot]);
+            else val_setnum(v, var_value(slot));
+        }
+        return;
     }
-    return 0.0;
+    val_setnum(v, 0.0);
 }
 
 /* Right-associative exponentiation */
-static double parse_power(Lexer* lx) {
-    double left = parse_factor(lx);
+static void val_power(Lexer* lx, Value* v) {
+    val_factor(lx, v);
     if (lx->cur.type == T_POWOP) {
+        Value r; double left = val_num(v);
         lx_next(lx);
         /* recurse to stay right-associative: a^b^c = a^(b^c) */
-        double right = parse_power(lx);
-        left = pow(left, right);
+        val_power(lx, &r);
+        val_free(v);
+        val_setnum(v, pow(left, val_num(&r)));
+        val_free(&r);
     }
-    return left;
 }
 
-static double parse_term(Lexer* lx)
+static void val_term(Lexer* lx, Value* v)
 {
-    double v = parse_power(lx);           /* was parse_factor */
+    val_power(lx, v);
     while (lx->cur.type == T_STAR || lx->cur.type == T_SLASH) {
-        TokType op = lx->cur.type; lx_next(lx);
-        double rhs = parse_power(lx);     /* was parse_factor */
-        if (op == T_STAR) v *= rhs; else v /= rhs;
+        TokType op = lx->cur.type; Value r; double left = val_num(v), rhs; BasInt p;
+        lx_next(lx);
+        val_power(lx, &r);
+        if (op == T_STAR && v->isint && r.isint && int_mul(v->inum, r.inum, &p)) { val_setint(v, p); continue; }
+        rhs = val_num(&r);
+        val_free(v); val_free(&r);
+        val_setnum(v, op == T_STAR ? left * rhs : left / rhs);
     }
-    return v;
 }
 
-static double parse_expr(Lexer*lx)
+/* '+' joins when either side is a string; everything else is arithmetic */
+static void val_expr(Lexer* lx, Value* v)
 {
-    double v=parse_term(lx);
-    while(lx->cur.type==T_PLUS||lx->cur.type==T_MINUS){
-        TokType op=lx->cur.type; lx_next(lx);
-        { double rhs=parse_term(lx); if(op==T_PLUS) v+=rhs; else v-=rhs; }
+    val_term(lx, v);
+    while (lx->cur.type == T_PLUS || lx->cur.type == T_MINUS) {
+        TokType op = lx->cur.type; Value r;
+        lx_next(lx);
+        val_term(lx, &r);
+        if (op == T_PLUS && (v->str || r.str)) { val_concat(v, &r); continue; }
+        if (v->isint && r.isint) {
+            BasInt s;
+            if (op == T_PLUS ? int_add(v->inum, r.inum, &s) : int_sub(v->inum, r.inum, &s)) { val_setint(v, s); continue; }
+        }
+        {
+            double left = val_num(v), rhs = val_num(&r);
+            val_free(v); val_free(&r);
+            val_setnum(v, op == T_PLUS ? left + rhs : left - rhs);
+        }
     }
-    return v;
 }
 
-/* comparisons -> boolean 0/1 */
-static double parse_relation(Lexer* lx) {
-    double lhs = parse_expr(lx);
+/* comparisons -> boolean 0/1; two strings compare by bytes, anything else as numbers */
+static void val_relation(Lexer* lx, Value* v) {
+    val_expr(lx, v);
     if (lx->cur.type == T_EQ || lx->cur.type == T_NE || lx->cur.type == T_LT || lx->cur.type == T_GT || lx->cur.type == T_LE || lx->cur.type == T_GE) {
-        TokType op = lx->cur.type; lx_next(lx);
-        {
-            double rhs = parse_expr(lx); int r = 0;
-            if (op == T_EQ) r = (lhs == rhs);
-            else if (op == T_NE) r = (lhs != rhs);
-            else if (op == T_LT) r = (lhs < rhs);
-            else if (op == T_GT) r = (lhs > rhs);
-            else if (op == T_LE) r = (lhs <= rhs);
-            else if (op == T_GE) r = (lhs >= rhs);
-            return r ? 1.0 : 0.0;
+        TokType op = lx->cur.type; Value r; int res = 0;
+        lx_next(lx);
+        val_expr(lx, &r);
+        if (v->str && r.str) {
+            if (op == T_EQ || op == T_NE) {
+                int eq = v->len == r.len && memcmp(v->s, r.s, (size_t)r.len) == 0;
+                res = op == T_EQ ? eq : !eq;
+            }
+            else {
+                int c = str_compare(v->s, v->len, r.s, r.len);
+                res = op == T_LT ? c < 0 : op == T_GT ? c > 0 : op == T_LE ? c <= 0 : c >= 0;
+            }
         }
+        else {
+            double lhs = val_num(v), rhs = val_num(&r);
+            if (op == T_EQ) res = (lhs == rhs);
+            else if (op == T_NE) res = (lhs != rhs);
+            else if (op == T_LT) res = (lhs < rhs);
+            else if (op == T_GT) res = (lhs > rhs);
+            else if (op == T_LE) res = (lhs <= rhs);
+            else if (op == T_GE) res = (lhs >= rhs);
+        }
+        val_free(v); val_free(&r);
+        val_setnum(v, res ? 1.0 : 0.0);
     }
-    return lhs;
 }
 
 /* logical chain (bitwise on ints) */
-static double parse_logic(Lexer* lx) {
-    double left = parse_relation(lx);
+void parse_value(Lexer* lx, Value* v) {
+    val_relation(lx, v);
     while (lx->cur.type == T_AND || lx->cur.type == T_OR || lx->cur.type == T_XOR) {
-        TokType op = lx->cur.type; lx_next(lx);
-        double right = parse_relation(lx);
-        int L = (left != 0.0);
-        int R = (right != 0.0);
-        if (op == T_AND) left = (L && R) ? 1.0 : 0.0;
-        else if (op == T_OR) left = (L || R) ? 1.0 : 0.0;
-        else              left = ((L && !R) || (!L && R)) ? 1.0 : 0.0; /* XOR */
+        TokType op = lx->cur.type; Value r; int L, R;
+        lx_next(lx);
+        val_relation(lx, &r);
+        L = (val_num(v) != 0.0);
+        R = (val_num(&r) != 0.0);
+        val_free(v); val_free(&r);
+        if (op == T_AND) val_setnum(v, (L && R) ? 1.0 : 0.0);
+        else if (op == T_OR) val_setnum(v, (L || R) ? 1.0 : 0.0);
+        else              val_setnum(v, ((L && !R) || (!L && R)) ? 1.0 : 0.0); /* XOR */
     }
-    return left;
 }
 
-/* Public entry used by executor */
+/* Public entry used by executor: any expression, as a number */
 double parse_rel(Lexer* lx) {
-    return parse_logic(lx);
+    Value v; double d;
+    parse_value(lx, &v);
+    d = val_num(&v);
+    val_free(&v);
+    return d;
 }
 
+int parse_int(Lexer* lx, BasInt* iv, double* dv) {
+    Value v;
+    parse_value(lx, &v);
+    *iv = v.inum;
+    *dv = val_num(&v);
+    val_free(&v);
+    return v.isint;
+}
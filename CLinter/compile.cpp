@@ -0,0 +1,1140 @@
+/* compile.cpp - compile step used by RUN
+   - Turns a crunched statement into a small tree (see compile.h) using the same grammar
+     as parse_rel / exec_statement, so results, evaluation order and error messages match.
+   - Covers numeric LET (scalar and array element), FOR/NEXT, GOTO/GOSUB/RETURN, ON, END/STOP,
+     IF ... THEN ... ELSE, PRINT, DIM, READ/RESTORE, OPEN/CLOSE and REM/DATA;
+     everything else keeps running through exec_statement_lx.
+   - Operand types are known here: a string used as a number (VAL, LEN, ASC, SEG$, ...,
+     a string array element) becomes an N_STR node that reads the string where it lives,
+     and STR$/CHR$ in numeric context never build their string. Two strings compared
+     become an N_SCMP node; a '+' that joins text is left to parse_value.
+   - Immediate mode never comes here; it still evaluates with parse_rel.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include "runtime.h"
+#include "parse.h"
+#include "wxecut.h"
+#include "printfunc.h"
+#include "compile.h"
+#include "profile.h"
+
+/* ---------- builtins bound at compile time ---------- */
+static double fn_int(double v) { return floor(v); }
+static double fn_sgn(double v) { return (v > 0) - (v < 0); }
+static double fn_tab(double v) { return v; }
+static double fn_eof_d(double v) { return fn_eof((int)v); }
+static double fn_pos(void) { return (double)(g_print_col + 1); }
+
+/* STR$(v) in numeric context is v after a %.15g round trip: integers below 1e15 print
+   exactly, so only other values go through the text */
+double fn_str_num(double v) {
+    char buf[64];
+    if (v == floor(v) && fabs(v) < 1e15) return v;
+    snprintf(buf, sizeof(buf), "%.15g", v);
+    return atof(buf);
+}
+
+/* CHR$(v) in numeric context: the one-character string reads as a digit or as 0 */
+double fn_chr_num(double v) {
+    int code = (int)v;
+    return code >= '0' && code <= '9' ? (double)(code - '0') : 0.0;
+}
+
+typedef struct { const char* name; double (*fn)(double); } Fn1Def;
+
+static const Fn1Def g_fn1[] = {
+    { "INT", fn_int }, { "SGN", fn_sgn }, { "LOG10", log10 }, { "EOF", fn_eof_d }, { "TAB", fn_tab },
+    { "ATN", atan }, { "COS", cos }, { "SIN", sin }, { "TAN", tan },
+    { "EXP", exp }, { "LOG", log }, { "SQR", sqrt }, { "ABS", fabs },
+    { "STR$", fn_str_num }, { "CHR$", fn_chr_num },
+    { NULL, NULL }
+};
+
+/* ---------- string builtins in numeric context ---------- */
+typedef struct { const char* name; StrFn fn; } StrFnDef;
+
+static const StrFnDef g_strfn[] = {
+    { "VAL", SF_VAL }, { "LEN", SF_LEN }, { "ASC", SF_ASC }, { "SEG$", SF_SEG }, { "MID$", SF_MID },
+    { "LEFT$", SF_LEFT }, { "RIGHT$", SF_RIGHT }, { "TRM$", SF_TRM },
+    { NULL, SF_VAL }
+};
+
+int str_fn_nargs(int fn) {
+    return fn == SF_SEG || fn == SF_MID ? 2 : fn == SF_LEFT || fn == SF_RIGHT ? 1 : 0;
+}
+
+/* atof of the first l bytes of p; the span is only copied when the number runs on past
+   its end */
+static double span_atof(const char* p, int l) {
+    char buf[1024], * end, * tmp;
+    double v = strtod(p, &end);
+    if (end - p <= l) return v;
+    tmp = l < (int)sizeof(buf) ? buf : (char*)malloc((size_t)l + 1);
+    if (!tmp) return 0.0;
+    memcpy(tmp, p, (size_t)l); tmp[l] = 0;
+    v = atof(tmp);
+    if (tmp != buf) free(tmp);
+    return v;
+}
+
+/* parse_value's string functions taken as a number, without building the string */
+double str_fn_num(int fn, const char* s, int sl, double a, double b) {
+    int off, n;
+    switch (fn) {
+    case SF_VAL: return atof(s);
+    case SF_LEN: return (double)sl;
+    case SF_ASC: return sl ? (double)(unsigned char)s[0] : 0.0;
+    }
+    n = str_span(fn, s, sl, a, b, &off);
+    return span_atof(s + off, n);
+}
+
+/* A$ = B$ ... between two strings, as parse_value compares them */
+double str_rel_num(int kind, const char* a, int al, const char* b, int bl) {
+    int c = str_compare(a, al, b, bl);
+    switch (kind) {
+    case N_EQ: return c == 0;
+    case N_NE: return c != 0;
+    case N_LT: return c < 0;
+    case N_GT: return c > 0;
+    case N_LE: return c <= 0;
+    default:   return c >= 0;
+    }
+}
+
+/* ---------- compile cursor over a crunched statement ---------- */
+typedef struct {
+    const CrunchLine* cl;
+    int seg;
+    int k;       /* absolute token index */
+    int ok;      /* cleared when something can't be compiled */
+} Cp;
+
+#define CUR(c)   ((c)->cl->toks[(c)->k].type)
+#define CTEXT(c) ((c)->cl->pool + (c)->cl->toks[(c)->k].text)
+
+static void cp_next(Cp* c) { if (CUR(c) != T_END) c->k++; }
+
+/* lx_peek_stmt_sep for token k: nothing but spaces left in the segment after it */
+static int cp_peek_sep(const Cp* c, int k) {
+    const char* s = c->cl->pool + c->cl->segs[c->seg].src;
+    int j = c->cl->toks[k].end;
+    while (s[j] && isspace((unsigned char)s[j])) j++;
+    return s[j] == ':' || s[j] == '\\' || s[j] == '\0';
+}
+
+/* identifiers are stored in 32-byte names; longer ones keep the interpreter's truncation rules */
+static int cp_ident_ok(Cp* c) {
+    if (CUR(c) != T_IDENT || strlen(CTEXT(c)) > 31) { c->ok = 0; return 0; }
+    return 1;
+}
+
+static void* grow(void* p, int n, size_t elsz) {
+    void* np = realloc(p, (size_t)(n + 1) * elsz);
+    if (!np) { fprintf(stderr, "ERROR: out of memory in compiler\n"); exit(1); }
+    memset((char*)np + (size_t)n * elsz, 0, elsz);
+    return np;
+}
+
+static Node* nd(NodeKind k) {
+    Node* n = (Node*)calloc(1, sizeof(Node));
+    if (!n) { fprintf(stderr, "ERROR: out of memory in compiler\n"); exit(1); }
+    n->kind = k;
+    return n;
+}
+
+static Node* nd2(NodeKind k, Node* a, Node* b) {
+    Node* n = nd(k);
+    n->a = a; n->b = b;
+    switch (k) {
+    case N_NEG: n->isint = a->isint; break;
+    case N_ADD: case N_SUB: case N_MUL: n->isint = a->isint && b->isint; break;
+    case N_NOT: n->isint = 1; break;
+    default: break;
+    }
+    return n;
+}
+
+static void node_free(Node* n) {
+    int i;
+    if (!n) return;
+    node_free(n->a); node_free(n->b);
+    for (i = 0; i < n->nsubs; i++) node_free(n->subs[i]);
+    free(n->subs);
+    free(n);
+}
+
+static Node* cp_logic(Cp* c);
+
+/* '(' subs ')' after an array name, same loop as parse_value / exec_statement */
+static Node** cp_subs(Cp* c, int* nsubs) {
+    Node* tmp[MAX_DIMS]; Node** out; int n = 0, i;
+    cp_next(c);
+    while (CUR(c) != T_RPAREN && CUR(c) != T_END) {
+        if (n >= MAX_DIMS) { c->ok = 0; break; }
+        tmp[n++] = cp_logic(c);
+        if (CUR(c) == T_COMMA) { cp_next(c); continue; }
+        else break;
+    }
+    out = (Node**)malloc(sizeof(Node*) * (n ? n : 1));
+    if (!out) { fprintf(stderr, "ERROR: out of memory in compiler\n"); exit(1); }
+    for (i = 0; i < n; i++) out[i] = tmp[i];
+    *nsubs = n;
+    return out;
+}
+
+/* FN ( arg ) with optional parentheses */
+static Node* cp_arg1(Cp* c) {
+    Node* v;
+    cp_next(c); if (CUR(c) == T_LPAREN) cp_next(c);
+    v = cp_logic(c);
+    if (CUR(c) == T_RPAREN) cp_next(c);
+    return v;
+}
+
+/* string operand of an N_STR node: a literal, a string variable or a string array
+   element on its own; other string expressions stay interpreted */
+static void cp_sarg(Cp* c, Node* n) {
+    if (CUR(c) == T_STRING) n->str = CTEXT(c);
+    else if (CUR(c) != T_IDENT || !is_string_var_name(CTEXT(c)) || builtin_find(CTEXT(c))) { c->ok = 0; return; }
+    else if (!cp_ident_ok(c)) return;
+    else n->name = CTEXT(c);
+    cp_next(c);
+    if (!n->str && CUR(c) == T_LPAREN) {
+        n->sarray = 1;
+        n->subs = cp_subs(c, &n->nsubs);
+        if (CUR(c) == T_RPAREN) cp_next(c);
+    }
+    if (CUR(c) != T_COMMA && CUR(c) != T_RPAREN) c->ok = 0;
+}
+
+static Node* cp_num(double v) { Node* n = nd(N_NUM); n->num = v; return n; }
+
+/* VAL, LEN, ASC, SEG$ ... in numeric context: argument order and defaults of the bi_*
+   and sv_* functions; VAL, LEN or ASC of a literal folds to its value */
+static Node* cp_strfn(Cp* c, StrFn fn) {
+    Node* n = nd(N_STR);
+    int k = str_fn_nargs(fn);
+    n->sfn = fn;
+    n->isstr = fn >= SF_SEG;
+    cp_next(c);
+    if (CUR(c) != T_LPAREN) { c->ok = 0; return n; }
+    cp_next(c);
+    cp_sarg(c, n);
+    if (k > 0) {
+        if (CUR(c) == T_COMMA) { cp_next(c); n->a = cp_logic(c); }
+        else n->a = cp_num(fn == SF_SEG || fn == SF_MID ? 1.0 : 0.0);
+    }
+    if (k > 1) {
+        if (CUR(c) == T_COMMA) { cp_next(c); n->b = cp_logic(c); }
+        else n->b = cp_num(0.0);
+    }
+    if (CUR(c) == T_RPAREN) cp_next(c);
+    if (n->str && !n->isstr) {
+        n->num = str_fn_num(fn, n->str, (int)strlen(n->str), n->a ? n->a->num : 0.0, n->b ? n->b->num : 0.0);
+        node_free(n->a); node_free(n->b);
+        n->a = n->b = NULL;
+        n->str = NULL;
+        n->kind = N_NUM;
+    }
+    return n;
+}
+
+static Node* cp_factor(Cp* c) {
+    TokType t = CUR(c);
+
+    if (!c->ok) return nd(N_NUM);
+
+    /* unary */
+    if (t == T_MINUS) { cp_next(c); return nd2(N_NEG, cp_factor(c), NULL); }
+    if (t == T_PLUS) { Node* n; cp_next(c); n = cp_factor(c); n->isstr = 0; return n; }
+    if (t == T_NOT) { cp_next(c); return nd2(N_NOT, cp_factor(c), NULL); }
+
+    if (t == T_NUMBER) {
+        Node* n = nd(N_NUM);
+        n->num = c->cl->toks[c->k].number;
+        n->isint = n->num == floor(n->num) && fabs(n->num) < 9007199254740992.0;
+        cp_next(c);
+        return n;
+    }
+
+    if (t == T_STRING) { Node* n = nd(N_NUM); n->num = atof(CTEXT(c)); n->str = CTEXT(c); n->isstr = 1; cp_next(c); return n; }
+
+    if (t == T_LPAREN) {
+        Node* v; cp_next(c); v = cp_logic(c);
+        if (CUR(c) == T_RPAREN) cp_next(c);
+        return v;
+    }
+
+    if (t == T_IDENT) {
+        const char* name = CTEXT(c);
+        int i;
+
+        if (builtin_find(name)) {
+            if (!_stricmp(name, "RND")) {
+                Node* n = nd(N_RND);
+                cp_next(c);
+                if (CUR(c) == T_LPAREN) { cp_next(c); n->a = cp_logic(c); if (CUR(c) == T_RPAREN) cp_next(c); }
+                return n;
+            }
+            for (i = 0; g_fn1[i].name; i++) {
+                if (!_stricmp(name, g_fn1[i].name)) {
+                    Node* n = nd(N_FN1);
+                    n->fn1 = g_fn1[i].fn;
+                    n->isstr = is_string_var_name(name);   /* STR$, CHR$ */
+                    n->a = cp_arg1(c);
+                    return n;
+                }
+            }
+            if (!_stricmp(name, "PI") || !_stricmp(name, "POS")) {
+                Node* n;
+                if (!_stricmp(name, "PI")) { n = nd(N_NUM); n->num = 3.14159265358979323846; }
+                else { n = nd(N_FN0); n->fn0 = fn_pos; }
+                cp_next(c);
+                if (CUR(c) == T_LPAREN) { cp_next(c); if (CUR(c) == T_RPAREN) cp_next(c); }
+                return n;
+            }
+            if (!_stricmp(name, "MOD") || !_stricmp(name, "IDIV") || !_stricmp(name, "POW")) {
+                Node* n;
+                if (!_stricmp(name, "POW")) { n = nd(N_FN2); n->fn2 = pow; }
+                else { n = nd(!_stricmp(name, "MOD") ? N_MOD : N_IDIV); n->isint = 1; }
+                cp_next(c); if (CUR(c) == T_LPAREN) cp_next(c);
+                n->a = cp_logic(c); if (CUR(c) == T_COMMA) cp_next(c);
+                n->b = cp_logic(c); if (CUR(c) == T_RPAREN) cp_next(c);
+                return n;
+            }
+            for (i = 0; g_strfn[i].name; i++)
+                if (!_stricmp(name, g_strfn[i].name)) return cp_strfn(c, g_strfn[i].fn);
+            /* INSTR and builtins added with builtin_register: parse_value evaluates them */
+            c->ok = 0;
+            return nd(N_NUM);
+        }
+
+        /* variable / array element */
+        if (!cp_ident_ok(c)) return nd(N_NUM);
+        cp_next(c);
+        if (CUR(c) == T_LPAREN) {
+            Node* n = nd(is_string_var_name(name) ? N_STR : N_ARR);   /* N_STR: VAL of the element */
+            n->sarray = n->isstr = n->kind == N_STR;
+            n->name = name;
+            n->isint = is_int_var_name(name);
+            n->subs = cp_subs(c, &n->nsubs);
+            if (CUR(c) == T_RPAREN) cp_next(c);
+            return n;
+        }
+        { Node* n = nd(N_VAR); n->name = name; n->isint = is_int_var_name(name); n->isstr = is_string_var_name(name); return n; }
+    }
+    return nd(N_NUM);   /* parse_value yields 0.0 without consuming */
+}
+
+static Node* cp_power(Cp* c) {
+    Node* left = cp_factor(c);
+    if (CUR(c) == T_POWOP) { cp_next(c); left = nd2(N_POW, left, cp_power(c)); }
+    return left;
+}
+
+static Node* cp_term(Cp* c) {
+    Node* v = cp_power(c);
+    while (CUR(c) == T_STAR || CUR(c) == T_SLASH) {
+        NodeKind k = CUR(c) == T_STAR ? N_MUL : N_DIV; cp_next(c);
+        v = nd2(k, v, cp_power(c));
+    }
+    return v;
+}
+
+/* '+' with a string on either side joins text: left to parse_value */
+static Node* cp_expr(Cp* c) {
+    Node* v = cp_term(c);
+    while (CUR(c) == T_PLUS || CUR(c) == T_MINUS) {
+        NodeKind k = CUR(c) == T_PLUS ? N_ADD : N_SUB; cp_next(c);
+        v = nd2(k, v, cp_term(c));
+        if (k == N_ADD && (v->a->isstr || v->b->isstr)) c->ok = 0;
+    }
+    return v;
+}
+
+/* a string operand of N_SCMP as an SF_VAL N_STR node: a literal, A$ or A$(i) */
+static Node* cp_sop(Cp* c, Node* n) {
+    if (n->kind == N_VAR || (n->kind == N_NUM && n->str)) n->kind = N_STR;
+    else if (n->kind != N_STR || n->sfn != SF_VAL) c->ok = 0;
+    n->sfn = SF_VAL;
+    return n;
+}
+
+static Node* cp_relation(Cp* c) {
+    Node* lhs = cp_expr(c);
+    NodeKind k;
+    switch (CUR(c)) {
+    case T_EQ: k = N_EQ; break;
+    case T_NE: k = N_NE; break;
+    case T_LT: k = N_LT; break;
+    case T_GT: k = N_GT; break;
+    case T_LE: k = N_LE; break;
+    case T_GE: k = N_GE; break;
+    default: return lhs;
+    }
+    cp_next(c);
+    {
+        Node* rhs = cp_expr(c);
+        if (lhs->isstr && rhs->isstr) {
+            Node* n = nd2(N_SCMP, cp_sop(c, lhs), cp_sop(c, rhs));
+            n->sfn = k;
+            return n;
+        }
+        return nd2(k, lhs, rhs);
+    }
+}
+
+static Node* cp_logic(Cp* c) {
+    Node* left = cp_relation(c);
+    while (CUR(c) == T_AND || CUR(c) == T_OR || CUR(c) == T_XOR) {
+        NodeKind k = CUR(c) == T_AND ? N_AND : CUR(c) == T_OR ? N_OR : N_XOR; cp_next(c);
+        left = nd2(k, left, cp_relation(c));
+    }
+    return left;
+}
+
+/* ---------- statements ---------- */
+static Stmt* st(StmtKind k) {
+    Stmt* s = (Stmt*)calloc(1, sizeof(Stmt));
+    if (!s) { fprintf(stderr, "ERROR: out of memory in compiler\n"); exit(1); }
+    s->kind = k;
+    return s;
+}
+
+void stmt_free(Stmt* s) {
+    int i;
+    if (!s) return;
+    node_free(s->expr); node_free(s->to); node_free(s->step);
+    for (i = 0; i < s->nsubs; i++) node_free(s->subs[i]);
+    free(s->subs);
+    stmt_free(s->then_s); stmt_free(s->else_s);
+    for (i = 0; i < s->npops; i++) {
+        PrintOp* op = &s->pops[i];
+        int j, k;
+        node_free(op->expr);
+        for (j = 0; j < op->nparts; j++) {
+            PrintPart* pp = &op->parts[j];
+            node_free(pp->a); node_free(pp->b);
+            for (k = 0; k < pp->nsubs; k++) node_free(pp->subs[k]);
+            free(pp->subs);
+        }
+        free(op->parts);
+    }
+    free(s->pops);
+    for (i = 0; i < s->ntg; i++) {
+        int k;
+        for (k = 0; k < s->tg[i].nsubs; k++) node_free(s->tg[i].subs[k]);
+        free(s->tg[i].subs);
+    }
+    free(s->tg);
+    free(s->lines);
+    free(s);
+}
+
+static Stmt* cp_fail(Cp* c, Stmt* s) { stmt_free(s); c->ok = 0; return NULL; }
+
+/* <var>[(subs)] = <expr> after optional LET; 'viaIf' follows exec_assignment instead */
+static Stmt* cp_assign(Cp* c, int viaIf) {
+    Stmt* s;
+    const char* name;
+    if (CUR(c) == T_LET) cp_next(c);
+    if (!cp_ident_ok(c)) return NULL;
+    name = CTEXT(c);
+    if (is_string_var_name(name)) { c->ok = 0; return NULL; }
+    cp_next(c);
+    if (CUR(c) == T_LPAREN) {
+        s = st(S_LETARR);
+        s->subs = cp_subs(c, &s->nsubs);
+        if (CUR(c) != T_RPAREN && !viaIf) return cp_fail(c, s);
+        if (CUR(c) == T_RPAREN) cp_next(c);
+    }
+    else {
+        s = st(S_LET);
+        s->clear_str = viaIf;
+    }
+    if (CUR(c) != T_EQ) return cp_fail(c, s);
+    cp_next(c);
+    s->name = name;
+    s->expr = cp_logic(c);
+    return s;
+}
+
+/* ---------- PRINT: replay exec_print's walk over the tokens ---------- */
+static int cp_print_stop(Cp* c) { return cp_peek_sep(c, c->k) || CUR(c) == T_END || CUR(c) == T_ELSE; }
+
+static PrintOp* cp_pop(Stmt* s, PrintOpKind k) {
+    s->pops = (PrintOp*)grow(s->pops, s->npops, sizeof(PrintOp));
+    s->pops[s->npops].kind = k;
+    return &s->pops[s->npops++];
+}
+
+static PrintPart* cp_part(PrintOp* op, PartKind k) {
+    PrintPart* pp;
+    op->parts = (PrintPart*)grow(op->parts, op->nparts, sizeof(PrintPart));
+    pp = &op->parts[op->nparts++];
+    pp->kind = k;
+    return pp;
+}
+
+/* a string-typed node (isstr) as a part; MID$ is SEG$, LEFT$ / RIGHT$ and SEG$ of an
+   array element stay interpreted */
+static void cp_spart(Cp* c, PrintOp* op, Node* n) {
+    PrintPart* pp;
+    if (n->kind == N_NUM) cp_part(op, PP_STR)->text = n->str;
+    else if (n->kind == N_VAR) cp_part(op, PP_SVAR)->text = n->name;
+    else if (n->kind == N_FN1) {
+        pp = cp_part(op, n->fn1 == fn_chr_num ? PP_CHR : PP_STRS);
+        pp->a = n->a; n->a = NULL;
+    }
+    else if (n->sfn == SF_VAL) {
+        pp = cp_part(op, PP_SARR);
+        pp->text = n->name;
+        pp->subs = n->subs; pp->nsubs = n->nsubs;
+        n->subs = NULL; n->nsubs = 0;
+    }
+    else if ((n->sfn == SF_SEG || n->sfn == SF_MID || n->sfn == SF_TRM) && !n->sarray) {
+        pp = cp_part(op, n->sfn == SF_TRM ? PP_TRM : PP_SEG);
+        pp->text = n->str ? n->str : n->name;
+        pp->text_is_var = !n->str;
+        pp->a = n->a; pp->b = n->b;
+        n->a = n->b = NULL;
+    }
+    else c->ok = 0;
+    node_free(n);
+}
+
+/* One item, as parse_value evaluates it. A numeric expression is one part. Otherwise it
+   is a '+' chain: numeric terms before the first string still add, every term after it
+   is joined as its own part; '-' after a string and comparisons of a joined string stay
+   interpreted. */
+static void cp_print_item(Cp* c, PrintOp* op) {
+    int k0 = c->k, str = 0;
+    NodeKind join = N_ADD;
+    Node* run = NULL;
+    Node* n = cp_logic(c);
+    if (c->ok) {
+        if (n->isstr) cp_spart(c, op, n);
+        else cp_part(op, PP_NUM)->a = n;
+        return;
+    }
+    node_free(n);
+    c->k = k0; c->ok = 1;
+    for (;;) {
+        Node* t = cp_term(c);
+        if (join == N_SUB) run = nd2(N_SUB, run, t);
+        else if (t->isstr) {
+            if (run) { cp_part(op, PP_NUM)->a = run; run = NULL; }
+            cp_spart(c, op, t);
+            str = 1;
+        }
+        else if (str) cp_part(op, PP_NUM)->a = t;
+        else run = run ? nd2(N_ADD, run, t) : t;
+        if (CUR(c) == T_PLUS) { join = N_ADD; cp_next(c); continue; }
+        if (CUR(c) == T_MINUS && !str) { join = N_SUB; cp_next(c); continue; }
+        break;
+    }
+    if (run) cp_part(op, PP_NUM)->a = run;
+    switch (CUR(c)) {
+    case T_MINUS: case T_EQ: case T_NE: case T_LT: case T_GT: case T_LE: case T_GE:
+    case T_AND: case T_OR: case T_XOR:
+        c->ok = 0;
+        break;
+    default: break;
+    }
+}
+
+static Stmt* cp_print(Cp* c) {
+    Stmt* s = st(S_PRINT);
+    s->handle = -1;
+    cp_next(c);
+    if (CUR(c) == T_HASH) {
+        cp_next(c);
+        if (CUR(c) != T_NUMBER) return cp_fail(c, s);
+        s->handle = (int)c->cl->toks[c->k].number;
+        if (s->handle < 0) s->handle = MAX_FILES;   /* never valid -> "bad handle" */
+        cp_next(c);
+        if (CUR(c) == T_COMMA || CUR(c) == T_SEMI) cp_next(c);
+    }
+    while (c->ok && !cp_print_stop(c)) {
+        PrintOp* op;
+        if (CUR(c) == T_IDENT && !_stricmp(CTEXT(c), "TAB")) {
+            op = cp_pop(s, PO_TAB);
+            cp_next(c);
+            if (CUR(c) == T_LPAREN) cp_next(c);
+            op->expr = cp_logic(c);
+            if (CUR(c) == T_RPAREN) cp_next(c);
+            if (CUR(c) == T_ELSE) break;
+            if (CUR(c) == T_COMMA) { cp_next(c); cp_pop(s, PO_ZONE); if (cp_print_stop(c)) break; continue; }
+            if (CUR(c) == T_SEMI) { cp_pop(s, PO_SEMI); cp_next(c); if (cp_print_stop(c)) break; continue; }
+            if (cp_print_stop(c)) break;
+            continue;
+        }
+
+        op = cp_pop(s, PO_ITEM);
+        cp_print_item(c, op);
+        if (CUR(c) == T_ELSE) break;
+        if (CUR(c) == T_COMMA) { cp_next(c); cp_pop(s, PO_ZONE); if (cp_print_stop(c)) break; continue; }
+        if (CUR(c) == T_SEMI) { cp_pop(s, PO_SEMI); cp_next(c); if (cp_print_stop(c)) break; continue; }
+        break;
+    }
+    if (!c->ok) return cp_fail(c, s);
+    return s;
+}
+
+static Stmt* cp_on(Cp* c) {
+    Stmt* s = st(S_ON);
+    cp_next(c);
+    s->expr = cp_logic(c);
+    if (CUR(c) == T_GOTO) s->mode = 0;
+    else if (CUR(c) == T_GOSUB) s->mode = 1;
+    else return cp_fail(c, s);
+    cp_next(c);
+    while (CUR(c) == T_NUMBER && s->nlines < 64) {
+        s->lines = (int*)grow(s->lines, s->nlines, sizeof(int));
+        s->lines[s->nlines++] = (int)c->cl->toks[c->k].number;
+        cp_next(c);
+        if (CUR(c) == T_COMMA) { cp_next(c); continue; }
+        else break;
+    }
+    if (s->nlines == 0) return cp_fail(c, s);
+    return s;
+}
+
+/* DIM A(n[,m...])[, B$(...)] and READ v[(subs)][, ...] */
+static Stmt* cp_targets(Cp* c, StmtKind kind) {
+    Stmt* s = st(kind);
+    for (;;) {
+        Target* t;
+        cp_next(c);
+        if (!cp_ident_ok(c)) return cp_fail(c, s);
+        s->tg = (Target*)grow(s->tg, s->ntg, sizeof(Target));
+        t = &s->tg[s->ntg++];
+        t->name = CTEXT(c);
+        t->nsubs = -1;
+        cp_next(c);
+        if (CUR(c) == T_LPAREN) {
+            t->subs = cp_subs(c, &t->nsubs);
+            if (CUR(c) != T_RPAREN) return cp_fail(c, s);
+            cp_next(c);
+        }
+        else if (kind == S_DIM) return cp_fail(c, s);
+        if (CUR(c) == T_COMMA) continue;
+        break;
+    }
+    if (!c->ok) return cp_fail(c, s);
+    return s;
+}
+
+static Stmt* cp_open(Cp* c) {
+    Stmt* s = st(S_OPEN);
+    cp_next(c);
+    if ((CUR(c) != T_STRING && CUR(c) != T_IDENT) || strlen(CTEXT(c)) > 259) return cp_fail(c, s);
+    s->name = CTEXT(c);
+    cp_next(c);
+    if (CUR(c) != T_FOR) return cp_fail(c, s);
+    cp_next(c);
+    if (CUR(c) == T_INPUT) s->mode = 0;
+    else if (CUR(c) == T_OUTPUTKW) s->mode = 1;
+    else if (CUR(c) == T_APPEND) s->mode = 2;
+    else return cp_fail(c, s);
+    cp_next(c);
+    if (CUR(c) != T_AS) return cp_fail(c, s);
+    cp_next(c);
+    if (CUR(c) == T_HASH) cp_next(c);
+    if (CUR(c) != T_NUMBER) return cp_fail(c, s);
+    s->handle = (int)c->cl->toks[c->k].number;
+    return s;
+}
+
+static Stmt* cp_close(Cp* c) {
+    Stmt* s = st(S_CLOSE);
+    s->handle = -1;
+    cp_next(c);
+    if (CUR(c) == T_HASH || CUR(c) == T_NUMBER) {
+        if (CUR(c) == T_HASH) cp_next(c);
+        if (CUR(c) != T_NUMBER) return cp_fail(c, s);
+        s->handle = (int)c->cl->toks[c->k].number;
+        if (s->handle < 0) s->handle = MAX_FILES;   /* out of range: nothing to close */
+    }
+    return s;
+}
+
+/* one IF branch, as run_if_single_stmt would see it at token k */
+static Stmt* cp_branch(Cp* c, int k) {
+    Cp b = *c;
+    Stmt* s = NULL;
+    b.k = k; b.ok = 1;
+    if (CUR(&b) == T_NUMBER) {
+        s = st(S_GOTO); s->line = (int)b.cl->toks[b.k].number;
+    }
+    else if (CUR(&b) == T_GOTO || CUR(&b) == T_GOSUB) {
+        StmtKind kind = CUR(&b) == T_GOTO ? S_GOTO : S_GOSUB;
+        cp_next(&b);
+        if (CUR(&b) == T_NUMBER) { s = st(kind); s->line = (int)b.cl->toks[b.k].number; }
+    }
+    else if (CUR(&b) == T_PRINT) s = cp_print(&b);
+    else if (CUR(&b) == T_LET || CUR(&b) == T_IDENT) s = cp_assign(&b, 1);
+    if (!s || !b.ok) {
+        stmt_free(s);
+        s = st(S_INTERP);
+        s->tok = k;
+    }
+    return s;
+}
+
+static Stmt* cp_if(Cp* c) {
+    Stmt* s = st(S_IF);
+    int thenTok, j;
+    cp_next(c);
+    s->expr = cp_logic(c);
+    if (!c->ok || CUR(c) != T_THEN) return cp_fail(c, s);
+    cp_next(c);
+    thenTok = c->k;
+
+    s->then_s = cp_branch(c, thenTok);
+
+    /* where the false path finds ELSE: first ELSE, unless the THEN part ends the statement first */
+    j = thenTok - 1 + c->cl->toks[thenTok - 1].skip;
+    if (c->cl->toks[j].type == T_ELSE) s->else_s = cp_branch(c, j + 1);
+    return s;
+}
+
+Stmt* stmt_compile(const CrunchLine* cl, int seg) {
+    Cp c;
+    Stmt* s = NULL;
+    c.cl = cl; c.seg = seg; c.k = cl->segs[seg].first; c.ok = 1;
+
+    switch (CUR(&c)) {
+    case T_ENDKW: case T_STOP:
+        s = st(S_END);
+        break;
+    case T_IF:
+        s = cp_if(&c);
+        break;
+    case T_GOTO: case T_GOSUB: {
+        StmtKind kind = CUR(&c) == T_GOTO ? S_GOTO : S_GOSUB;
+        cp_next(&c);
+        if (CUR(&c) != T_NUMBER) return NULL;
+        s = st(kind); s->line = (int)cl->toks[c.k].number;
+    } break;
+    case T_RETURN:
+        s = st(S_RETURN);
+        break;
+    case T_FOR:
+        s = st(S_FOR);
+        cp_next(&c);
+        if (!cp_ident_ok(&c)) break;
+        s->name = CTEXT(&c);
+        cp_next(&c); if (CUR(&c) != T_EQ) { c.ok = 0; break; }
+        cp_next(&c); s->expr = cp_logic(&c);
+        if (CUR(&c) != T_TO) { c.ok = 0; break; }
+        cp_next(&c); s->to = cp_logic(&c);
+        if (CUR(&c) == T_STEP) { cp_next(&c); s->step = cp_logic(&c); }
+        break;
+    case T_NEXT:
+        s = st(S_NEXT);
+        cp_next(&c);
+        if (CUR(&c) == T_IDENT) s->name = CTEXT(&c);
+        break;
+    case T_LET: case T_IDENT:
+        s = cp_assign(&c, 0);
+        break;
+    case T_ONKW:
+        s = cp_on(&c);
+        break;
+    case T_PRINT:
+        s = cp_print(&c);
+        break;
+    case T_DIM: case T_READ:
+        s = cp_targets(&c, CUR(&c) == T_DIM ? S_DIM : S_READ);
+        break;
+    case T_RESTORE:
+        s = st(S_RESTORE);
+        cp_next(&c);
+        s->line = (CUR(&c) == T_NUMBER) ? (int)cl->toks[c.k].number : -1;
+        break;
+    case T_OPEN:
+        s = cp_open(&c);
+        break;
+    case T_CLOSE:
+        s = cp_close(&c);
+        break;
+    case T_REM: case T_DATA:
+        s = st(S_REM);
+        break;
+    default:
+        return NULL;
+    }
+    if (!s || !c.ok) { stmt_free(s); return NULL; }
+    return s;
+}
+
+void line_compile(CrunchLine* cl) {
+    int k;
+    for (k = 0; k < cl->nseg; k++) {
+        if (cl->segs[k].compiled) continue;
+        cl->segs[k].stmt = stmt_compile(cl, k);
+        cl->segs[k].compiled = 1;
+    }
+}
+
+void prog_compile(void) {
+    int i;
+    for (i = 0; i < g_prog_count; i++) {
+        if (g_prog[i].code) line_compile(g_prog[i].code);
+    }
+}
+
+/* ---------- evaluator ---------- */
+static int bind_var(Node* n) {
+    if (n->var && n->epoch == g_var_epoch) return n->var - 1;
+    n->var = find_var(n->name) + 1;   /* reads never create; stay unbound until the variable exists */
+    n->epoch = g_var_epoch;
+    return n->var - 1;
+}
+
+static Array* bind_arr(const char* name, Array** slot, unsigned* epoch) {
+    if (*slot && *epoch == g_var_epoch) return *slot;
+    *slot = array_find(name);
+    *epoch = g_var_epoch;
+    return *slot;
+}
+
+/* the string an N_STR node reads, in place, and its length */
+static const char* node_sref(Node* n, int* len) {
+    int subs[MAX_DIMS], i;
+    if (n->str) { *len = (int)strlen(n->str); return n->str; }
+    if (!n->sarray) return var_strn(bind_var(n), len);
+    for (i = 0; i < n->nsubs; i++) subs[i] = (int)node_eval(n->subs[i]);
+    if (!n->sarr || n->epoch != g_var_epoch) { n->sarr = sarray_find(n->name); n->epoch = g_var_epoch; }
+    if (!n->sarr) { *len = 0; return ""; }
+    return sarray_getn(n->sarr, subs, n->nsubs, len);
+}
+
+static int node_ieval(Node* n, BasInt* iv, double* dv);
+
+/* MOD / IDIV / NOT operand */
+static BasInt node_int_operand(Node* n) {
+    BasInt i; double d;
+    if (n->isint && node_ieval(n, &i, &d)) return i;
+    return num_trunc(n->isint ? d : node_eval(n));
+}
+
+/* Evaluate an integer-valued tree (Node.isint) in BasInt: 1 with the value in *iv, or 0
+   with it in *dv when it had to widen (an operand that is not an integer at run time -
+   a name created before its DEFINT - or a result that would overflow). */
+static int node_ieval(Node* n, BasInt* iv, double* dv) {
+    BasInt a = 0, b = 0;
+    double da = 0.0, db = 0.0;
+    int ia, ib;
+    switch (n->kind) {
+    case N_NUM:
+        *iv = (BasInt)n->num;
+        return 1;
+    case N_VAR: {
+        int v = bind_var(n);
+        if (v >= 0 && g_var_type[v] == VT_INT) { *iv = g_var_int[v]; return 1; }
+        *dv = var_value(v);
+        return 0;
+    }
+    case N_ARR: {
+        int subs[MAX_DIMS], i, k; Array* arr;
+        for (i = 0; i < n->nsubs; i++) subs[i] = (int)node_eval(n->subs[i]);
+        arr = bind_arr(n->name, &n->arr, &n->epoch);
+        if (!arr) { printf("ERROR: UNDIM'D ARRAY %s\n", n->name); *dv = 0.0; return 0; }
+        if (!arr->idata || (k = array_index(arr, subs, n->nsubs)) < 0) { *dv = array_get(arr, subs, n->nsubs); return 0; }
+        *iv = arr->idata[k];
+        return 1;
+    }
+    case N_NEG:
+        if (node_ieval(n->a, &a, &da)) { if (a != LLONG_MIN) { *iv = -a; return 1; } da = (double)a; }
+        *dv = -da;
+        return 0;
+    case N_NOT:
+        *iv = ~node_int_operand(n->a);
+        return 1;
+    case N_MOD: case N_IDIV:
+        a = node_int_operand(n->a);
+        b = node_int_operand(n->b);
+        if (n->kind == N_MOD ? int_mod(a, b, iv) : int_idiv(a, b, iv)) return 1;
+        *dv = (double)a / (double)b;
+        return 0;
+    case N_ADD: case N_SUB: case N_MUL:
+        ia = node_ieval(n->a, &a, &da);
+        ib = node_ieval(n->b, &b, &db);
+        if (ia && ib && (n->kind == N_ADD ? int_add(a, b, iv) : n->kind == N_SUB ? int_sub(a, b, iv) : int_mul(a, b, iv)))
+            return 1;
+        if (ia) da = (double)a;
+        if (ib) db = (double)b;
+        *dv = n->kind == N_ADD ? da + db : n->kind == N_SUB ? da - db : da * db;
+        return 0;
+    default:
+        *dv = node_eval(n);
+        return 0;
+    }
+}
+
+/* an integer-valued tree in a numeric context: exact until it has to widen */
+static double node_inum(Node* n) {
+    BasInt i; double d;
+    return node_ieval(n, &i, &d) ? (double)i : d;
+}
+
+/* STR$ of one in a numeric context: an exact value's %lld text reads back as itself */
+static double node_istr(Node* n) {
+    BasInt i; double d;
+    return node_ieval(n, &i, &d) ? (double)i : fn_str_num(d);
+}
+
+double node_eval(Node* n) {
+    switch (n->kind) {
+    case N_NUM: return n->num;
+    case N_VAR: return var_value(bind_var(n));
+    case N_ARR: {
+        int subs[MAX_DIMS], i; Array* a;
+        for (i = 0; i < n->nsubs; i++) subs[i] = (int)node_eval(n->subs[i]);
+        a = bind_arr(n->name, &n->arr, &n->epoch);
+        if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", n->name); return 0.0; }
+        return array_get(a, subs, n->nsubs);
+    }
+    case N_NEG: return -node_eval(n->a);
+    case N_NOT: return (double)(~node_int_operand(n->a));
+    case N_POW: { double l = node_eval(n->a); return pow(l, node_eval(n->b)); }
+    case N_MUL: { double l; if (n->isint) return node_inum(n); l = node_eval(n->a); return l * node_eval(n->b); }
+    case N_DIV: { double l = node_eval(n->a); return l / node_eval(n->b); }
+    case N_ADD: { double l; if (n->isint) return node_inum(n); l = node_eval(n->a); return l + node_eval(n->b); }
+    case N_SUB: { double l; if (n->isint) return node_inum(n); l = node_eval(n->a); return l - node_eval(n->b); }
+    case N_EQ: { double l = node_eval(n->a); return (l == node_eval(n->b)) ? 1.0 : 0.0; }
+    case N_NE: { double l = node_eval(n->a); return (l != node_eval(n->b)) ? 1.0 : 0.0; }
+    case N_LT: { double l = node_eval(n->a); return (l < node_eval(n->b)) ? 1.0 : 0.0; }
+    case N_GT: { double l = node_eval(n->a); return (l > node_eval(n->b)) ? 1.0 : 0.0; }
+    case N_LE: { double l = node_eval(n->a); return (l <= node_eval(n->b)) ? 1.0 : 0.0; }
+    case N_GE: { double l = node_eval(n->a); return (l >= node_eval(n->b)) ? 1.0 : 0.0; }
+    case N_AND: case N_OR: case N_XOR: {
+        int L = (node_eval(n->a) != 0.0);
+        int R = (node_eval(n->b) != 0.0);
+        if (n->kind == N_AND) return (L && R) ? 1.0 : 0.0;
+        if (n->kind == N_OR) return (L || R) ? 1.0 : 0.0;
+        return ((L && !R) || (!L && R)) ? 1.0 : 0.0;
+    }
+    case N_FN0: return n->fn0();
+    case N_FN1:
+        if (n->fn1 == fn_str_num && n->a->isint) return node_istr(n->a);
+        return n->fn1(node_eval(n->a));
+    case N_FN2: { double l = node_eval(n->a); return n->fn2(l, node_eval(n->b)); }
+    case N_MOD: case N_IDIV: return node_inum(n);
+    case N_RND:
+        if (n->a) (void)node_eval(n->a);
+        return fn_rnd();
+    case N_SCMP: {
+        int al, bl;
+        const char* a = node_sref(n->a, &al);
+        const char* b = node_sref(n->b, &bl);
+        return str_rel_num(n->sfn, a, al, b, bl);
+    }
+    case N_STR: {
+        double a = n->a ? node_eval(n->a) : 0.0;
+        double b = n->b ? node_eval(n->b) : 0.0;
+        int sl;
+        const char* s = node_sref(n, &sl);
+        return str_fn_num(n->sfn, s, sl, a, b);
+    }
+    }
+    return 0.0;
+}
+
+const char* node_fn_name(const Node* n) {
+    int i;
+    switch (n->kind) {
+    case N_FN0: return "POS";
+    case N_FN2: return "POW";
+    case N_FN1:
+        for (i = 0; g_fn1[i].name; i++) if (g_fn1[i].fn == n->fn1) return g_fn1[i].name;
+        break;
+    default: break;
+    }
+    return NULL;
+}
+
+/* ---------- PRINT ---------- */
+static const char* part_str_var(PrintPart* pp, int* len) {
+    if (!pp->var || pp->epoch != g_var_epoch) {
+        pp->var = find_var(pp->text) + 1;
+        pp->epoch = g_var_epoch;
+    }
+    return var_strn(pp->var - 1, len);
+}
+
+/* a numeric part (or STR$): an exact integer prints every digit */
+static void part_num(Node* n, ByteBuf* b) {
+    BasInt i; double d;
+    if (!n->isint) bb_append_num(b, node_eval(n));
+    else if (node_ieval(n, &i, &d)) bb_append_int(b, i);
+    else bb_append_num(b, d);
+}
+
+static void part_append(PrintPart* pp, ByteBuf* b) {
+    int subs[MAX_DIMS], i, sl;
+    const char* s;
+    switch (pp->kind) {
+    case PP_NUM: part_num(pp->a, b); break;
+    case PP_STR: bb_append_cstr(b, pp->text); break;
+    case PP_SVAR: s = part_str_var(pp, &sl); bb_append(b, s, (size_t)sl); break;
+    case PP_SARR: {
+        SArray* sa = pp->sarr;
+        if (!sa || pp->epoch != g_var_epoch) { sa = sarray_find(pp->text); pp->sarr = sa; pp->epoch = g_var_epoch; }
+        for (i = 0; i < pp->nsubs; i++) subs[i] = (int)node_eval(pp->subs[i]);
+        if (sa) { s = sarray_getn(sa, subs, pp->nsubs, &sl); bb_append(b, s, (size_t)sl); }
+    } break;
+    case PP_CHR: bb_append_chr(b, node_eval(pp->a)); break;
+    case PP_STRS: part_num(pp->a, b); break;
+    case PP_SEG: case PP_TRM: {
+        const char* src = !pp->text ? "" : pp->text_is_var ? part_str_var(pp, &sl) : pp->text;
+        if (!pp->text_is_var) sl = (int)strlen(src);
+        if (pp->kind == PP_TRM) { bb_append_trm(b, src, sl); break; }
+        {
+            int start = pp->a ? (int)node_eval(pp->a) : 1;
+            int len = pp->b ? (int)node_eval(pp->b) : 0;
+            bb_append_seg(b, src, sl, start, len);
+        }
+    } break;
+    }
+}
+
+static int print_exec(Stmt* s) {
+    PrintState ps;
+    int i, j;
+    if (print_begin(&ps, s->handle) < 0) return -1;
+    for (i = 0; i < s->npops; i++) {
+        PrintOp* op = &s->pops[i];
+        switch (op->kind) {
+        case PO_ITEM: {
+            unsigned char store[PRINT_ITEM_MAX]; ByteBuf b;
+            bb_init(&b, store, sizeof(store));
+            for (j = 0; j < op->nparts; j++) part_append(&op->parts[j], &b);
+            print_emit(&ps, &b);
+        } break;
+        case PO_TAB: print_tab(&ps, (int)node_eval(op->expr)); break;
+        case PO_ZONE: print_zone(&ps); break;
+        case PO_SEMI: ps.suppress_nl = 1; break;
+        }
+    }
+    print_end(&ps);
+    return 0;
+}
+
+/* DIM / READ targets: subscripts are evaluated per target, left to right */
+static int targets_exec(Stmt* s) {
+    int subs[MAX_DIMS], i, k;
+    if (s->kind == S_READ) data_maybe_rebuild();
+    for (i = 0; i < s->ntg; i++) {
+        Target* t = &s->tg[i];
+        for (k = 0; k < t->nsubs; k++) subs[k] = (int)node_eval(t->subs[k]);
+        if (s->kind == S_DIM) { if (dim_array(t->name, t->nsubs, subs) < 0) return -1; }
+        else if (read_into(t->name, subs, t->nsubs) < 0) return -1;
+    }
+    return 0;
+}
+
+/* run an IF branch */
+static int branch_exec(Stmt* b, const CrunchLine* cl, int seg, int currentLine, int* outJump) {
+    if (b->kind == S_INTERP) {
+        Lexer lx;
+        lx_init_crunched(&lx, cl, seg);
+        lx.tk = cl->toks + b->tok;
+        lx_next(&lx);
+        return run_if_single_stmt(&lx, currentLine, outJump);
+    }
+    return stmt_exec(b, cl, seg, currentLine, outJump);
+}
+
+int stmt_exec(Stmt* s, const CrunchLine* cl, int seg, int currentLine, int* outJump) {
+    switch (s->kind) {
+    case S_LET: {
+        BasInt ival = 0;
+        double val = 0.0;
+        int exact = 0, v = s->var - 1;
+        if (s->expr->isint) exact = node_ieval(s->expr, &ival, &val);
+        else val = node_eval(s->expr);
+        if (v < 0 || s->epoch != g_var_epoch) {
+            v = s->clear_str ? find_var(s->name) : -1;
+            if (v < 0) v = ensure_var(s->name, 0);
+            if (v < 0) { printf("ERROR: VARIABLE TABLE FULL\n"); return -1; }
+            s->var = v + 1; s->epoch = g_var_epoch;
+        }
+        if (g_var_type[v] == VT_INT) {
+            if (exact) { g_var_int[v] = ival; return 0; }
+            return num_to_int(val, &g_var_int[v]);
+        }
+        if (exact) val = (double)ival;
+        g_var_type[v] = VT_NUM;
+        if (s->clear_str && g_var_str[v].len) bstr_free(&g_var_str[v]);
+        g_var_num[v] = val;
+        return 0;
+    }
+    case S_LETARR: {
+        int subs[MAX_DIMS], i, k, exact = 0; BasInt ival = 0; double val = 0.0; Array* a;
+        for (i = 0; i < s->nsubs; i++) subs[i] = (int)node_eval(s->subs[i]);
+        if (s->expr->isint) exact = node_ieval(s->expr, &ival, &val);
+        else val = node_eval(s->expr);
+        a = bind_arr(s->name, &s->arr, &s->epoch);
+        if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", s->name); return -1; }
+        if (exact && a->idata && (k = array_index(a, subs, s->nsubs)) >= 0) { a->idata[k] = ival; return 0; }
+        array_set(a, subs, s->nsubs, exact ? (double)ival : val);
+        return 0;
+    }
+    case S_FOR: {
+        double start = node_eval(s->expr);
+        double toVal = node_eval(s->to);
+        double step = s->step ? node_eval(s->step) : 1.0;
+        return for_push(s->name, start, toVal, step, currentLine);
+    }
+    case S_NEXT:
+        return for_next(s->name, outJump);
+    case S_GOTO:
+        *outJump = s->line;
+        return 1;
+    case S_GOSUB:
+        if (gosub_push(currentLine) < 0) return -1;
+        *outJump = s->line;
+        return 1;
+    case S_RETURN:
+        return gosub_return(outJump);
+    case S_END:
+        return 9;
+    case S_IF: {
+        double cond = node_eval(s->expr);
+        if (g_profile) { if (cond != 0.0) s->taken++; else s->not_taken++; }
+        if (cond != 0.0) return branch_exec(s->then_s, cl, seg, currentLine, outJump);
+        if (s->else_s) return branch_exec(s->else_s, cl, seg, currentLine, outJump);
+        return 0;
+    }
+    case S_ON:
+        return on_jump((int)node_eval(s->expr), s->mode, s->lines, s->nlines, currentLine, outJump);
+    case S_PRINT:
+        return print_exec(s);
+    case S_DIM: case S_READ:
+        return targets_exec(s);
+    case S_RESTORE:
+        restore_data(s->line);
+        return 0;
+    case S_OPEN:
+        return open_file(s->name, s->mode, s->handle);
+    case S_CLOSE:
+        close_file(s->handle);
+        return 0;
+    case S_REM:
+        return 0;
+    case S_INTERP:
+        return branch_exec(s, cl, seg, currentLine, outJump);
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+#ifndef COMPILE_H
+#define COMPILE_H
+#include "runtime.h"
+#include "parse.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ---- Expression trees ----
+   Built from a crunched token stream with the same grammar as parse_rel.
+   Variable and array references are bound to their table slot on first use
+   and stay bound until g_var_epoch changes; builtins are bound to C functions. */
+typedef enum {
+    N_NUM, N_VAR, N_ARR,
+    N_NEG, N_NOT,
+    N_POW, N_MUL, N_DIV, N_ADD, N_SUB,
+    N_EQ, N_NE, N_LT, N_GT, N_LE, N_GE,
+    N_AND, N_OR, N_XOR,
+    N_FN0, N_FN1, N_FN2,
+    N_MOD, N_IDIV, N_RND,
+    N_STR,       /* number read from a string operand (VAL, LEN, ASC, SEG$ ... in numeric context) */
+    N_SCMP       /* comparison of two strings: a / b are SF_VAL N_STR operands, sfn the N_EQ..N_GE kind */
+} NodeKind;
+
+/* An N_STR node applies a StrFn (parse.h) to its operand. The operand is read in place,
+   so nothing is copied to a buffer just to be parsed again (see str_fn_num). */
+
+typedef struct Node {
+    NodeKind kind;
+    double num;                  /* N_NUM */
+    const char* name;            /* N_VAR / N_ARR: identifier as written (CrunchLine pool) */
+    int var;                     /* bound slot + 1, 0 = unbound */
+    Array* arr;
+    unsigned epoch;              /* g_var_epoch the slot was bound in */
+    double (*fn0)(void);
+    double (*fn1)(double);
+    double (*fn2)(double, double);
+    struct Node* a;              /* operand / first argument */
+    struct Node* b;              /* second operand / argument */
+    struct Node** subs;          /* N_ARR subscripts */
+    int nsubs;
+    int isint;                   /* integer-valued: integral literal, A% / DEFINT name, and
+                                    + - * MOD IDIV NOT over those (evaluated in BasInt) */
+    int sfn;                     /* N_STR: StrFn; a / b are its numeric arguments */
+    const char* str;             /* N_STR operand: literal, NULL = string variable 'name' */
+    int sarray;                  /* N_STR operand is an element of string array 'name' (subs) */
+    SArray* sarr;
+    int isstr;                   /* a string read as a number: literal (str), A$, A$(i), STR$, SEG$ ... */
+} Node;
+
+/* ---- PRINT items ----
+   exec_print's item/separator walk only depends on tokens, so it is resolved at compile
+   time into a list of ops; each item is one or more '+'-joined parts. */
+typedef enum {
+    PP_NUM,       /* numeric expression, %.15g (an exact integer %lld) */
+    PP_STR,       /* string literal */
+    PP_SVAR,      /* string variable */
+    PP_SARR,      /* string array element */
+    PP_CHR, PP_STRS, PP_SEG, PP_TRM
+} PartKind;
+
+typedef struct {
+    PartKind kind;
+    const char* text;            /* literal, variable/array name, or SEG$/TRM$ source (NULL = "") */
+    int text_is_var;             /* SEG$/TRM$ source is a string variable */
+    Node* a;                     /* value / SEG$ start (NULL = 1) */
+    Node* b;                     /* SEG$ length (NULL = rest) */
+    Node** subs;                 /* PP_SARR */
+    int nsubs;
+    int var;                     /* bound string variable slot + 1, 0 = unbound */
+    SArray* sarr;                /* bound string array */
+    unsigned epoch;
+} PrintPart;
+
+typedef enum { PO_ITEM, PO_TAB, PO_ZONE, PO_SEMI } PrintOpKind;
+
+typedef struct {
+    PrintOpKind kind;
+    Node* expr;                  /* PO_TAB column */
+    PrintPart* parts;            /* PO_ITEM */
+    int nparts;
+} PrintOp;
+
+/* DIM / READ target: name with subscripts (READ scalar: nsubs = -1) */
+typedef struct {
+    const char* name;
+    Node** subs;
+    int nsubs;
+} Target;
+
+/* ---- Statements ---- */
+typedef enum {
+    S_LET,        /* numeric scalar assignment */
+    S_LETARR,     /* numeric array element assignment */
+    S_FOR, S_NEXT,
+    S_GOTO, S_GOSUB, S_RETURN, S_END,
+    S_IF,
+    S_ON,         /* ON expr GOTO/GOSUB lines */
+    S_PRINT,
+    S_DIM, S_READ, S_RESTORE,
+    S_OPEN, S_CLOSE,
+    S_REM,        /* REM and DATA: nothing to do at run time */
+    S_INTERP      /* IF branch left to run_if_single_stmt, starting at token 'tok' */
+} StmtKind;
+
+typedef struct Stmt {
+    StmtKind kind;
+    const char* name;            /* assignment target, FOR/NEXT variable (NULL = innermost NEXT), OPEN file */
+    int var;                     /* bound slot + 1, 0 = unbound */
+    Array* arr;
+    unsigned epoch;
+    int clear_str;               /* S_LET via IF branch: exec_assignment also drops v->str */
+    Node* expr;                  /* RHS, FOR start, IF condition */
+    Node* to;
+    Node* step;
+    Node** subs;
+    int nsubs;
+    int line;                    /* GOTO/GOSUB target, RESTORE line (-1 = none) */
+    int tok;                     /* S_INTERP: absolute token index in CrunchLine.toks */
+    struct Stmt* then_s;
+    struct Stmt* else_s;
+    int handle;                  /* PRINT #, OPEN AS #, CLOSE # (-1 = console / all) */
+    int mode;                    /* OPEN: 0 INPUT, 1 OUTPUT, 2 APPEND; ON: 1 = GOSUB */
+    int* lines;                  /* ON target lines */
+    int nlines;
+    PrintOp* pops;               /* PRINT */
+    int npops;
+    Target* tg;                  /* DIM / READ */
+    int ntg;
+    unsigned long taken;         /* S_IF outcomes during a --profile RUN */
+    unsigned long not_taken;
+} Stmt;
+
+/* Compile every statement of the program that has not been compiled yet (run before RUN). */
+void prog_compile(void);
+void line_compile(CrunchLine* cl);
+
+/* Compile one statement; NULL if it has to stay interpreted. */
+Stmt* stmt_compile(const CrunchLine* cl, int seg);
+void  stmt_free(Stmt* s);
+
+/* Execute a compiled statement; same return codes as exec_statement. */
+int    stmt_exec(Stmt* s, const CrunchLine* cl, int seg, int currentLine, int* outJump);
+double node_eval(Node* n);
+
+/* BASIC name of the builtin bound to an N_FN0/N_FN1/N_FN2 node (--emit-c) */
+const char* node_fn_name(const Node* n);
+
+/* Numeric value of a string builtin, as parse_factor computes it through atof:
+   str_fn_num applies StrFn 'fn' (with its str_fn_nargs arguments) to s; STR$ and CHR$
+   take a number, so they never build the string at all. sl is the length of s, which
+   may hold NUL bytes. */
+double str_fn_num(int fn, const char* s, int sl, double a, double b);
+double str_rel_num(int kind, const char* a, int al, const char* b, int bl);   /* N_SCMP: 1.0 / 0.0 */
+int    str_fn_nargs(int fn);
+double fn_str_num(double v);
+double fn_chr_num(double v);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
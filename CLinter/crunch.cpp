@@ -0,0 +1,253 @@
+/* crunch.cpp - pre-lexed ("crunched") program lines
+   - Each stored line is split once into statements (':' or '\' outside quotes), kept
+     as spans of a single copy of the line, and every statement is run through lx_next once.
+   - The result keeps keyword codes, pre-parsed numbers and interned identifier ids,
+     so RUN replays tokens instead of re-scanning text (see lx_init_crunched).
+   - ProgLine.text stays the source of truth for LIST/SAVE/RENUM, so text round-trips unchanged.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "runtime.h"
+#include "parse.h"
+#include "crunch.h"
+#include "compile.h"
+#include "vm.h"
+
+/* ---- identifier interning (open addressing, upper-cased keys) ---- */
+static char** g_sym_names = NULL;
+static int    g_sym_count = 0;
+static int    g_sym_cap = 0;
+static int*   g_sym_slots = NULL;   /* id+1, 0 = empty */
+static int    g_sym_nslots = 0;
+
+static unsigned sym_hash(const char* s) {
+    unsigned h = 2166136261u;
+    for (; *s; s++) { h ^= (unsigned char)toupper((unsigned char)*s); h *= 16777619u; }
+    return h;
+}
+
+static void sym_rehash(int nslots) {
+    int i;
+    int* ns = (int*)calloc((size_t)nslots, sizeof(int));
+    if (!ns) { fprintf(stderr, "ERROR: out of memory in symbol table\n"); exit(1); }
+    for (i = 0; i < g_sym_count; i++) {
+        unsigned k = sym_hash(g_sym_names[i]) & (unsigned)(nslots - 1);
+        while (ns[k]) k = (k + 1) & (unsigned)(nslots - 1);
+        ns[k] = i + 1;
+    }
+    free(g_sym_slots);
+    g_sym_slots = ns; g_sym_nslots = nslots;
+}
+
+/* slot holding 'name', or the empty slot where it would go */
+static unsigned sym_slot(const char* name) {
+    unsigned k = sym_hash(name) & (unsigned)(g_sym_nslots - 1);
+    while (g_sym_slots[k] && _stricmp(g_sym_names[g_sym_slots[k] - 1], name) != 0)
+        k = (k + 1) & (unsigned)(g_sym_nslots - 1);
+    return k;
+}
+
+int sym_find(const char* name) {
+    if (g_sym_nslots == 0 || !name) return -1;
+    return g_sym_slots[sym_slot(name)] - 1;
+}
+
+int sym_intern(const char* name) {
+    unsigned k;
+    if (!name) name = "";
+    if (g_sym_nslots == 0) sym_rehash(256);
+    k = sym_slot(name);
+    if (g_sym_slots[k]) return g_sym_slots[k] - 1;
+    if (g_sym_count >= g_sym_cap) {
+        int nc = g_sym_cap ? g_sym_cap * 2 : 128;
+        char** nn = (char**)realloc(g_sym_names, (size_t)nc * sizeof(char*));
+        if (!nn) { fprintf(stderr, "ERROR: out of memory in symbol table\n"); exit(1); }
+        g_sym_names = nn; g_sym_cap = nc;
+    }
+    {
+        size_t n = strlen(name), i;
+        char* u = (char*)malloc(n + 1);
+        if (!u) { fprintf(stderr, "ERROR: out of memory in symbol table\n"); exit(1); }
+        for (i = 0; i < n; i++) u[i] = (char)toupper((unsigned char)name[i]);
+        u[n] = 0;
+        g_sym_names[g_sym_count] = u;
+        g_sym_slots[k] = ++g_sym_count;
+    }
+    if (g_sym_count * 2 > g_sym_nslots) sym_rehash(g_sym_nslots * 2);
+    return g_sym_count - 1;
+}
+
+const char* sym_name(int id) { return (id >= 0 && id < g_sym_count) ? g_sym_names[id] : ""; }
+int sym_count(void) { return g_sym_count; }
+
+/* ---- growable buffers used while crunching one line ---- */
+typedef struct { char* p; int len, cap; } CrPool;
+typedef struct { void* p; int n, cap; } CrVec;
+
+static int pool_grow(CrPool* b, size_t n) {
+    if (b->len + (int)n + 1 > b->cap) {
+        int nc = b->cap ? b->cap : 256;
+        while (b->len + (int)n + 1 > nc) nc *= 2;
+        char* np = (char*)realloc(b->p, (size_t)nc);
+        if (!np) return -1;
+        b->p = np; b->cap = nc;
+    }
+    return 0;
+}
+
+static int pool_add(CrPool* b, const char* s, size_t n) {
+    int at = b->len;
+    if (pool_grow(b, n) < 0) return -1;
+    memcpy(b->p + b->len, s, n); b->p[b->len + n] = 0;
+    b->len += (int)n + 1;
+    return at;
+}
+
+/* copy n bytes already in the pool (a span of segment text) to a new NUL-terminated entry */
+static int pool_dup(CrPool* b, int from, size_t n) {
+    int at = b->len;
+    if (pool_grow(b, n) < 0) return -1;
+    memcpy(b->p + at, b->p + from, n); b->p[at + n] = 0;
+    b->len += (int)n + 1;
+    return at;
+}
+
+static void* vec_push(CrVec* v, size_t elsz) {
+    if (v->n >= v->cap) {
+        int nc = v->cap ? v->cap * 2 : 16;
+        void* np = realloc(v->p, (size_t)nc * elsz);
+        if (!np) return NULL;
+        v->p = np; v->cap = nc;
+    }
+    return (char*)v->p + (size_t)(v->n++) * elsz;
+}
+
+/* where IF resumes: a false one at the first ELSE after THEN, or the end of the
+   statement; a true one, after its THEN part, at the end of the statement past ELSE
+   (the token scans st_if did on every condition) */
+static void then_skips(CrunchTok* t, int n) {
+    int i, j;
+    for (i = 0; i < n; i++) {
+        if (t[i].type != T_THEN && t[i].type != T_ELSE) continue;
+        for (j = i + 1; (t[i].type == T_ELSE || t[j].type != T_ELSE) && t[j].type != T_END; j++) {}
+        t[i].skip = j - i;
+    }
+}
+
+/* lex one statement's text and append its tokens (terminated by T_END) */
+static int crunch_segment(int src, CrPool* pool, CrVec* toks) {
+    Lexer lx;
+    CrunchTok* t;
+    int first = toks->n;
+    lx_init(&lx, pool->p + src);
+    for (;;) {
+        lx_next(&lx);
+        t = (CrunchTok*)vec_push(toks, sizeof(CrunchTok));
+        if (!t) return 0;
+        t->type = lx.cur.type;
+        t->end = (int)lx.i;
+        t->text = -1;
+        t->sym = -1;
+        t->number = (lx.cur.type == T_NUMBER) ? lx.cur.number : 0.0;
+        t->len = 0;
+        t->skip = 0;
+        t->ic = 0;
+        t->ic_kind = 0;
+        t->ic_epoch = 0;
+        if (lx.cur.type == T_STRING || lx.cur.type == T_IDENT) {
+            /* the token is a span of the segment text; this is where it gets its own copy */
+            int at = pool_dup(pool, src + (int)(lx.cur.text - lx.s), (size_t)lx.cur.len);
+            if (at < 0) return 0;
+            t = (CrunchTok*)toks->p + (toks->n - 1);
+            t->text = at;
+            t->len = lx.cur.len;
+            if (lx.cur.type == T_IDENT) t->sym = sym_intern(pool->p + at);
+        }
+        /* lx.s points into the pool, which may have moved */
+        lx.s = pool->p + src;
+        if (lx.cur.type == T_END) { then_skips((CrunchTok*)toks->p + first, toks->n - first); return 1; }
+    }
+}
+
+/* A line starting with REM is a comment as a whole; REM and DATA statements elsewhere
+   do nothing when run, so only the statements up to the last other one are executed. */
+static void classify_line(CrunchLine* cl) {
+    int k;
+    TokType first = cl->nseg ? cl->toks[cl->segs[0].first].type : T_REM;
+    cl->kind = first == T_REM ? LK_REM : first == T_DATA ? LK_DATA : LK_CODE;
+    cl->nrun = 0;
+    if (cl->kind == LK_REM) return;
+    for (k = 0; k < cl->nseg; k++) {
+        TokType t = cl->toks[cl->segs[k].first].type;
+        if (t != T_REM && t != T_DATA) cl->nrun = k + 1;
+    }
+}
+
+CrunchLine* crunch_line(const char* text) {
+    CrPool pool = { NULL, 0, 0 };
+    CrVec segs = { NULL, 0, 0 }, toks = { NULL, 0, 0 };
+    const char* line = text ? text : "";
+    const char* p = line;
+    int base;
+    CrunchLine* cl = (CrunchLine*)calloc(1, sizeof(CrunchLine));
+    if (!cl) return NULL;
+
+    /* the line is copied once; its statements are spans of that copy (the lexer ends a
+       statement at the ':' or '\' that follows it) */
+    base = pool_add(&pool, line, strlen(line));
+    if (base < 0) goto oom;
+    while (*p) {
+        const char* stmt_start;
+        int in_str = 0;
+        size_t len;
+        while (*p && isspace((unsigned char)*p)) p++;
+        stmt_start = p;
+        while (*p) {
+            if (*p == '"' && (p == stmt_start || *(p - 1) != '\\'))
+                in_str = !in_str;
+            if (!in_str && (*p == ':' || *p == '\\'))
+                break;
+            p++;
+        }
+        len = (size_t)(p - stmt_start);
+        if (len > 0) {
+            CrunchSeg* sg = (CrunchSeg*)vec_push(&segs, sizeof(CrunchSeg));
+            int src = base + (int)(stmt_start - line);
+            if (!sg) goto oom;
+            sg->src = src;
+            sg->len = (int)len;
+            sg->first = toks.n;
+            sg->compiled = 0;
+            sg->stmt = NULL;
+            if (!crunch_segment(src, &pool, &toks)) goto oom;
+        }
+        if (*p == ':' || *p == '\\') { p++; continue; }
+        break;
+    }
+
+    cl->nseg = segs.n; cl->segs = (CrunchSeg*)segs.p;
+    cl->ntok = toks.n; cl->toks = (CrunchTok*)toks.p;
+    cl->pool = pool.p;
+    classify_line(cl);
+    return cl;
+
+oom:
+    free(pool.p); free(segs.p); free(toks.p); free(cl);
+    printf("ERROR: OUT OF MEMORY\n");
+    return NULL;
+}
+
+void crunch_free(CrunchLine* cl) {
+    int k;
+    if (!cl) return;
+    vm_free(cl->vm);
+    for (k = 0; k < cl->nseg; k++) stmt_free(cl->segs[k].stmt);
+    free(cl->segs);
+    free(cl->toks);
+    free(cl->pool);
+    free(cl);
+}
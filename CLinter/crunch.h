@@ -0,0 +1,22 @@
+#ifndef CRUNCH_H
+#define CRUNCH_H
+#include "runtime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Build the pre-lexed token stream for one program line (NULL on OOM). */
+CrunchLine* crunch_line(const char* text);
+void        crunch_free(CrunchLine* cl);
+
+/* Identifier interning: case-insensitive, ids are stable for the process lifetime. */
+int         sym_intern(const char* name);
+int         sym_find(const char* name);   /* -1 if the name was never interned */
+const char* sym_name(int id);
+int         sym_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,745 @@
+/* emitc.cpp - --emit-c: translate the loaded program into a C source file
+   - Every program line becomes a label; GOTO/GOSUB with a known target are direct
+     gotos. Jumps whose target is only known at run time (NEXT, RETURN, interpreted
+     statements) go through one switch over all line numbers.
+   - Numeric variables used only by compiled statements become C doubles. Variables that
+     interpreted statements or READ also touch are pointers into the interpreter's
+     variable table, so both sides see the same value. Integer variables (A%, DEFINT)
+     always are: v_X points at their BasInt and stores go through rt_ilet.
+   - Statements the compiler (compile.cpp) leaves to the interpreter, and IF branches
+     it could not take, run through rt_seg / rt_branch on the embedded program text.
+   - Expressions are emitted as C expressions. Calls with side effects (RND, array
+     reads, POS, EOF) are hoisted into temporaries, so they run left to right as they
+     would in node_eval. Integer-valued ones (Node.isint) are RtInt values built by
+     rt_iadd & co., exact until a result has to widen.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "runtime.h"
+#include "compile.h"
+#include "emitc.h"
+
+typedef struct { char* s; size_t n, cap; } Sb;
+
+static void sb_add(Sb* b, const char* fmt, ...) {
+    va_list ap;
+    int k;
+    for (;;) {
+        size_t room = b->cap - b->n;
+        va_start(ap, fmt);
+        k = vsnprintf(b->s ? b->s + b->n : NULL, b->s ? room : 0, fmt, ap);
+        va_end(ap);
+        if (k < 0) return;
+        if (b->s && (size_t)k < room) { b->n += (size_t)k; return; }
+        {
+            size_t nc = (b->cap ? b->cap * 2 : 128) + (size_t)k + 1;
+            char* ns = (char*)realloc(b->s, nc);
+            if (!ns) { fprintf(stderr, "ERROR: out of memory in --emit-c\n"); exit(1); }
+            b->s = ns; b->cap = nc;
+        }
+    }
+}
+
+typedef struct {
+    char name[32];       /* as written first */
+    char cname[48];
+    int shared;          /* lives in the variable table: v_X is a double* */
+    int isint;           /* integer variable: v_X is a long long* (always shared) */
+} EName;
+
+typedef struct {
+    FILE* out;
+    EName* vars; int nvar;
+    EName* arrs; int narr;
+    int all_shared;      /* program has statements that list/reset all variables */
+    int trace;           /* program uses TRACE */
+    const Node** tnode;  /* hoisted nodes and their temporaries */
+    int* tid;
+    int ntmp, captmp, seq;
+    int line, seg;
+    const char* next;    /* label of the next line */
+    int ind;
+} Ec;
+
+/* ---------- names ---------- */
+static EName* name_find(EName* v, int n, const char* name) {
+    int i;
+    for (i = 0; i < n; i++) if (!_stricmp(v[i].name, name)) return &v[i];
+    return NULL;
+}
+
+static void name_add(EName** v, int* n, const char* name, char prefix) {
+    EName* e;
+    int i, clean = 1;
+    if (name_find(*v, *n, name)) return;
+    e = (EName*)realloc(*v, (size_t)(*n + 1) * sizeof(EName));
+    if (!e) { fprintf(stderr, "ERROR: out of memory in --emit-c\n"); exit(1); }
+    *v = e; e = &e[*n];
+    memset(e, 0, sizeof(*e));
+    strncpy(e->name, name, sizeof(e->name) - 1);
+    e->cname[0] = prefix; e->cname[1] = '_';
+    for (i = 0; name[i] && i < 31; i++) {
+        unsigned char c = (unsigned char)name[i];
+        if (!isalnum(c)) clean = 0;
+        e->cname[2 + i] = isalnum(c) ? (char)toupper(c) : '_';
+    }
+    if (!clean) snprintf(e->cname + strlen(e->cname), 8, "_%d", *n);
+    if (prefix == 'v' && is_int_var_name(name)) e->isint = e->shared = 1;
+    (*n)++;
+}
+
+static void collect_node(Ec* e, const Node* n) {
+    int i;
+    if (!n) return;
+    if (n->kind == N_VAR && !is_string_var_name(n->name)) name_add(&e->vars, &e->nvar, n->name, 'v');
+    if (n->kind == N_ARR) name_add(&e->arrs, &e->narr, n->name, 'a');
+    collect_node(e, n->a);
+    collect_node(e, n->b);
+    for (i = 0; i < n->nsubs; i++) collect_node(e, n->subs[i]);
+}
+
+static void collect_stmt(Ec* e, const Stmt* s) {
+    int i, j;
+    if (!s) return;
+    switch (s->kind) {
+    case S_LET: case S_FOR: name_add(&e->vars, &e->nvar, s->name, 'v'); break;
+    case S_LETARR: name_add(&e->arrs, &e->narr, s->name, 'a'); break;
+    default: break;
+    }
+    collect_node(e, s->expr);
+    collect_node(e, s->to);
+    collect_node(e, s->step);
+    for (i = 0; i < s->nsubs; i++) collect_node(e, s->subs[i]);
+    for (i = 0; i < s->npops; i++) {
+        const PrintOp* op = &s->pops[i];
+        collect_node(e, op->expr);
+        for (j = 0; j < op->nparts; j++) {
+            const PrintPart* pp = &op->parts[j];
+            int k;
+            collect_node(e, pp->a);
+            collect_node(e, pp->b);
+            for (k = 0; k < pp->nsubs; k++) collect_node(e, pp->subs[k]);
+        }
+    }
+    for (i = 0; i < s->ntg; i++)
+        for (j = 0; j < s->tg[i].nsubs; j++) collect_node(e, s->tg[i].subs[j]);
+    collect_stmt(e, s->then_s);
+    collect_stmt(e, s->else_s);
+}
+
+static void share(Ec* e, const char* name) {
+    EName* v = name_find(e->vars, e->nvar, name);
+    if (v) v->shared = 1;
+}
+
+/* tokens from k to the end of the segment run on the interpreter */
+static void scan_interp(Ec* e, const CrunchLine* cl, int k) {
+    for (; cl->toks[k].type != T_END; k++) {
+        switch (cl->toks[k].type) {
+        case T_IDENT: share(e, cl->pool + cl->toks[k].text); break;
+        case T_NEW: case T_RUN: case T_LOAD: case T_LOADVARS: case T_SAVEVARS:
+        case T_DUMP: case T_VARS: e->all_shared = 1; break;
+        default: break;
+        }
+    }
+}
+
+static void scan_stmt(Ec* e, const CrunchLine* cl, const Stmt* s) {
+    int i;
+    if (!s) return;
+    if (s->kind == S_INTERP) scan_interp(e, cl, s->tok);
+    if (s->kind == S_READ)
+        for (i = 0; i < s->ntg; i++) if (s->tg[i].nsubs < 0) share(e, s->tg[i].name);
+    scan_stmt(e, cl, s->then_s);
+    scan_stmt(e, cl, s->else_s);
+}
+
+/* ---------- output helpers ---------- */
+static void ln(Ec* e, const char* fmt, ...) {
+    va_list ap;
+    int i;
+    for (i = 0; i < e->ind; i++) fputs("    ", e->out);
+    va_start(ap, fmt);
+    vfprintf(e->out, fmt, ap);
+    va_end(ap);
+    fputc('\n', e->out);
+}
+
+static void c_str(Sb* b, const char* s) {
+    sb_add(b, "\"");
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\' || c == '?') sb_add(b, "\\%c", c);
+        else if (c < 32 || c >= 127) sb_add(b, "\\%03o", c);
+        else sb_add(b, "%c", c);
+    }
+    sb_add(b, "\"");
+}
+
+/* a C string literal for s (valid until the next call) */
+static const char* lit(const char* s) {
+    static Sb b;
+    b.n = 0;
+    if (!s) return "0";
+    c_str(&b, s);
+    return b.s;
+}
+
+static void num_lit(Sb* b, double d) {
+    char t[40];
+    if (isinf(d)) { sb_add(b, d > 0 ? "HUGE_VAL" : "(-HUGE_VAL)"); return; }
+    snprintf(t, sizeof(t), "%.17g", d);
+    if (!strpbrk(t, ".eEn")) strcat(t, ".0");
+    sb_add(b, d < 0 ? "(%s)" : "%s", t);
+}
+
+static const char* var_ref(Ec* e, const char* name) {
+    static char buf[64];
+    EName* v = name_find(e->vars, e->nvar, name);
+    if (!v) return "0.0";
+    if (v->isint) snprintf(buf, sizeof(buf), "((double)*%s)", v->cname);
+    else if (v->shared) snprintf(buf, sizeof(buf), "(*%s)", v->cname);
+    else snprintf(buf, sizeof(buf), "%s", v->cname);
+    return buf;
+}
+
+static const char* arr_ref(Ec* e, const char* name) {
+    EName* a = name_find(e->arrs, e->narr, name);
+    return a ? a->cname : "a_";
+}
+
+/* ---------- expressions ---------- */
+static int impure(const Node* n) {
+    const char* f;
+    if (n->kind == N_ARR || n->kind == N_RND || n->kind == N_FN0 || n->kind == N_STR || n->kind == N_SCMP) return 1;
+    f = n->kind == N_FN1 ? node_fn_name(n) : NULL;
+    return f && !strcmp(f, "EOF");
+}
+
+static int tmp_of(Ec* e, const Node* n) {
+    int i;
+    for (i = 0; i < e->ntmp; i++) if (e->tnode[i] == n) return e->tid[i];
+    return -1;
+}
+
+static void ex_str(Ec* e, const Node* n, Sb* b);
+
+static void ex_subs(Ec* e, Node* const* subs, int n, Sb* b) {
+    int i;
+    for (i = 0; i < n; i++) { if (i) sb_add(b, ", "); ex_str(e, subs[i], b); }
+}
+
+/* rt_sref(...) for the string operand of an N_SCMP node, into b (subscripts go to an array first) */
+static void ex_sref(Ec* e, const Node* n, Sb* b) {
+    int src = n->str ? 0 : n->sarray ? 2 : 1;
+    if (n->nsubs > 0) {
+        Sb s = { 0, 0, 0 };
+        int id = ++e->seq;
+        ex_subs(e, n->subs, n->nsubs, &s);
+        ln(e, "const double s%d[] = { %s };", id, s.s);
+        free(s.s);
+        sb_add(b, "rt_sref(%s, %d, %d, s%d)", lit(src ? n->name : n->str), src, n->nsubs, id);
+    }
+    else sb_add(b, "rt_sref(%s, %d, 0, 0)", lit(src ? n->name : n->str), src);
+}
+
+static void ex_hoist(Ec* e, const Node* n) {
+    int i, id;
+    Sb b = { 0, 0, 0 };
+    if (!n) return;
+    if (n->kind == N_SCMP) {
+        /* the operands are strings, not values: hoist only their subscripts */
+        for (i = 0; i < n->a->nsubs; i++) ex_hoist(e, n->a->subs[i]);
+        for (i = 0; i < n->b->nsubs; i++) ex_hoist(e, n->b->subs[i]);
+    }
+    else {
+        ex_hoist(e, n->a);
+        ex_hoist(e, n->b);
+        for (i = 0; i < n->nsubs; i++) ex_hoist(e, n->subs[i]);
+    }
+    if (!impure(n)) return;
+
+    id = ++e->seq;
+    switch (n->kind) {
+    case N_ARR: {
+        const char* get = n->isint ? "RtInt t%d = rt_iaget" : "double t%d = rt_aget";
+        Sb g = { 0, 0, 0 };
+        sb_add(&g, get, id);
+        if (n->nsubs > 0) {
+            ex_subs(e, n->subs, n->nsubs, &b);
+            ln(e, "const double s%d[] = { %s };", id, b.s);
+            ln(e, "%s(&%s, %s, %d, s%d);", g.s, arr_ref(e, n->name), lit(n->name), n->nsubs, id);
+        }
+        else ln(e, "%s(&%s, %s, 0, 0);", g.s, arr_ref(e, n->name), lit(n->name));
+        free(g.s);
+    } break;
+    case N_RND: ln(e, "double t%d = rt_rnd();", id); break;
+    case N_FN0: ln(e, "double t%d = rt_pos();", id); break;
+    case N_STR: {
+        int src = n->str ? 0 : n->sarray ? 2 : 1;
+        if (n->nsubs > 0) {
+            ex_subs(e, n->subs, n->nsubs, &b);
+            ln(e, "const double s%d[] = { %s };", id, b.s);
+            b.n = 0;
+            sb_add(&b, "s%d, ", id);
+        }
+        else sb_add(&b, "0, ");
+        if (n->a) ex_str(e, n->a, &b); else sb_add(&b, "0.0");
+        sb_add(&b, ", ");
+        if (n->b) ex_str(e, n->b, &b); else sb_add(&b, "0.0");
+        ln(e, "double t%d = rt_strfn(%d, %s, %d, %d, %s);", id, n->sfn, lit(src ? n->name : n->str), src, n->nsubs, b.s);
+    } break;
+    case N_SCMP:
+        sb_add(&b, "rt_scmp(%d, ", n->sfn); ex_sref(e, n->a, &b);
+        sb_add(&b, ", "); ex_sref(e, n->b, &b); sb_add(&b, ")");
+        ln(e, "double t%d = %s;", id, b.s);
+        break;
+    default:
+        ex_str(e, n->a, &b);
+        ln(e, "double t%d = rt_eof(%s);", id, b.s);
+        break;
+    }
+    free(b.s);
+
+    if (e->ntmp >= e->captmp) {
+        e->captmp = e->captmp ? e->captmp * 2 : 16;
+        e->tnode = (const Node**)realloc((void*)e->tnode, (size_t)e->captmp * sizeof(Node*));
+        e->tid = (int*)realloc(e->tid, (size_t)e->captmp * sizeof(int));
+        if (!e->tnode || !e->tid) { fprintf(stderr, "ERROR: out of memory in --emit-c\n"); exit(1); }
+    }
+    e->tnode[e->ntmp] = n;
+    e->tid[e->ntmp] = id;
+    e->ntmp++;
+}
+
+/* an integer-valued tree (Node.isint) as an RtInt; a MOD / IDIV / NOT operand that is
+   not one is truncated */
+static void ex_int(Ec* e, const Node* n, Sb* b) {
+    EName* v;
+    int t = tmp_of(e, n);
+    if (t >= 0) { sb_add(b, "t%d", t); return; }
+    if (!n->isint) { sb_add(b, "rt_itrunc("); ex_str(e, n, b); sb_add(b, ")"); return; }
+    switch (n->kind) {
+    case N_NUM: sb_add(b, "rt_ival(%lldLL)", (long long)n->num); break;
+    case N_VAR:
+        v = name_find(e->vars, e->nvar, n->name);
+        if (v && v->isint) sb_add(b, "rt_ival(*%s)", v->cname);
+        else sb_add(b, "rt_ival(0)");
+        break;
+    case N_NEG: sb_add(b, "rt_ineg("); ex_int(e, n->a, b); sb_add(b, ")"); break;
+    case N_NOT: sb_add(b, "rt_inot("); ex_int(e, n->a, b); sb_add(b, ")"); break;
+    default:
+        sb_add(b, n->kind == N_ADD ? "rt_iadd(" : n->kind == N_SUB ? "rt_isub(" : n->kind == N_MUL ? "rt_imul("
+                  : n->kind == N_MOD ? "rt_imod(" : "rt_iidiv(");
+        ex_int(e, n->a, b); sb_add(b, ", "); ex_int(e, n->b, b); sb_add(b, ")");
+        break;
+    }
+}
+
+static void ex_str(Ec* e, const Node* n, Sb* b) {
+    static const struct { NodeKind k; const char* op; } bin[] = {
+        { N_MUL, "*" }, { N_DIV, "/" }, { N_ADD, "+" }, { N_SUB, "-" }
+    };
+    static const struct { NodeKind k; const char* op; } cmp[] = {
+        { N_EQ, "==" }, { N_NE, "!=" }, { N_LT, "<" }, { N_GT, ">" }, { N_LE, "<=" }, { N_GE, ">=" }
+    };
+    int t = tmp_of(e, n), i;
+    if (t >= 0) { sb_add(b, n->isint ? "t%d.d" : "t%d", t); return; }
+    if (n->isint && n->kind != N_NUM && n->kind != N_VAR) { ex_int(e, n, b); sb_add(b, ".d"); return; }
+
+    for (i = 0; i < 4; i++) {
+        if (bin[i].k != n->kind) continue;
+        sb_add(b, "("); ex_str(e, n->a, b); sb_add(b, " %s ", bin[i].op); ex_str(e, n->b, b); sb_add(b, ")");
+        return;
+    }
+    for (i = 0; i < 6; i++) {
+        if (cmp[i].k != n->kind) continue;
+        sb_add(b, "(("); ex_str(e, n->a, b); sb_add(b, " %s ", cmp[i].op); ex_str(e, n->b, b); sb_add(b, ") ? 1.0 : 0.0)");
+        return;
+    }
+    switch (n->kind) {
+    case N_NUM: num_lit(b, n->num); break;
+    case N_VAR:
+        if (is_string_var_name(n->name)) sb_add(b, "rt_sval(%s)", lit(n->name));
+        else sb_add(b, "%s", var_ref(e, n->name));
+        break;
+    case N_NEG: sb_add(b, "(-"); ex_str(e, n->a, b); sb_add(b, ")"); break;
+    case N_POW: case N_FN2:
+        sb_add(b, "pow("); ex_str(e, n->a, b); sb_add(b, ", "); ex_str(e, n->b, b); sb_add(b, ")");
+        break;
+    case N_AND: case N_OR: case N_XOR: {
+        const char* op = n->kind == N_AND ? "&&" : n->kind == N_OR ? "||" : "!=";
+        sb_add(b, "((("); ex_str(e, n->a, b); sb_add(b, " != 0.0) %s (", op);
+        ex_str(e, n->b, b); sb_add(b, " != 0.0)) ? 1.0 : 0.0)");
+    } break;
+    case N_FN1: {
+        static const struct { const char* basic; const char* c; } fns[] = {
+            { "INT", "floor" }, { "SGN", "rt_sgn" }, { "LOG10", "log10" }, { "TAB", "" },
+            { "ATN", "atan" }, { "COS", "cos" }, { "SIN", "sin" }, { "TAN", "tan" },
+            { "EXP", "exp" }, { "LOG", "log" }, { "SQR", "sqrt" }, { "ABS", "fabs" },
+            { "STR$", "rt_str_num" }, { "CHR$", "rt_chr_num" }
+        };
+        const char* f = node_fn_name(n);
+        const char* c = "";
+        if (n->fn1 == fn_str_num && n->a->isint) { sb_add(b, "rt_istr("); ex_int(e, n->a, b); sb_add(b, ")"); break; }
+        for (i = 0; f && i < (int)(sizeof(fns) / sizeof(fns[0])); i++) if (!strcmp(fns[i].basic, f)) c = fns[i].c;
+        sb_add(b, "%s(", c); ex_str(e, n->a, b); sb_add(b, ")");
+    } break;
+    default: sb_add(b, "0.0"); break;
+    }
+}
+
+/* hoist side effects, then return the C expression for n (caller frees) */
+static char* ex(Ec* e, const Node* n) {
+    Sb b = { 0, 0, 0 };
+    ex_hoist(e, n);
+    ex_str(e, n, &b);
+    return b.s;
+}
+
+/* the same for an integer-valued n, as an RtInt */
+static char* exi(Ec* e, const Node* n) {
+    Sb b = { 0, 0, 0 };
+    ex_hoist(e, n);
+    ex_int(e, n, &b);
+    return b.s;
+}
+
+/* subscripts into a const array s<id>; returns id */
+static int ex_subs_arr(Ec* e, Node* const* subs, int n) {
+    Sb b = { 0, 0, 0 };
+    int i, id;
+    for (i = 0; i < n; i++) ex_hoist(e, subs[i]);
+    ex_subs(e, subs, n, &b);
+    id = ++e->seq;
+    ln(e, "const double s%d[] = { %s };", id, b.s);
+    free(b.s);
+    return id;
+}
+
+/* ---------- statements ---------- */
+
+static int line_exists(int line) { return find_prog_index_by_line(line) >= 0; }
+
+static void em_jump(Ec* e, int line) {
+    if (line_exists(line)) ln(e, "goto L%d;", line);
+    else ln(e, "jump = %d; goto dispatch;", line);
+}
+
+static void em_handoff(Ec* e, const char* call) {
+    ln(e, "r = %s;", call);
+    ln(e, "if (rt_epoch() != bound_epoch) bind_vars();");
+    ln(e, "STEP(r, %s);", e->next);
+}
+
+static void em_stmt(Ec* e, const Stmt* s);
+
+static void em_branch(Ec* e, const Stmt* b) {
+    char call[96];
+    if (b->kind != S_INTERP) { em_stmt(e, b); return; }
+    snprintf(call, sizeof(call), "rt_branch(%d, %d, %d, &jump)", e->line, e->seg, b->tok);
+    em_handoff(e, call);
+}
+
+static void em_print(Ec* e, const Stmt* s) {
+    int i, j;
+    ln(e, "if (rt_print_begin(%d) < 0) goto done;", s->handle);
+    for (i = 0; i < s->npops; i++) {
+        const PrintOp* op = &s->pops[i];
+        char* x;
+        switch (op->kind) {
+        case PO_ITEM:
+            ln(e, "rt_item_begin();");
+            for (j = 0; j < op->nparts; j++) {
+                const PrintPart* pp = &op->parts[j];
+                switch (pp->kind) {
+                case PP_NUM: case PP_STRS: case PP_CHR:
+                    if (pp->kind != PP_CHR && pp->a->isint) {
+                        x = exi(e, pp->a);
+                        ln(e, "rt_part_int(%s);", x);
+                        free(x);
+                        break;
+                    }
+                    x = ex(e, pp->a);
+                    ln(e, "%s(%s);", pp->kind == PP_CHR ? "rt_part_chr" : "rt_part_num", x);
+                    free(x);
+                    break;
+                case PP_STR: ln(e, "rt_part_str(%s);", lit(pp->text)); break;
+                case PP_SVAR: ln(e, "rt_part_svar(%s);", lit(pp->text)); break;
+                case PP_SARR: {
+                    int id = ex_subs_arr(e, pp->subs, pp->nsubs);
+                    ln(e, "rt_part_sarr(%s, %d, s%d);", lit(pp->text), pp->nsubs, id);
+                } break;
+                case PP_TRM: ln(e, "rt_part_trm(%s, %d);", lit(pp->text), pp->text_is_var); break;
+                case PP_SEG: {
+                    char* a = pp->a ? ex(e, pp->a) : NULL;
+                    int ida = ++e->seq, idb;
+                    ln(e, "double p%d = %s;", ida, a ? a : "0.0");
+                    free(a);
+                    a = pp->b ? ex(e, pp->b) : NULL;
+                    idb = ++e->seq;
+                    ln(e, "double p%d = %s;", idb, a ? a : "0.0");
+                    free(a);
+                    ln(e, "rt_part_seg(%s, %d, %d, p%d, %d, p%d);", lit(pp->text), pp->text_is_var,
+                       pp->a != NULL, ida, pp->b != NULL, idb);
+                } break;
+                }
+            }
+            ln(e, "rt_item_end();");
+            break;
+        case PO_TAB: x = ex(e, op->expr); ln(e, "rt_print_tab(%s);", x); free(x); break;
+        case PO_ZONE: ln(e, "rt_print_zone();"); break;
+        case PO_SEMI: ln(e, "rt_print_semi();"); break;
+        }
+    }
+    ln(e, "rt_print_end();");
+}
+
+static void em_if(Ec* e, const Stmt* s) {
+    char* c = ex(e, s->expr);
+    ln(e, "if (%s != 0.0) {", c);
+    free(c);
+    e->ind++;
+    em_branch(e, s->then_s);
+    e->ind--;
+    if (s->else_s) {
+        ln(e, "}");
+        ln(e, "else {");
+        e->ind++;
+        em_branch(e, s->else_s);
+        e->ind--;
+    }
+    ln(e, "}");
+}
+
+static void em_stmt(Ec* e, const Stmt* s) {
+    char* x;
+    int i, k;
+    char call[160];
+
+    if (!s) {
+        snprintf(call, sizeof(call), "rt_seg(%d, %d, &jump)", e->line, e->seg);
+        em_handoff(e, call);
+        return;
+    }
+    ln(e, "{");
+    e->ind++;
+    switch (s->kind) {
+    case S_LET: {
+        EName* v = name_find(e->vars, e->nvar, s->name);
+        int iset = v->isint && s->expr->isint;
+        x = iset ? exi(e, s->expr) : ex(e, s->expr);
+        if (v->isint) ln(e, "if (%s(%s, %s) < 0) goto done;", iset ? "rt_iset" : "rt_ilet", v->cname, x);
+        else ln(e, "%s = %s;", var_ref(e, s->name), x);
+        free(x);
+    } break;
+    case S_LETARR: {
+        int id = ex_subs_arr(e, s->subs, s->nsubs);
+        x = s->expr->isint ? exi(e, s->expr) : ex(e, s->expr);
+        ln(e, "if (%s(&%s, %s, %d, s%d, %s) < 0) goto done;", s->expr->isint ? "rt_iaset" : "rt_aset",
+           arr_ref(e, s->name), lit(s->name), s->nsubs, id, x);
+        free(x);
+    } break;
+    case S_FOR: {
+        EName* v = name_find(e->vars, e->nvar, s->name);
+        int id = ++e->seq;
+        x = ex(e, s->expr); ln(e, "double f%d_0 = %s;", id, x); free(x);
+        x = ex(e, s->to); ln(e, "double f%d_1 = %s;", id, x); free(x);
+        if (s->step) { x = ex(e, s->step); ln(e, "double f%d_2 = %s;", id, x); free(x); }
+        else ln(e, "double f%d_2 = 1.0;", id);
+        snprintf(call, sizeof(call), "%s(%s, %s%s, f%d_0, f%d_1, f%d_2, %d, %d)", v->isint ? "rt_ifor" : "rt_for",
+                 lit(s->name), v->shared ? "" : "&", v->cname, id, id, id, e->line, e->seg);
+        ln(e, "STEP(%s, %s);", call, e->next);
+    } break;
+    case S_NEXT:
+        snprintf(call, sizeof(call), "rt_next(%s, &jump)", s->name ? lit(s->name) : "0");
+        ln(e, "STEP(%s, %s);", call, e->next);
+        break;
+    case S_GOTO:
+        em_jump(e, s->line);
+        break;
+    case S_GOSUB:
+        ln(e, "if (rt_gosub(%d, %d) < 0) goto done;", e->line, e->seg);
+        em_jump(e, s->line);
+        break;
+    case S_RETURN:
+        ln(e, "if (rt_return(&jump) < 0) goto done;");
+        ln(e, "goto resume;");
+        break;
+    case S_END:
+        ln(e, "goto done;");
+        break;
+    case S_IF: em_if(e, s); break;
+    case S_ON:
+        x = ex(e, s->expr);
+        ln(e, "switch ((int)%s) {", x);
+        free(x);
+        for (i = 0; i < s->nlines; i++) {
+            ln(e, "case %d:", i + 1);
+            e->ind++;
+            if (s->mode) ln(e, "if (rt_gosub(%d, %d) < 0) goto done;", e->line, e->seg);
+            em_jump(e, s->lines[i]);
+            e->ind--;
+        }
+        ln(e, "default: break;");
+        ln(e, "}");
+        break;
+    case S_PRINT: em_print(e, s); break;
+    case S_DIM: case S_READ:
+        if (s->kind == S_READ) ln(e, "rt_read_begin();");
+        for (i = 0; i < s->ntg; i++) {
+            const Target* t = &s->tg[i];
+            const char* fn = s->kind == S_DIM ? "rt_dim" : "rt_read";
+            if (t->nsubs > 0) {
+                k = ex_subs_arr(e, t->subs, t->nsubs);
+                ln(e, "if (%s(%s, %d, s%d) < 0) goto done;", fn, lit(t->name), t->nsubs, k);
+            }
+            else ln(e, "if (%s(%s, %d, 0) < 0) goto done;", fn, lit(t->name), t->nsubs);
+        }
+        break;
+    case S_RESTORE: ln(e, "rt_restore(%d);", s->line); break;
+    case S_OPEN: ln(e, "if (rt_open(%s, %d, %d) < 0) goto done;", lit(s->name), s->mode, s->handle); break;
+    case S_CLOSE: ln(e, "rt_close(%d);", s->handle); break;
+    case S_REM: break;
+    case S_INTERP: em_branch(e, s); break;
+    }
+    e->ind--;
+    ln(e, "}");
+    e->ntmp = 0;
+}
+
+/* ---------- program ---------- */
+static int check_program(void) {
+    int i, k;
+    for (i = 0; i < g_prog_count; i++) {
+        const CrunchLine* cl = g_prog[i].code;
+        if (!cl) continue;
+        for (k = 0; k < cl->nseg; k++) {
+            TokType t = cl->toks[cl->segs[k].first].type;
+            if (!cl->segs[k].stmt && (t == T_FOR || t == T_NEXT)) {
+                printf("ERROR: --emit-c cannot translate the FOR/NEXT at line %d\n", g_prog[i].number);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int skip_line(const CrunchLine* cl) {
+    return !cl || cl->nrun == 0;
+}
+
+int emit_c_program(const char* srcName, const char* outPath) {
+    Ec e;
+    int i, k;
+    char next[32];
+
+    sort_program();
+    prog_defint();   /* integer names are known before statements compile */
+    prog_compile();
+    if (check_program() < 0) return -1;
+
+    memset(&e, 0, sizeof(e));
+    for (i = 0; i < g_prog_count; i++) {
+        const CrunchLine* cl = g_prog[i].code;
+        if (!cl) continue;
+        for (k = 0; k < cl->nseg; k++) collect_stmt(&e, cl->segs[k].stmt);
+    }
+    for (i = 0; i < g_prog_count; i++) {
+        const CrunchLine* cl = g_prog[i].code;
+        if (!cl) continue;
+        for (k = 0; k < cl->ntok; k++) if (cl->toks[k].type == T_TRACE) e.trace = 1;
+        for (k = 0; k < cl->nseg; k++) {
+            if (!cl->segs[k].stmt) scan_interp(&e, cl, cl->segs[k].first);
+            else scan_stmt(&e, cl, cl->segs[k].stmt);
+        }
+    }
+    if (e.all_shared) for (i = 0; i < e.nvar; i++) e.vars[i].shared = 1;
+
+    e.out = fopen(outPath, "w");
+    if (!e.out) { printf("ERROR: Could not write '%s'\n", outPath); return -1; }
+
+    fprintf(e.out,
+        "/* %s - generated by CLinter --emit-c from %s; do not edit.\n"
+        "   Link with the runtime: the CLinter sources built with CLINTER_RTLIB defined\n"
+        "   (wxecut.cpp and Parse.cpp compiled as C), e.g. from the CLinter directory:\n"
+        "     cc -O2 -I. -c %s\n"
+        "     cc -O2 -DCLINTER_RTLIB -x c -c wxecut.cpp Parse.cpp\n"
+        "     c++ -O2 -DCLINTER_RTLIB -c main.cpp printfunc.cpp data_table.cpp crunch.cpp \\\n"
+        "         compile.cpp vm.cpp jit.cpp profile.cpp help.cpp rtlib.cpp\n"
+        "     c++ -o prog *.o -lm\n"
+        "*/\n\n", outPath, srcName, outPath);
+    fprintf(e.out, "#include <stdio.h>\n#include <math.h>\n#include \"rtlib.h\"\n\n");
+
+    fprintf(e.out, "static const RtLine prog_src[] = {\n");
+    for (i = 0; i < g_prog_count; i++) fprintf(e.out, "    { %d, %s },\n", g_prog[i].number, lit(g_prog[i].text));
+    fprintf(e.out, "    { 0, 0 }\n};\n\n");
+
+    for (i = 0; i < e.nvar; i++)
+        fprintf(e.out, e.vars[i].isint ? "static long long* %s;   /* %s, integer, shared with the interpreter */\n"
+                     : e.vars[i].shared ? "static double* %s;   /* %s, shared with the interpreter */\n"
+                                        : "static double %s;   /* %s */\n", e.vars[i].cname, e.vars[i].name);
+    for (i = 0; i < e.narr; i++) fprintf(e.out, "static RtArr %s;   /* %s() */\n", e.arrs[i].cname, e.arrs[i].name);
+    fprintf(e.out, "static unsigned bound_epoch;\n\n");
+
+    fprintf(e.out, "static void bind_vars(void) {\n");
+    for (i = 0; i < e.nvar; i++)
+        if (e.vars[i].shared) fprintf(e.out, "    %s = %s(%s);\n", e.vars[i].cname, e.vars[i].isint ? "rt_int" : "rt_num", lit(e.vars[i].name));
+    fprintf(e.out, "    bound_epoch = rt_epoch();\n}\n\n");
+
+    fprintf(e.out,
+        "/* exec_statement return codes: 1 jump, 3 resume at a statement, 9 END, < 0 error,\n"
+        "   other non-zero ends the line */\n"
+        "#define STEP(rc, next) do { int r_ = (rc); if (r_ == 1) goto dispatch; if (r_ == 3) goto resume; if (r_ == 9 || r_ < 0) goto done; if (r_) goto next; } while (0)\n\n");
+
+    fprintf(e.out, "int main(void) {\n    int jump = 0, r = 0;\n    (void)r;\n");
+    fprintf(e.out, "    rt_init(prog_src, %d);\n    bind_vars();\n", g_prog_count);
+    if (g_prog_count == 0) fprintf(e.out, "    printf(\"NO PROGRAM\\n\");\n    goto done;\n");
+    else fprintf(e.out, "    goto L%d;\n", g_prog[0].number);
+
+    fprintf(e.out, "dispatch:\n    switch (jump) {\n");
+    for (i = 0; i < g_prog_count; i++) fprintf(e.out, "    case %d: goto L%d;\n", g_prog[i].number, g_prog[i].number);
+    fprintf(e.out, "    default: rt_undefined(jump); goto done;\n    }\n");
+
+    /* NEXT / RETURN: jump holds the statement PC (line index, statement) to resume at */
+    fprintf(e.out, "resume:\n    switch (jump) {\n");
+    for (i = 0; i < g_prog_count; i++) {
+        const CrunchLine* cl = g_prog[i].code;
+        fprintf(e.out, "    case %d: goto L%d;\n", PC_MAKE(i, 0), g_prog[i].number);
+        if (skip_line(cl)) continue;
+        for (k = 1; k < cl->nrun; k++) fprintf(e.out, "    case %d: goto L%d_%d;\n", PC_MAKE(i, k), g_prog[i].number, k);
+        /* past the last statement that runs (trailing REM/DATA): on to the next line */
+        for (; k < cl->nseg; k++)
+            if (i + 1 < g_prog_count) fprintf(e.out, "    case %d: goto L%d;\n", PC_MAKE(i, k), g_prog[i + 1].number);
+    }
+    fprintf(e.out, "    default: goto done;\n    }\n");
+
+    e.ind = 1;
+    for (i = 0; i < g_prog_count; i++) {
+        const CrunchLine* cl = g_prog[i].code;
+        if (i + 1 < g_prog_count) snprintf(next, sizeof(next), "L%d", g_prog[i + 1].number);
+        else snprintf(next, sizeof(next), "done");
+        fprintf(e.out, "L%d: ;\n", g_prog[i].number);
+        if (e.trace) ln(&e, "rt_trace(%d);", g_prog[i].number);
+        if (skip_line(cl)) continue;
+        e.line = g_prog[i].number;
+        e.next = next;
+        for (k = 0; k < cl->nrun; k++) {
+            e.seg = k;
+            if (k > 0) fprintf(e.out, "L%d_%d: ;\n", g_prog[i].number, k);
+            ln(&e, "/* %.*s */", cl->segs[k].len, cl->pool + cl->segs[k].src);
+            em_stmt(&e, cl->segs[k].stmt);
+        }
+    }
+    fprintf(e.out, "done:\n    return rt_exit();\n}\n");
+
+    free(e.vars); free(e.arrs); free((void*)e.tnode); free(e.tid);
+    if (fclose(e.out) != 0) { printf("ERROR: Could not write '%s'\n", outPath); return -1; }
+    return 0;
+}
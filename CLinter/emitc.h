@@ -0,0 +1,15 @@
+#ifndef EMITC_H
+#define EMITC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Translate the loaded program to a C file that links against rtlib (--emit-c).
+   srcName is only used in the generated header comment. 0 on success, -1 on error. */
+int emit_c_program(const char* srcName, const char* outPath);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
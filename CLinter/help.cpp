@@ -46,9 +46,9 @@ void print_help(void) {
         "  LEN(s$)           length of string",
         "  ASC(s$)           code of first character",
         "  VAL(s$)           numeric value of string",
-        "  CHR$(n)           character with ASCII code n  (console prints n>=32)",
+        "  CHR$(n)           character with code n (0..255)",
         "  STR$(x)           number x as string",
-        "  SEG$(s$,i[,n])    substring starting at i (1-based), length n",
+        "  SEG$(s$,i[,n])    substring starting at i (1-based), length n (to the end if n<=0)",
         "  TRM$(s$)          trim leading and trailing spaces",
         "",
         "Printing",
@@ -56,7 +56,7 @@ void print_help(void) {
         "  PRINT #n, ...                  output to file channel",
         "  TAB(n)                         print n spaces (within PRINT)",
         "  String concatenation:          \"A\" + \"B\" => \"AB\"; mixed with numbers allowed",
-        "  Control chars (<32) from CHR$  are ignored on console output",
+        "  String comparison:             A$ < B$ etc. compare bytes (anywhere, not just IF)",
         "",
         "Data",
         "  DATA ...           define constants",
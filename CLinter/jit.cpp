@@ -0,0 +1,547 @@
+/* jit.cpp - native x86-64 code for numeric lines (--engine=jit)
+   - A line's VM chunk is translated when every instruction is numeric: arithmetic and
+     compares, builtin calls, scalar/array assignment, FOR/NEXT, GOTO/GOSUB/RETURN/END
+     and IF jumps. Integer literals, variables and elements are read as doubles and an
+     integer variable or element can be set to a literal; the exact integer arithmetic,
+     and anything else (strings, PRINT, I/O, OP_STMT), keeps the line on the VM.
+   - The operand stack lives in a JitFrame addressed through rbx. The stack depth at each
+     instruction is known while translating, so every value has a fixed slot.
+   - Variable and array references are checked before each run; a missing one, a string
+     value or a variable whose type is not the one translated for (integer for A%, numeric
+     otherwise) sends that run to the VM, so the native code only ever sees bound slots.
+   - Code is written into its own pages, which are switched to read+execute before use.
+     No assembler or library is needed; both the SysV and Win64 calling conventions work.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "runtime.h"
+#include "wxecut.h"
+#include "vm.h"
+#include "jit.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define JIT_X64
+#endif
+
+/* what each VmRef of the chunk is bound to */
+enum { JR_NONE = 0, JR_VAR, JR_LETCLR, JR_ARR, JR_INT };   /* JR_LETCLR: LET that also drops the string value;
+                                                             JR_INT: a VT_INT variable */
+
+struct JitCode {
+    unsigned char* mem;
+    size_t size;
+    int (*fn)(void* frame);
+    char* kind;          /* JR_* per chunk reference */
+    int nref;
+};
+
+typedef struct {
+    double st[VM_STACK];
+    VmRef* refs;
+    int* outJump;
+} JitFrame;
+
+/* ---------- runtime helpers called from native code ---------- */
+static double jit_arr_get(Array* a, const double* top, int n) {
+    int subs[MAX_DIMS], i;
+    for (i = 0; i < n; i++) subs[i] = (int)top[i];
+    return array_get(a, subs, n);
+}
+
+/* top[0..n-1] subscripts, top[n] value */
+static void jit_arr_set(Array* a, const double* top, int n) {
+    int subs[MAX_DIMS], i;
+    for (i = 0; i < n; i++) subs[i] = (int)top[i];
+    array_set(a, subs, n, top[n]);
+}
+
+/* FOR/GOSUB frames resume after statement 'seg' of the running line (g_pc_index) */
+static int jit_for(const double* top, const char* name, int seg) {
+    g_pc_seg = seg;
+    return for_push(name, top[0], top[1], top[2], g_prog[g_pc_index].number);
+}
+
+static int jit_gosub(int target, int seg, int* outJump) {
+    g_pc_seg = seg;
+    if (gosub_push(g_prog[g_pc_index].number) < 0) return -1;
+    *outJump = target;
+    return 1;
+}
+
+/* same results as the VM handlers */
+static double jit_and(double a, double b) { return (a != 0.0 && b != 0.0) ? 1.0 : 0.0; }
+static double jit_or(double a, double b) { return (a != 0.0 || b != 0.0) ? 1.0 : 0.0; }
+static double jit_xor(double a, double b) { return ((a != 0.0) != (b != 0.0)) ? 1.0 : 0.0; }
+static double jit_pow(double a, double b) { return pow(a, b); }
+
+#ifdef JIT_X64
+/* ---------- x86-64 encoder ---------- */
+enum { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSI = 6, RDI = 7, R8 = 8, R9 = 9 };
+
+#if defined(_WIN32)
+static const int arg_reg[3] = { RCX, RDX, R8 };
+#else
+static const int arg_reg[3] = { RDI, RSI, RDX };
+#endif
+
+#define FR_ST(d)  ((int)(8 * (d)))
+#define FR_REFS   ((int)offsetof(JitFrame, refs))
+#define FR_JUMP   ((int)offsetof(JitFrame, outJump))
+#define REF_SLOT(i) ((int)((i) * sizeof(VmRef) + offsetof(VmRef, slot)))
+#define VAR_NUM   0   /* variable refs point at their g_var_num entry */
+
+/* the g_var_int entry of the same variable, relative to its g_var_num entry; 0 when the
+   arrays are too far apart for a disp32 */
+static int var_int_disp(int* disp) {
+    intptr_t d = (intptr_t)((char*)g_var_int - (char*)g_var_num);
+    if (d < INT32_MIN || d > INT32_MAX) return 0;
+    *disp = (int)d;
+    return 1;
+}
+
+typedef struct { int at; int target; } JitFix;   /* rel32 at 'at' -> bytecode pc (-1 = epilogue) */
+
+typedef struct {
+    unsigned char* b;
+    int n, cap;
+    JitFix* fix;
+    int nfix, capfix;
+} Jb;
+
+static void jb1(Jb* j, int x) {
+    if (j->n >= j->cap) {
+        int nc = j->cap ? j->cap * 2 : 256;
+        unsigned char* nb = (unsigned char*)realloc(j->b, (size_t)nc);
+        if (!nb) { fprintf(stderr, "ERROR: out of memory in JIT\n"); exit(1); }
+        j->b = nb; j->cap = nc;
+    }
+    j->b[j->n++] = (unsigned char)x;
+}
+
+static void jb4(Jb* j, int32_t x) { int i; for (i = 0; i < 4; i++) jb1(j, (int)((uint32_t)x >> (8 * i)) & 0xFF); }
+static void jb8(Jb* j, uint64_t x) { int i; for (i = 0; i < 8; i++) jb1(j, (int)(x >> (8 * i)) & 0xFF); }
+
+static void jb_fix(Jb* j, int target) {
+    if (j->nfix >= j->capfix) {
+        int nc = j->capfix ? j->capfix * 2 : 16;
+        JitFix* nf = (JitFix*)realloc(j->fix, (size_t)nc * sizeof(JitFix));
+        if (!nf) { fprintf(stderr, "ERROR: out of memory in JIT\n"); exit(1); }
+        j->fix = nf; j->capfix = nc;
+    }
+    j->fix[j->nfix].at = j->n;
+    j->fix[j->nfix].target = target;
+    j->nfix++;
+    jb4(j, 0);
+}
+
+/* movsd xmm, [base + disp]   (base: RAX or RBX) */
+static void x_load(Jb* j, int xmm, int base, int disp) { jb1(j, 0xF2); jb1(j, 0x0F); jb1(j, 0x10); jb1(j, 0x80 | (xmm << 3) | base); jb4(j, disp); }
+/* movsd [base + disp], xmm */
+static void x_store(Jb* j, int xmm, int base, int disp) { jb1(j, 0xF2); jb1(j, 0x0F); jb1(j, 0x11); jb1(j, 0x80 | (xmm << 3) | base); jb4(j, disp); }
+/* F2/66 0F op  xmm_dst, xmm_src */
+static void x_sse(Jb* j, int pfx, int op, int dst, int src) { jb1(j, pfx); jb1(j, 0x0F); jb1(j, op); jb1(j, 0xC0 | (dst << 3) | src); }
+
+/* mov reg, imm64 */
+static void x_imm64(Jb* j, int reg, uint64_t v) { jb1(j, 0x48 | (reg >= 8)); jb1(j, 0xB8 + (reg & 7)); jb8(j, v); }
+/* mov reg32, imm32 */
+static void x_imm32(Jb* j, int reg, int v) { if (reg >= 8) jb1(j, 0x41); jb1(j, 0xB8 + (reg & 7)); jb4(j, v); }
+/* mov reg, [rbx + disp] (64-bit) */
+static void x_ldq(Jb* j, int reg, int disp) { jb1(j, 0x48 | ((reg >= 8) << 2)); jb1(j, 0x8B); jb1(j, 0x80 | ((reg & 7) << 3) | RBX); jb4(j, disp); }
+/* mov reg32, [rbx + disp] */
+/* lea reg, [rbx + disp] */
+static void x_lea(Jb* j, int reg, int disp) { jb1(j, 0x48 | ((reg >= 8) << 2)); jb1(j, 0x8D); jb1(j, 0x80 | ((reg & 7) << 3) | RBX); jb4(j, disp); }
+/* mov reg, [r12 + disp]  (bound slot of a reference) */
+static void x_ldslot(Jb* j, int reg, int disp) { jb1(j, 0x49 | ((reg >= 8) << 2)); jb1(j, 0x8B); jb1(j, 0x84 | ((reg & 7) << 3)); jb1(j, 0x24); jb4(j, disp); }
+
+static void x_call(Jb* j, const void* fn) { x_imm64(j, RAX, (uint64_t)(uintptr_t)fn); jb1(j, 0xFF); jb1(j, 0xD0); }
+static void x_jmp(Jb* j, int target) { jb1(j, 0xE9); jb_fix(j, target); }
+/* return eax from the function */
+static void x_ret(Jb* j) { x_jmp(j, -1); }
+static void x_ret_imm(Jb* j, int v) { x_imm32(j, RAX, v); x_ret(j); }
+/* test eax, eax ; jne epilogue */
+static void x_ret_nz(Jb* j) { jb1(j, 0x85); jb1(j, 0xC0); jb1(j, 0x0F); jb1(j, 0x85); jb_fix(j, -1); }
+
+/* xmm1 = constant */
+static void x_const1(Jb* j, double d) { uint64_t u; memcpy(&u, &d, sizeof(u)); x_imm64(j, RAX, u); jb1(j, 0x66); jb1(j, 0x48); jb1(j, 0x0F); jb1(j, 0x6E); jb1(j, 0xC8); }
+
+static void x_call1(Jb* j, int d, const void* fn) { x_load(j, 0, RBX, FR_ST(d - 1)); x_call(j, fn); x_store(j, 0, RBX, FR_ST(d - 1)); }
+static void x_call2(Jb* j, int d, const void* fn) { x_load(j, 0, RBX, FR_ST(d - 2)); x_load(j, 1, RBX, FR_ST(d - 1)); x_call(j, fn); x_store(j, 0, RBX, FR_ST(d - 2)); }
+
+/* ---------- executable memory ---------- */
+static unsigned char* jit_alloc(size_t n) {
+#if defined(_WIN32)
+    return (unsigned char*)VirtualAlloc(NULL, n, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void* p = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? NULL : (unsigned char*)p;
+#endif
+}
+
+static int jit_seal(unsigned char* p, size_t n) {
+#if defined(_WIN32)
+    DWORD old;
+    return VirtualProtect(p, n, PAGE_EXECUTE_READ, &old) != 0;
+#else
+    return mprotect(p, n, PROT_READ | PROT_EXEC) == 0;
+#endif
+}
+
+static void jit_release(unsigned char* p, size_t n) {
+#if defined(_WIN32)
+    (void)n;
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munmap(p, n);
+#endif
+}
+
+/* ---------- translation ---------- */
+static int set_depth(int* depth_at, int pc, int d) {
+    if (depth_at[pc] >= 0 && depth_at[pc] != d) return 0;
+    depth_at[pc] = d;
+    return 1;
+}
+
+static int jit_translate(const VmChunk* ch, Jb* j, int* native_at, char* kind) {
+    const int* code = ch->code;
+    int* depth_at = (int*)malloc((size_t)(ch->ncode + 1) * sizeof(int));
+    int pc = 0, d = 0, ok = 1, i, prev = -1, idisp = 0;
+
+    if (!depth_at) return 0;
+    if (!var_int_disp(&idisp)) { free(depth_at); return 0; }
+    for (i = 0; i <= ch->ncode; i++) depth_at[i] = -1;
+
+    /* prologue: rsp is 8 mod 16 on entry; two pushes + 40 keep calls aligned and leave
+       the 32-byte Win64 shadow area */
+    jb1(j, 0x53);                                   /* push rbx */
+    jb1(j, 0x41); jb1(j, 0x54);                     /* push r12 */
+    jb1(j, 0x48); jb1(j, 0x83); jb1(j, 0xEC); jb1(j, 40);
+    jb1(j, 0x48); jb1(j, 0x89); jb1(j, 0xC0 | (arg_reg[0] << 3) | RBX);   /* mov rbx, frame */
+    jb1(j, 0x4C); jb1(j, 0x8B); jb1(j, 0xA3); jb4(j, FR_REFS);            /* mov r12, [rbx + refs] */
+
+    while (ok && pc < ch->ncode) {
+        int op = code[pc], a1 = pc + 1 < ch->ncode ? code[pc + 1] : 0;
+        int next = pc + 1, jump = 0;
+
+        if (depth_at[pc] >= 0) {
+            if (depth_at[pc] != d && !(d < 0)) { ok = 0; break; }
+            d = depth_at[pc];
+        }
+        if (d < 0) d = 0;
+        native_at[pc] = j->n;
+
+        switch ((VmOp)op) {
+        case OP_NUM: case OP_INUM: {
+            uint64_t u; memcpy(&u, &ch->k[a1], sizeof(u));
+            x_imm64(j, RAX, u);
+            jb1(j, 0x48); jb1(j, 0x89); jb1(j, 0x83); jb4(j, FR_ST(d));   /* mov [rbx + slot], rax */
+            d++; next = pc + 2;
+        } break;
+        case OP_VAR: case OP_VAR2: {
+            int n = op == OP_VAR2 ? 2 : 1, k;
+            for (k = 0; k < n; k++) {
+                int r = code[pc + 1 + k];
+                kind[r] = JR_VAR;
+                x_ldslot(j, RAX, REF_SLOT(r));
+                x_load(j, 0, RAX, VAR_NUM);
+                x_store(j, 0, RBX, FR_ST(d));
+                d++;
+            }
+            next = pc + 1 + n;
+        } break;
+        case OP_IVAR:
+            kind[a1] = JR_INT;
+            x_ldslot(j, RAX, REF_SLOT(a1));
+            jb1(j, 0x48); jb1(j, 0x8B); jb1(j, 0x80); jb4(j, idisp);            /* mov rax, [rax + int] */
+            jb1(j, 0xF2); jb1(j, 0x48); jb1(j, 0x0F); jb1(j, 0x2A); jb1(j, 0xC0); /* cvtsi2sd xmm0, rax */
+            x_store(j, 0, RBX, FR_ST(d));
+            d++; next = pc + 2;
+            break;
+        case OP_ARR: case OP_IARR: {
+            int n = code[pc + 2];
+            kind[a1] = JR_ARR;
+            x_ldslot(j, arg_reg[0], REF_SLOT(a1));
+            x_lea(j, arg_reg[1], FR_ST(d - n));
+            x_imm32(j, arg_reg[2], n);
+            x_call(j, (const void*)jit_arr_get);
+            d -= n;
+            x_store(j, 0, RBX, FR_ST(d));
+            d++; next = pc + 3;
+        } break;
+        case OP_NEG:
+            x_load(j, 0, RBX, FR_ST(d - 1));
+            x_imm64(j, RAX, 0x8000000000000000ULL);
+            jb1(j, 0x66); jb1(j, 0x48); jb1(j, 0x0F); jb1(j, 0x6E); jb1(j, 0xC8);   /* movq xmm1, rax */
+            x_sse(j, 0x66, 0x57, 0, 1);                                          /* xorpd xmm0, xmm1 */
+            x_store(j, 0, RBX, FR_ST(d - 1));
+            break;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+        case OP_ADDK: case OP_SUBK: case OP_MULK: case OP_DIVK: {
+            int sse = (op == OP_ADD || op == OP_ADDK) ? 0x58 : (op == OP_SUB || op == OP_SUBK) ? 0x5C
+                    : (op == OP_MUL || op == OP_MULK) ? 0x59 : 0x5E;
+            if (op >= OP_ADDK) {
+                x_load(j, 0, RBX, FR_ST(d - 1));
+                x_const1(j, ch->k[a1]);
+                x_sse(j, 0xF2, sse, 0, 1);
+                x_store(j, 0, RBX, FR_ST(d - 1));
+                next = pc + 2;
+            }
+            else {
+                x_load(j, 0, RBX, FR_ST(d - 2));
+                x_load(j, 1, RBX, FR_ST(d - 1));
+                x_sse(j, 0xF2, sse, 0, 1);
+                x_store(j, 0, RBX, FR_ST(d - 2));
+                d--;
+            }
+        } break;
+        case OP_EQ: case OP_NE: case OP_LT: case OP_GT: case OP_LE: case OP_GE:
+            x_load(j, 0, RBX, FR_ST(d - 2));
+            x_load(j, 1, RBX, FR_ST(d - 1));
+            /* ucomisd leaves ZF=PF=CF=1 for NaN, so = and <> need the parity flag */
+            if (op == OP_LT || op == OP_LE) x_sse(j, 0x66, 0x2E, 1, 0);          /* ucomisd xmm1, xmm0 */
+            else x_sse(j, 0x66, 0x2E, 0, 1);                                     /* ucomisd xmm0, xmm1 */
+            switch (op) {
+            case OP_EQ: jb1(j, 0x0F); jb1(j, 0x94); jb1(j, 0xC0); jb1(j, 0x0F); jb1(j, 0x9B); jb1(j, 0xC1); jb1(j, 0x20); jb1(j, 0xC8); break;
+            case OP_NE: jb1(j, 0x0F); jb1(j, 0x95); jb1(j, 0xC0); jb1(j, 0x0F); jb1(j, 0x9A); jb1(j, 0xC1); jb1(j, 0x08); jb1(j, 0xC8); break;
+            case OP_LT: case OP_GT: jb1(j, 0x0F); jb1(j, 0x97); jb1(j, 0xC0); break;   /* seta al */
+            default: jb1(j, 0x0F); jb1(j, 0x93); jb1(j, 0xC0); break;                  /* setae al */
+            }
+            jb1(j, 0x0F); jb1(j, 0xB6); jb1(j, 0xC0);                            /* movzx eax, al */
+            jb1(j, 0xF2); jb1(j, 0x0F); jb1(j, 0x2A); jb1(j, 0xC0);              /* cvtsi2sd xmm0, eax */
+            x_store(j, 0, RBX, FR_ST(d - 2));
+            d--;
+            break;
+        case OP_POW: x_call2(j, d, (const void*)jit_pow); d--; break;
+        case OP_AND: x_call2(j, d, (const void*)jit_and); d--; break;
+        case OP_OR:  x_call2(j, d, (const void*)jit_or); d--; break;
+        case OP_XOR: x_call2(j, d, (const void*)jit_xor); d--; break;
+        case OP_FN0:
+            x_call(j, (const void*)ch->fns[a1].f0);
+            x_store(j, 0, RBX, FR_ST(d));
+            d++; next = pc + 2;
+            break;
+        case OP_FN1: x_call1(j, d, (const void*)ch->fns[a1].f1); next = pc + 2; break;
+        case OP_FN2: x_call2(j, d, (const void*)ch->fns[a1].f2); d--; next = pc + 2; break;
+        case OP_RND:
+            if (a1) d--;
+            x_call(j, (const void*)fn_rnd);
+            x_store(j, 0, RBX, FR_ST(d));
+            d++; next = pc + 2;
+            break;
+
+        case OP_LET:
+            kind[a1] = code[pc + 2] ? JR_LETCLR : JR_VAR;
+            x_load(j, 0, RBX, FR_ST(d - 1));
+            x_ldslot(j, RAX, REF_SLOT(a1));
+            x_store(j, 0, RAX, VAR_NUM);
+            d--; next = pc + 3;
+            break;
+        case OP_ILET:
+            /* only a literal: any other value would have to be exact, which the doubles are not */
+            if (prev < 0 || code[prev] != OP_INUM) { ok = 0; break; }
+            kind[a1] = JR_INT;
+            x_imm64(j, RAX, (uint64_t)(BasInt)ch->k[code[prev + 1]]);
+            x_ldslot(j, RCX, REF_SLOT(a1));
+            jb1(j, 0x48); jb1(j, 0x89); jb1(j, 0x81); jb4(j, idisp);            /* mov [rcx + int], rax */
+            d--; next = pc + 3;
+            break;
+        case OP_LETADDK:
+            kind[a1] = code[pc + 3] ? JR_LETCLR : JR_VAR;
+            x_const1(j, ch->k[code[pc + 2]]);                                    /* (through rax) */
+            x_ldslot(j, RAX, REF_SLOT(a1));
+            x_load(j, 0, RAX, VAR_NUM);
+            x_sse(j, 0xF2, 0x58, 0, 1);                                          /* addsd xmm0, xmm1 */
+            x_store(j, 0, RAX, VAR_NUM);
+            next = pc + 4;
+            break;
+        case OP_ILETARR:
+            /* a whole literal below 2^53 is exact as a double */
+            if (prev < 0 || code[prev] != OP_INUM) { ok = 0; break; }
+            /* fall through */
+        case OP_LETARR: {
+            int n = code[pc + 2];
+            kind[a1] = JR_ARR;
+            d -= n + 1;
+            x_ldslot(j, arg_reg[0], REF_SLOT(a1));
+            x_lea(j, arg_reg[1], FR_ST(d));
+            x_imm32(j, arg_reg[2], n);
+            x_call(j, (const void*)jit_arr_set);
+            next = pc + 3;
+        } break;
+        case OP_FOR:
+            d -= 3;
+            x_lea(j, arg_reg[0], FR_ST(d));
+            x_imm64(j, arg_reg[1], (uint64_t)(uintptr_t)ch->str[a1]);
+            x_imm32(j, arg_reg[2], code[pc + 2]);
+            x_call(j, (const void*)jit_for);
+            x_ret_nz(j);
+            next = pc + 3;
+            break;
+        case OP_NEXT: case OP_NEXTV: {
+            int s = op == OP_NEXTV ? code[pc + 2] : a1;
+            x_imm64(j, arg_reg[0], s < 0 ? 0 : (uint64_t)(uintptr_t)ch->str[s]);
+            x_ldq(j, arg_reg[1], FR_JUMP);
+            x_call(j, (const void*)for_next);
+            x_ret_nz(j);
+            next = pc + (op == OP_NEXTV ? 3 : 2);
+        } break;
+        case OP_GOTO:
+            x_ldq(j, RAX, FR_JUMP);
+            jb1(j, 0xC7); jb1(j, 0x00); jb4(j, a1);                              /* mov dword [rax], line */
+            x_ret_imm(j, 1);
+            next = pc + 2; jump = 1;
+            break;
+        case OP_GOSUB:
+            x_imm32(j, arg_reg[0], a1);
+            x_imm32(j, arg_reg[1], code[pc + 2]);
+            x_ldq(j, arg_reg[2], FR_JUMP);
+            x_call(j, (const void*)jit_gosub);
+            x_ret(j);
+            next = pc + 3; jump = 1;
+            break;
+        case OP_RETURN:
+            x_ldq(j, arg_reg[0], FR_JUMP);
+            x_call(j, (const void*)gosub_return);
+            x_ret(j);
+            jump = 1;
+            break;
+        case OP_END: x_ret_imm(j, 9); jump = 1; break;
+        case OP_RET0:
+            jb1(j, 0x31); jb1(j, 0xC0);                                          /* xor eax, eax */
+            x_ret(j);
+            jump = 1;
+            break;
+        case OP_JZ:
+            d--;
+            x_load(j, 0, RBX, FR_ST(d));
+            x_sse(j, 0x66, 0x57, 1, 1);                                          /* xorpd xmm1, xmm1 */
+            x_sse(j, 0x66, 0x2E, 0, 1);                                          /* ucomisd xmm0, xmm1 */
+            jb1(j, 0x7A); jb1(j, 6);                                             /* jp +6 (NaN is not 0) */
+            jb1(j, 0x0F); jb1(j, 0x84); jb_fix(j, pc + 2 + a1);                  /* je target */
+            ok = set_depth(depth_at, pc + 2 + a1, d);
+            next = pc + 2;
+            break;
+        case OP_JMP:
+            x_jmp(j, pc + 2 + a1);
+            ok = set_depth(depth_at, pc + 2 + a1, d);
+            next = pc + 2; jump = 1;
+            break;
+        default:
+            ok = 0;
+            break;
+        }
+        if (d < 0 || d > VM_STACK) ok = 0;
+        if (jump) d = -1;    /* unreachable until a jump target sets it */
+        prev = pc;
+        pc = next;
+    }
+    if (ok && pc <= ch->ncode) native_at[pc] = j->n;
+
+    /* epilogue */
+    if (ok) {
+        int epi = j->n;
+        jb1(j, 0x48); jb1(j, 0x83); jb1(j, 0xC4); jb1(j, 40);                    /* add rsp, 40 */
+        jb1(j, 0x41); jb1(j, 0x5C);                                              /* pop r12 */
+        jb1(j, 0x5B);                                                            /* pop rbx */
+        jb1(j, 0xC3);
+        for (i = 0; i < j->nfix; i++) {
+            int t = j->fix[i].target;
+            int dst = t < 0 ? epi : (t <= ch->ncode ? native_at[t] : -1);
+            int32_t rel;
+            if (dst < 0) { ok = 0; break; }
+            rel = (int32_t)(dst - (j->fix[i].at + 4));
+            memcpy(j->b + j->fix[i].at, &rel, 4);
+        }
+    }
+    free(depth_at);
+    return ok;
+}
+
+JitCode* jit_compile(const VmChunk* ch) {
+    Jb j;
+    JitCode* jc;
+    int* native_at;
+    int i;
+
+    if (!ch || ch->ncode == 0) return NULL;
+    memset(&j, 0, sizeof(j));
+    native_at = (int*)malloc((size_t)(ch->ncode + 1) * sizeof(int));
+    jc = (JitCode*)calloc(1, sizeof(JitCode));
+    if (jc) jc->kind = (char*)calloc((size_t)ch->nref + 1, 1);
+    if (!native_at || !jc || !jc->kind) { free(native_at); jit_free(jc); return NULL; }
+    for (i = 0; i <= ch->ncode; i++) native_at[i] = -1;
+
+    if (!jit_translate(ch, &j, native_at, jc->kind)) {
+        free(j.b); free(j.fix); free(native_at); jit_free(jc);
+        return NULL;
+    }
+    free(native_at);
+
+    jc->nref = ch->nref;
+    jc->size = ((size_t)j.n + 4095) & ~(size_t)4095;
+    jc->mem = jit_alloc(jc->size);
+    if (jc->mem) {
+        memcpy(jc->mem, j.b, (size_t)j.n);
+        if (!jit_seal(jc->mem, jc->size)) { jit_release(jc->mem, jc->size); jc->mem = NULL; }
+    }
+    free(j.b); free(j.fix);
+    if (!jc->mem) { jit_free(jc); return NULL; }
+    jc->fn = (int (*)(void*))(uintptr_t)jc->mem;
+    return jc;
+}
+
+#else  /* !JIT_X64 */
+
+JitCode* jit_compile(const VmChunk* ch) { (void)ch; return NULL; }
+
+#endif
+
+void jit_free(JitCode* jc) {
+    if (!jc) return;
+#ifdef JIT_X64
+    if (jc->mem) jit_release(jc->mem, jc->size);
+#endif
+    free(jc->kind);
+    free(jc);
+}
+
+/* ---------- entry ---------- */
+int jit_exec(JitCode* jc, VmChunk* ch, int currentLine, int* outJump, int* result) {
+    JitFrame fr;
+    int i;
+
+    /* bind every reference the same way the VM does; strings and unbound names go to the VM */
+    for (i = 0; i < jc->nref; i++) {
+        VmRef* r = &ch->refs[i];
+        if (jc->kind[i] == JR_NONE) continue;
+        if (!r->slot || r->epoch != g_var_epoch) {
+            if (jc->kind[i] == JR_ARR) r->slot = (void*)array_find(r->name);
+            else { int v = find_var(r->name); r->slot = v < 0 ? NULL : (void*)&g_var_num[v]; }
+            r->epoch = g_var_epoch;
+        }
+        if (!r->slot) return 0;
+        if (jc->kind[i] == JR_INT) {
+            if (g_var_type[(double*)r->slot - g_var_num] != VT_INT) return 0;
+        }
+        else if (jc->kind[i] != JR_ARR) {
+            int v = (int)((double*)r->slot - g_var_num);
+            if (g_var_type[v] != VT_NUM || (jc->kind[i] == JR_LETCLR && g_var_str[v].len)) return 0;
+        }
+    }
+    fr.refs = ch->refs;
+    fr.outJump = outJump;
+    *result = jc->fn(&fr);
+    return 1;
+}
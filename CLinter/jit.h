@@ -0,0 +1,26 @@
+#ifndef JIT_H
+#define JIT_H
+#include "runtime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct VmChunk;
+typedef struct JitCode JitCode;
+
+/* Translate a line's bytecode to native x86-64 code (--engine=jit).
+   NULL if the chunk uses anything the JIT does not handle (strings, PRINT, I/O,
+   interpreter hand-offs) or the host is not x86-64; the line then stays on the VM. */
+JitCode* jit_compile(const struct VmChunk* ch);
+void     jit_free(JitCode* jc);
+
+/* Run the native code for a line. Returns 0 if the line has to run on the VM this
+   time (a reference is unbound or holds a string), else 1 with *result set to the
+   exec_statement return code. */
+int jit_exec(JitCode* jc, struct VmChunk* ch, int currentLine, int* outJump, int* result);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -3,9 +3,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <limits.h>
 #include "runtime.h"
 #include "parse.h"
 #include "wxecut.h"
+#include "crunch.h"
+#include "compile.h"
+#include "vm.h"
+#include "emitc.h"
+#include "profile.h"
 
 #include <locale.h>
 #if defined(_WIN32)
@@ -31,9 +38,17 @@ void install_sigint_handler(void) {
 /* --------- Globals --------- */
 ProgLine g_prog[MAX_PROG_LINES]; 
 int g_prog_count = 0;
-
-Variable g_vars[MAX_VARS]; 
+unsigned g_prog_epoch = 0;
+
+double g_var_num[MAX_VARS];
+BasInt g_var_int[MAX_VARS];
+BasStr g_var_str[MAX_VARS];
+unsigned char g_var_type[MAX_VARS];
+unsigned char g_var_numok[MAX_VARS];
+char g_var_name[MAX_VARS][32];
 int g_var_count = 0;
+unsigned g_var_epoch = 0;
+unsigned g_defint = 0;
 
 ForFrame g_for_stack[MAX_STACK]; 
 int g_for_top = 0;
@@ -41,6 +56,9 @@ int g_for_top = 0;
 int g_gosub_stack[MAX_STACK]; 
 int g_gosub_top = 0;
 
+int g_pc_index = -1;
+int g_pc_seg = 0;
+
 FileSlot g_files[MAX_FILES];
 
 /* arrays */
@@ -59,17 +77,395 @@ char* strdup_c(const char* s) { size_t n = strlen(s); char* p = (char*)malloc(n
 char* trim(char* s) { char* a = s, * b = s + strlen(s); while (a < b && isspace((unsigned char)*a))++a; while (b > a && isspace((unsigned char)b[-1]))--b; memmove(s, a, (size_t)(b - a)); s[b - a] = '\0'; return s; }
 static int cmp_lines(const void* a, const void* b) { const ProgLine* pa = (const ProgLine*)a; const ProgLine* pb = (const ProgLine*)b; return (pa->number > pb->number) - (pa->number < pb->number); }
 void sort_program(void) { qsort(g_prog, (size_t)g_prog_count, sizeof(ProgLine), cmp_lines); }
-int find_prog_index_by_line(int line) { int lo = 0, hi = g_prog_count - 1; while (lo <= hi) { int mid = (lo + hi) / 2; if (g_prog[mid].number == line) return mid; if (g_prog[mid].number < line) lo = mid + 1; else hi = mid - 1; } return -1; }
-int next_line_number_after(int current) { int i; sort_program(); for (i = 0; i < g_prog_count; i++) { if (g_prog[i].number > current) return g_prog[i].number; } return -1; }
-Variable* find_var(const char* name) { int i; for (i = 0; i < g_var_count; i++) { if (_stricmp(g_vars[i].name, name) == 0) return &g_vars[i]; } return NULL; }
+
+/* ---- link pass ----
+   g_prog is kept sorted by prog_set_line. prog_link maps every line number in the
+   program's range straight to its index, so jumps and successor lookups during RUN
+   neither sort nor search, and chains every line to the next one RUN executes, so
+   REM, DATA and blank lines are stepped over without being visited. The tables belong
+   to one g_prog_epoch; any edit makes the lookups fall back to binary search and
+   line-by-line stepping until the next link. */
+#define LINK_MAX_SPAN (1 << 20)        /* sparser programs keep the binary search */
+
+static int*     g_link_index = NULL;   /* [number - g_link_min] -> index, -1 = no such line */
+static int      g_link_min = 0, g_link_span = 0;   /* span 0: too sparse, binary search */
+static int*     g_link_run = NULL;     /* [index] -> first index >= it with code to run */
+static unsigned g_link_epoch = 0;
+static int      g_link_valid = 0;
+
+/* first index whose number is > line */
+static int prog_upper_bound(int line) { int lo = 0, hi = g_prog_count; while (lo < hi) { int mid = (lo + hi) / 2; if (g_prog[mid].number <= line) lo = mid + 1; else hi = mid; } return lo; }
+
+static int link_current(void) { return g_link_valid && g_link_epoch == g_prog_epoch; }
+
+int find_prog_index_by_line(int line) {
+	int lo = 0, hi = g_prog_count - 1;
+	if (link_current() && g_link_span > 0) {
+		unsigned off = (unsigned)(line - g_link_min);
+		return off < (unsigned)g_link_span ? g_link_index[off] : -1;
+	}
+	while (lo <= hi) { int mid = (lo + hi) / 2; if (g_prog[mid].number == line) return mid; if (g_prog[mid].number < line) lo = mid + 1; else hi = mid - 1; }
+	return -1;
+}
+
+int next_line_number_after(int current) {
+	int i = find_prog_index_by_line(current);
+	i = i >= 0 ? i + 1 : prog_upper_bound(current);   /* not a program line: immediate mode */
+	return i < g_prog_count ? g_prog[i].number : -1;
+}
+
+/* the statement after statement 'seg' of g_prog[index]: the next one on the line,
+   else the first of the next line */
+int prog_pc_after(int index, int seg) {
+	const CrunchLine* cl = g_prog[index].code;
+	if (cl && seg + 1 < cl->nseg && seg + 1 < (1 << PC_SEG_BITS)) return PC_MAKE(index, seg + 1);
+	return index + 1 < g_prog_count ? PC_MAKE(index + 1, 0) : -1;
+}
+
+/* the line RUN executes when control reaches g_prog[index] at its first statement
+   (TRACE still lists every line it passes) */
+static int prog_run_from(int index) {
+	return link_current() && !g_trace && index < g_prog_count ? g_link_run[index] : index;
+}
+
+/* report a GOTO/GOSUB/THEN/ELSE/ON target that names no program line */
+static int link_check_target(int line, const CrunchTok* t) {
+	if (t->type != T_NUMBER || find_prog_index_by_line((int)t->number) >= 0) return 0;
+	printf("WARNING: line %d refers to undefined line %d\n", line, (int)t->number);
+	return 1;
+}
+
+/* Build the line index for the current program and report undefined jump targets.
+   Returns the number of undefined targets (execution still reports them when taken). */
+int prog_link(void) {
+	int i, k, bad = 0;
+
+	if (link_current()) return 0;
+	prog_defint();
+	for (i = 1; i < g_prog_count; i++)
+		if (g_prog[i - 1].number >= g_prog[i].number) { sort_program(); break; }
+
+	g_link_valid = 0;
+	g_link_span = g_prog_count ? g_prog[g_prog_count - 1].number - g_prog[0].number + 1 : 0;
+	if (g_link_span > LINK_MAX_SPAN) g_link_span = 0;
+	if (g_link_span > 0) {
+		int* idx = (int*)realloc(g_link_index, (size_t)g_link_span * sizeof(int));
+		if (idx) {
+			g_link_index = idx;
+			g_link_min = g_prog[0].number;
+			for (k = 0; k < g_link_span; k++) g_link_index[k] = -1;
+			for (i = 0; i < g_prog_count; i++) g_link_index[g_prog[i].number - g_link_min] = i;
+		}
+		else g_link_span = 0;
+	}
+	{
+		int* run = (int*)realloc(g_link_run, (size_t)(g_prog_count + 1) * sizeof(int));
+		if (run) {
+			g_link_run = run;
+			g_link_run[g_prog_count] = g_prog_count;
+			for (i = g_prog_count - 1; i >= 0; i--)
+				g_link_run[i] = (g_prog[i].code && g_prog[i].code->nrun > 0) ? i : g_link_run[i + 1];
+			g_link_epoch = g_prog_epoch;
+			g_link_valid = 1;
+		}
+	}
+
+	for (i = 0; i < g_prog_count; i++) {
+		const CrunchLine* cl = g_prog[i].code;
+		if (!cl) continue;
+		for (k = 0; k < cl->ntok; k++) {
+			const CrunchTok* t = &cl->toks[k];
+			if (t->type == T_THEN || t->type == T_ELSE) bad += link_check_target(g_prog[i].number, t + 1);
+			else if (t->type == T_GOTO || t->type == T_GOSUB) {
+				/* GOTO n, or the ON ... GOTO n1, n2, ... list */
+				for (t++; t->type == T_NUMBER; t += 2) {
+					bad += link_check_target(g_prog[i].number, t);
+					if (t[1].type != T_COMMA) break;
+				}
+			}
+		}
+	}
+	return bad;
+}
+/* ---- name lookup ----
+   Variables and arrays are found through the identifier interner (crunch.cpp): the
+   interned id of the case-folded name indexes a slot map per table, so a lookup costs
+   one hash of the name however many entries there are. A slot (index into g_var_*,
+   g_arrays, g_sarrays) stays put until its table is cleared. */
+typedef struct { int* slot; int cap; } SymMap;   /* [sym id] -> index + 1, 0 = none */
+
+static SymMap g_var_map, g_array_map, g_sarray_map;
+
+static int symmap_get(const SymMap* m, const char* name) {
+	int id = sym_find(name);
+	return id >= 0 && id < m->cap ? m->slot[id] - 1 : -1;
+}
+
+static void symmap_put(SymMap* m, const char* name, int index) {
+	int id = sym_intern(name);
+	if (id >= m->cap) {
+		int nc = m->cap ? m->cap : 64;
+		int* ns;
+		while (nc <= id) nc *= 2;
+		ns = (int*)realloc(m->slot, (size_t)nc * sizeof(int));
+		if (!ns) { fprintf(stderr, "ERROR: out of memory in symbol table\n"); exit(1); }
+		memset(ns + m->cap, 0, (size_t)(nc - m->cap) * sizeof(int));
+		m->slot = ns; m->cap = nc;
+	}
+	m->slot[id] = index + 1;
+}
+
+static void symmap_clear(SymMap* m) { if (m->slot) memset(m->slot, 0, (size_t)m->cap * sizeof(int)); }
+
+int find_var(const char* name) { return symmap_get(&g_var_map, name); }
 int is_string_var_name(const char* name) { size_t n = strlen(name); return n > 0 && name[n - 1] == '$'; }
-Variable* ensure_var(const char* name, int isStr) { Variable* v = find_var(name); if (!v) { if (g_var_count >= MAX_VARS) return NULL; v = &g_vars[g_var_count++]; memset(v, 0, sizeof(*v)); strncpy(v->name, name, sizeof(v->name) - 1); v->type = isStr ? VT_STR : VT_NUM; v->num = 0.0; } else { v->type = isStr ? VT_STR : VT_NUM; } return v; }
+
+int is_int_var_name(const char* name) {
+	size_t n = strlen(name);
+	int c = toupper((unsigned char)name[0]);
+	if (n == 0 || name[n - 1] == '$') return 0;
+	return name[n - 1] == '%' || (c >= 'A' && c <= 'Z' && (g_defint >> (c - 'A') & 1));
+}
+
+/* DEFINT declares letters for the whole program: RUN applies every DEFINT line before
+   the first statement runs, so a variable's type is settled when it is created. Names
+   already in the table keep the type they were created with. The letters are rebuilt
+   from the program each time it is relinked, so a deleted DEFINT line no longer counts. */
+void prog_defint(void) {
+	int i, k;
+	g_defint = 0;
+	for (i = 0; i < g_prog_count; i++) {
+		const CrunchLine* cl = g_prog[i].code;
+		if (!cl) continue;
+		for (k = 0; k < cl->nseg; k++) {
+			Lexer lx;
+			unsigned letters;
+			if (cl->toks[cl->segs[k].first].type != T_DEFINT) continue;
+			lx_init_crunched(&lx, cl, k);
+			lx_next(&lx);
+			if (defint_letters(&lx, &letters) == 0) g_defint |= letters;   /* errors are reported when the line runs */
+		}
+	}
+}
+
+/* a number/string store into an existing slot keeps integer variables integer */
+static void var_retype(int v, int isStr) {
+	if (isStr && g_var_type[v] != VT_STR) { g_var_type[v] = VT_STR; g_var_numok[v] = 0; }
+	else if (g_var_type[v] == VT_STR) {
+		bstr_free(&g_var_str[v]);
+		g_var_type[v] = is_int_var_name(g_var_name[v]) ? VT_INT : VT_NUM;
+	}
+}
+
+int ensure_var(const char* name, int isStr) {
+	int v = find_var(name);
+	if (v < 0) {
+		if (g_var_count >= MAX_VARS) return -1;
+		v = g_var_count++;
+		symmap_put(&g_var_map, name, v);
+		strncpy(g_var_name[v], name, sizeof(g_var_name[v]) - 1);
+		g_var_name[v][sizeof(g_var_name[v]) - 1] = 0;
+		g_var_num[v] = 0.0;
+		g_var_int[v] = 0;
+		bstr_free(&g_var_str[v]);
+		g_var_numok[v] = 0;
+		g_var_type[v] = isStr ? VT_STR : is_int_var_name(name) ? VT_INT : VT_NUM;
+		return v;
+	}
+	var_retype(v, isStr);
+	return v;
+}
+
+/* ---- strings ---- */
+const char* bstr_ptr(const BasStr* s) { return s->cap ? s->u.heap->data : s->u.in; }
+
+/* a value that fits where the string already is (inline, or a heap buffer no one else
+   holds) is copied over it; a short one leaving a shared buffer goes inline; anything
+   else allocates, at least doubling an own buffer so a string grown a piece at a time
+   reallocates O(log n) times */
+int bstr_set(BasStr* s, const char* p, int n) {
+	int own = s->cap && s->u.heap->refs == 1;
+	char* d;
+	if (n < 0) n = 0;
+	if (own ? n < s->cap : !s->cap && n < STR_INLINE) {
+		d = own ? s->u.heap->data : s->u.in;
+		memmove(d, p, (size_t)n);
+	}
+	else if (n < STR_INLINE) {
+		bstr_free(s);   /* shared: the other holders keep p alive */
+		d = s->u.in;
+		memcpy(d, p, (size_t)n);
+	}
+	else {
+		int cap = own && s->cap * 2 > n + 1 ? s->cap * 2 : n + 1;
+		StrBuf* b;
+		if (cap < 2 * STR_INLINE) cap = 2 * STR_INLINE;
+		b = (StrBuf*)malloc(sizeof(StrBuf) + (size_t)cap);
+		if (!b) { printf("ERROR: OUT OF MEMORY\n"); return -1; }
+		b->refs = 1;
+		memcpy(b->data, p, (size_t)n);   /* p may be the old buffer, released only now */
+		bstr_free(s);
+		s->u.heap = b; s->cap = cap;
+		d = b->data;
+	}
+	d[n] = 0;
+	s->len = n;
+	return 0;
+}
+
+void bstr_copy(BasStr* d, const BasStr* s) {
+	if (d == s) return;
+	if (s->cap) s->u.heap->refs++;
+	bstr_free(d);
+	*d = *s;
+}
+
+void bstr_free(BasStr* s) {
+	if (s->cap && --s->u.heap->refs == 0) free(s->u.heap);
+	s->len = 0; s->cap = 0; s->u.in[0] = 0;
+}
+
+const char* var_str(int v) { return (v >= 0 && g_var_type[v] == VT_STR) ? bstr_ptr(&g_var_str[v]) : ""; }
+
+const char* var_strn(int v, int* len) {
+	if (v < 0 || g_var_type[v] != VT_STR) { *len = 0; return ""; }
+	*len = g_var_str[v].len;
+	return bstr_ptr(&g_var_str[v]);
+}
+
+void var_set_strn(int v, const char* s, int len) {
+	if (v < 0) return;
+	if (bstr_set(&g_var_str[v], s ? s : "", s ? len : 0) < 0) return;
+	g_var_type[v] = VT_STR;
+	g_var_numok[v] = 0;
+}
+
+void var_set_str(int v, const char* s) { var_set_strn(v, s, s ? (int)strlen(s) : 0); }
+
+const BasStr* var_bstr(int v) { return (v >= 0 && g_var_type[v] == VT_STR) ? &g_var_str[v] : NULL; }
+
+void var_copy_str(int v, const BasStr* s) {
+	if (v < 0) return;
+	bstr_copy(&g_var_str[v], s);
+	g_var_type[v] = VT_STR;
+	g_var_numok[v] = 0;
+}
+
+/* a string read as a number is parsed once per stored value, not on every read */
+double var_value(int v) {
+	if (v < 0) return 0.0;
+	if (g_var_type[v] == VT_NUM) return g_var_num[v];
+	if (g_var_type[v] == VT_INT) return (double)g_var_int[v];
+	if (!g_var_numok[v]) {
+		g_var_num[v] = atof(bstr_ptr(&g_var_str[v]));
+		g_var_numok[v] = 1;
+	}
+	return g_var_num[v];
+}
+
+int num_to_int(double val, BasInt* out) {
+	/* [-2^63, 2^63): every double in it converts exactly after truncation */
+	if (!(val >= -9223372036854775808.0 && val < 9223372036854775808.0)) { printf("ERROR: INTEGER OVERFLOW\n"); return -1; }
+	*out = (BasInt)val;
+	return 0;
+}
+
+BasInt num_trunc(double val) {
+	if (val >= 9223372036854775808.0) return LLONG_MAX;
+	if (val >= -9223372036854775808.0) return (BasInt)val;
+	return val < 0 ? LLONG_MIN : 0;   /* below the range, or NaN */
+}
+
+/* checked BasInt arithmetic: 1 with the result in *out, 0 when it would overflow */
+int int_add(BasInt a, BasInt b, BasInt* out) {
+	if (b > 0 ? a > LLONG_MAX - b : a < LLONG_MIN - b) return 0;
+	*out = a + b;
+	return 1;
+}
+
+int int_sub(BasInt a, BasInt b, BasInt* out) {
+	if (b < 0 ? a > LLONG_MAX + b : a < LLONG_MIN + b) return 0;
+	*out = a - b;
+	return 1;
+}
+
+int int_mul(BasInt a, BasInt b, BasInt* out) {
+	if (a > 0 ? (b > 0 ? a > LLONG_MAX / b : b < LLONG_MIN / a)
+	          : (b > 0 ? a < LLONG_MIN / b : a != 0 && b < LLONG_MAX / a)) return 0;
+	*out = a * b;
+	return 1;
+}
+
+/* a MOD b and a \ b, 0 when b is 0. b = -1 is taken apart: LLONG_MIN % -1 and
+   LLONG_MIN / -1 trap on x86, and that quotient (2^63) does not fit. */
+int int_mod(BasInt a, BasInt b, BasInt* out) {
+	*out = (b == 0 || b == -1) ? 0 : a % b;
+	return 1;
+}
+
+int int_idiv(BasInt a, BasInt b, BasInt* out) {
+	if (b == -1) { if (a == LLONG_MIN) return 0; *out = -a; return 1; }
+	*out = b == 0 ? 0 : a / b;
+	return 1;
+}
+
+int var_set_num(int v, double val) {
+	if (g_var_type[v] == VT_INT) return num_to_int(val, &g_var_int[v]);
+	g_var_type[v] = VT_NUM;
+	g_var_num[v] = val;
+	return 0;
+}
+
+void var_set_int(int v, BasInt val) {
+	if (g_var_type[v] == VT_INT) { g_var_int[v] = val; return; }
+	g_var_type[v] = VT_NUM;
+	g_var_num[v] = (double)val;
+}
+
+/* ---- inline caches ----
+   A crunched identifier token remembers the slot it resolved to last time. The slot
+   belongs to one g_var_epoch, which vars_clear, arrays_clear and sarrays_clear
+   (NEW, LOAD, CLEAR, LOADVARS) bump; DIM of an existing array keeps its slot, so the
+   cached one stays right. Editing or deleting a line frees its tokens and caches. */
+enum { IC_VAR = 1, IC_ARRAY, IC_SARRAY };
+
+static int ic_get(const CrunchTok* site, int kind) {
+	return site && site->ic && site->ic_kind == kind && site->ic_epoch == g_var_epoch ? site->ic - 1 : -1;
+}
+
+static int ic_put(CrunchTok* site, int kind, int slot) {
+	if (site && slot >= 0) { site->ic = slot + 1; site->ic_kind = kind; site->ic_epoch = g_var_epoch; }
+	return slot;
+}
+
+int find_var_at(CrunchTok* site, const char* name) {
+	int v = ic_get(site, IC_VAR);
+	return v >= 0 ? v : ic_put(site, IC_VAR, find_var(name));
+}
+
+int ensure_var_at(CrunchTok* site, const char* name, int isStr) {
+	int v = ic_get(site, IC_VAR);
+	if (v >= 0) { var_retype(v, isStr); return v; }
+	return ic_put(site, IC_VAR, ensure_var(name, isStr));
+}
+
+Array* array_find_at(CrunchTok* site, const char* name) {
+	int a = ic_get(site, IC_ARRAY);
+	if (a < 0) a = ic_put(site, IC_ARRAY, symmap_get(&g_array_map, name));
+	return a >= 0 ? &g_arrays[a] : NULL;
+}
+
+SArray* sarray_find_at(CrunchTok* site, const char* name) {
+	int a = ic_get(site, IC_SARRAY);
+	if (a < 0) a = ic_put(site, IC_SARRAY, symmap_get(&g_sarray_map, name));
+	return a >= 0 ? &g_sarrays[a] : NULL;
+}
 
 static size_t safe_mul(size_t a, size_t b) { return (a == 0 || b == 0) ? 0 : (a * b); }
 
 Array* array_find(const char* name) {
-	int i; for (i = 0; i < g_array_count; i++) if (_stricmp(g_arrays[i].name, name) == 0) return &g_arrays[i];
-	return NULL;
+	int i = symmap_get(&g_array_map, name);
+	return i >= 0 ? &g_arrays[i] : NULL;
 }
 
 Array* array_dim(const char* name, int ndims, int* dims) {
@@ -80,12 +476,14 @@ Array* array_dim(const char* name, int ndims, int* dims) {
 		Array* a = array_find(name);
 		if (!a) {
 			if (g_array_count >= MAX_ARRAYS) { printf("ERROR: ARRAY TABLE FULL\n"); return NULL; }
+			symmap_put(&g_array_map, name, g_array_count);
 			a = &g_arrays[g_array_count++]; memset(a, 0, sizeof(*a)); strncpy(a->name, name, sizeof(a->name) - 1);
 		}
-		else if (a->data) { free(a->data); a->data = NULL; }
+		else { free(a->data); free(a->idata); a->data = NULL; a->idata = NULL; }
 		a->ndims = ndims; for (i = 0; i < ndims; i++) a->dims[i] = dims[i];
-		a->data = (double*)calloc(total, sizeof(double));
-		if (!a->data) { printf("ERROR: OUT OF MEMORY\n"); return NULL; }
+		if (is_int_var_name(name)) a->idata = (BasInt*)calloc(total, sizeof(BasInt));
+		else a->data = (double*)calloc(total, sizeof(double));
+		if (!a->data && !a->idata) { printf("ERROR: OUT OF MEMORY\n"); return NULL; }
 		return a;
 	}
 }
@@ -106,24 +504,34 @@ int array_index(Array* a, int* subs, int nsubs) {
 double array_get(Array* a, int* subs, int nsubs) {
 	int k = array_index(a, subs, nsubs);
 	if (k < 0) { printf("ERROR: SUBSCRIPT\n"); return 0.0; }
-	return a->data[k];
+	return a->idata ? (double)a->idata[k] : a->data[k];
 }
 
 void array_set(Array* a, int* subs, int nsubs, double val) {
 	int k = array_index(a, subs, nsubs);
 	if (k < 0) { printf("ERROR: SUBSCRIPT\n"); return; }
-	a->data[k] = val;
+	if (a->idata) num_to_int(val, &a->idata[k]);
+	else a->data[k] = val;
+}
+
+void array_set_int(Array* a, int* subs, int nsubs, BasInt val) {
+	int k = array_index(a, subs, nsubs);
+	if (k < 0) { printf("ERROR: SUBSCRIPT\n"); return; }
+	if (a->idata) a->idata[k] = val;
+	else a->data[k] = (double)val;
 }
 
 void arrays_clear(void) {
-	int i; for (i = 0; i < g_array_count; i++) { if (g_arrays[i].data) free(g_arrays[i].data); g_arrays[i].data = NULL; }
+	int i; for (i = 0; i < g_array_count; i++) { free(g_arrays[i].data); free(g_arrays[i].idata); g_arrays[i].data = NULL; g_arrays[i].idata = NULL; }
 	g_array_count = 0;
+	symmap_clear(&g_array_map);
+	g_var_epoch++;
 }
 
 SArray* sarray_find(const char* name) 
 {
-	int i; for (i = 0; i < g_sarray_count; i++) if (_stricmp(g_sarrays[i].name, name) == 0) return &g_sarrays[i];
-	return NULL;
+	int i = symmap_get(&g_sarray_map, name);
+	return i >= 0 ? &g_sarrays[i] : NULL;
 }
 
 SArray* sarray_dim(const char* name, int ndims, int* dims) {
@@ -134,15 +542,16 @@ SArray* sarray_dim(const char* name, int ndims, int* dims) {
 		SArray* a = sarray_find(name);
 		if (!a) {
 			if (g_sarray_count >= MAX_SARRAYS) { printf("ERROR: STRING ARRAY TABLE FULL\n"); return NULL; }
+			symmap_put(&g_sarray_map, name, g_sarray_count);
 			a = &g_sarrays[g_sarray_count++]; memset(a, 0, sizeof(*a)); strncpy(a->name, name, sizeof(a->name) - 1);
 		}
 		else if (a->data) {
 			size_t n = 1; for (i = 0; i < a->ndims; i++) n *= (size_t)a->dims[i];
-			for (size_t k = 0; k < n; k++) { if (a->data[k]) free(a->data[k]); }
+			for (size_t k = 0; k < n; k++) bstr_free(&a->data[k]);
 			free(a->data); a->data = NULL;
 		}
 		a->ndims = ndims; for (i = 0; i < ndims; i++) a->dims[i] = dims[i];
-		a->data = (char**)calloc(total, sizeof(char*));
+		a->data = (BasStr*)calloc(total, sizeof(BasStr));
 		if (!a->data) { printf("ERROR: OUT OF MEMORY\n"); return NULL; }
 		return a;
 	}
@@ -157,26 +566,40 @@ int sarray_index(SArray* a, int* subs, int nsubs) {
 	}
 	return (int)idx;
 }
-const char* sarray_get(SArray* a, int* subs, int nsubs) {
+const char* sarray_getn(SArray* a, int* subs, int nsubs, int* len) {
+	int k = sarray_index(a, subs, nsubs);
+	if (k < 0) { printf("ERROR: SUBSCRIPT\n"); *len = 0; return ""; }
+	*len = a->data[k].len;
+	return bstr_ptr(&a->data[k]);
+}
+const char* sarray_get(SArray* a, int* subs, int nsubs) { int n; return sarray_getn(a, subs, nsubs, &n); }
+const BasStr* sarray_at(SArray* a, int* subs, int nsubs) {
+	int k = sarray_index(a, subs, nsubs);
+	if (k < 0) { printf("ERROR: SUBSCRIPT\n"); return NULL; }
+	return &a->data[k];
+}
+void sarray_setn(SArray* a, int* subs, int nsubs, const char* val, int len) {
 	int k = sarray_index(a, subs, nsubs);
-	if (k < 0) { printf("ERROR: SUBSCRIPT\n"); return ""; }
-	return a->data[k] ? a->data[k] : "";
+	if (k < 0) { printf("ERROR: SUBSCRIPT\n"); return; }
+	bstr_set(&a->data[k], val ? val : "", val ? len : 0);   /* val may be this element */
 }
-void sarray_set(SArray* a, int* subs, int nsubs, const char* val) {
+void sarray_set(SArray* a, int* subs, int nsubs, const char* val) { sarray_setn(a, subs, nsubs, val, val ? (int)strlen(val) : 0); }
+void sarray_copy(SArray* a, int* subs, int nsubs, const BasStr* val) {
 	int k = sarray_index(a, subs, nsubs);
 	if (k < 0) { printf("ERROR: SUBSCRIPT\n"); return; }
-	if (a->data[k]) { free(a->data[k]); a->data[k] = NULL; }
-	a->data[k] = strdup_c(val ? val : "");
+	bstr_copy(&a->data[k], val);
 }
 void sarrays_clear(void) {
 	int i; for (i = 0; i < g_sarray_count; i++) {
 		if (g_sarrays[i].data) {
 			size_t n = 1; int d; for (d = 0; d < g_sarrays[i].ndims; d++) n *= (size_t)g_sarrays[i].dims[d];
-			for (size_t k = 0; k < n; k++) if (g_sarrays[i].data[k]) free(g_sarrays[i].data[k]);
+			for (size_t k = 0; k < n; k++) bstr_free(&g_sarrays[i].data[k]);
 			free(g_sarrays[i].data); g_sarrays[i].data = NULL;
 		}
 	}
 	g_sarray_count = 0;
+	symmap_clear(&g_sarray_map);
+	g_var_epoch++;
 }
 
 
@@ -187,10 +610,12 @@ void prog_set_line(int line, const char* text) {
 		if (i >= 0)
 		{
 			free(g_prog[i].text);
+			crunch_free(g_prog[i].code);
 			for (; i < g_prog_count - 1; i++)
 				g_prog[i] = g_prog[i + 1];
 
 			g_prog_count--;
+			g_prog_epoch++;
 		}
 		return;
 	}
@@ -198,6 +623,8 @@ void prog_set_line(int line, const char* text) {
 	{
 		free(g_prog[i].text);
 		g_prog[i].text = strdup_c(text);
+		crunch_free(g_prog[i].code);
+		g_prog[i].code = crunch_line(text);
 	}
 	else
 	{
@@ -209,6 +636,7 @@ void prog_set_line(int line, const char* text) {
 
 		g_prog[g_prog_count].number = line;
 		g_prog[g_prog_count].text = strdup_c(text);
+		g_prog[g_prog_count].code = crunch_line(text);
 		
 		if (!g_prog_head) {
 			g_prog_head = &g_prog[g_prog_count];   // initialize head
@@ -216,6 +644,7 @@ void prog_set_line(int line, const char* text) {
 		g_prog_count++;
 		sort_program();
 	}
+	g_prog_epoch++;
 	data_mark_dirty();
 }
 
@@ -226,8 +655,11 @@ void prog_clear(void)
 	{
 		free(g_prog[i].text);
 		g_prog[i].text = NULL;
+		crunch_free(g_prog[i].code);
+		g_prog[i].code = NULL;
 	}
 	g_prog_count = 0;
+	g_prog_epoch++;
 }
 
 void vars_clear(void) 
@@ -236,11 +668,11 @@ void vars_clear(void)
 	
 	for (i = 0; i < g_var_count; i++) 
 	{ 
-		if (g_vars[i].type == VT_STR && g_vars[i].str) 
-			free(g_vars[i].str); 
-		g_vars[i].str = NULL; 
+		bstr_free(&g_var_str[i]); 
 	} 
 	g_var_count = 0; 
+	symmap_clear(&g_var_map);
+	g_var_epoch++;
 }
 
 void files_clear(void)
@@ -266,94 +698,93 @@ void cmd_list(int startGiven, int start, int endGiven, int end) {
 }
 
 /* Execute multiple statements on one physical line.
-   Split on ':' or '\' unless inside a quoted string. */
+   The line is crunched like a stored program line (split on ':' or '\' outside
+   quotes), so immediate statements replay the same token stream as RUN. */
 
 static int exec_multi(const char* src, int duringRun, int currentLine, int* outJump) {
-	const char* p = src;
-	int result = 0;
-
-	while (*p) {
-		// skip leading spaces/tabs
-		while (*p && isspace((unsigned char)*p))
-			p++;
-
-		// mark start of this sub-statement
-		const char* stmt_start = p;
-
-		// find next ':' or '\' separator (not inside quotes)
-		int in_str = 0;
-		while (*p) {
-			if (*p == '"' && (p == stmt_start || *(p - 1) != '\\'))
-				in_str = !in_str;
-			if (!in_str && (*p == ':' || *p == '\\'))
-				break;
-			p++;
-		}
-
-		// copy this sub-statement into buffer
-		size_t len = p - stmt_start;
-		if (len > 0) {
-			char buf[1024];
-			if (len >= sizeof(buf)) len = sizeof(buf) - 1;
-			memcpy(buf, stmt_start, len);
-			buf[len] = '\0';
+	CrunchLine* cl = crunch_line(src);
+	int result = 0, k;
+
+	if (!cl) return -1;
+	g_pc_index = -1;   /* immediate statements have no PC */
+	for (k = 0; k < cl->nseg; k++) {
+		Lexer lx;
+		g_pc_seg = k;
+		lx_init_crunched(&lx, cl, k);
+		lx_next(&lx);
+		result = exec_statement_lx(&lx, duringRun, currentLine, outJump);
+		if (result != 0) break;  // stop on jump/quit
+	}
+	crunch_free(cl);
+	return result;
+}
 
-			int r = exec_statement(buf, duringRun, currentLine, outJump);
-			if (r != 0) { // stop on jump/quit
-				result = r;
-				break;
-			}
+/* Execute the statements of a stored line, from statement 'from', from its crunched
+   token stream. Same contract as exec_multi, but nothing is re-lexed or copied. */
+static int exec_crunched(const CrunchLine* cl, int from, int duringRun, int currentLine, int* outJump) {
+	unsigned epoch = g_prog_epoch;
+	int s;
+
+	for (s = from; s < cl->nrun; s++) {
+		int r;
+		g_pc_seg = s;
+		if (cl->segs[s].stmt) {
+			r = stmt_exec(cl->segs[s].stmt, cl, s, currentLine, outJump);
 		}
-
-		// if separator found, skip it and loop for next statement
-		if (*p == ':' || *p == '\\') {
-			p++;
-			continue;
+		else {
+			Lexer lx;
+			lx_init_crunched(&lx, cl, s);
+			lx_next(&lx);
+			r = exec_statement_lx(&lx, duringRun, currentLine, outJump);
 		}
-
-		// otherwise, end of line
-		break;
+		if (r != 0) return r;              /* stop on jump/quit */
+		if (g_prog_epoch != epoch) break;  /* NEW/LOAD freed this line */
 	}
-
-	return result;
+	return 0;
 }
 
+#ifndef CLINTER_RTLIB   /* rtlib build: generated C code (--emit-c) provides main */
 /* --------- Runner --------- */
-static void run_program(void) {
-	int pcIndex = 0;
+static void run_lines(void) {
+	int pcIndex = 0, pcSeg = 0;   /* next statement to run */
 
 	if (g_prog_count <= 0) {
 		printf("NO PROGRAM\n");
 		return;
 	}
 
-	sort_program();
+	prog_link();
+	if (g_engine != ENGINE_TIERED) prog_compile();   /* tiered: compiled per line once hot */
+	if (g_engine == ENGINE_VM || g_engine == ENGINE_JIT) vm_compile_program();
+	if (g_profile) prof_begin();
+	else if (g_engine == ENGINE_TIERED) prof_apply();   /* hot lines from the last --profile RUN */
 	g_for_top = 0;
 	g_gosub_top = 0;
 
+	pcIndex = prog_run_from(0);
 	while (pcIndex < g_prog_count) {
 		int curLine = g_prog[pcIndex].number;
 		const char* src = g_prog[pcIndex].text;
 		int code, jump = 0;
 
 		{
-			if (g_trace) printf("[TRACE] %d %s\n", curLine, src);
-
-			char tmp[MAX_LINE_LEN];
-			strncpy(tmp, src, sizeof(tmp) - 1);
-			tmp[sizeof(tmp) - 1] = 0; trim(tmp);
+			CrunchLine* cl = g_prog[pcIndex].code;
 
-			if (tmp[0] == 0) { pcIndex++; continue; }
-
-			{   /* skip REM lines */
-				Lexer lx; lx_init(&lx, tmp); lx_next(&lx);
-				if (lx.cur.type == T_REM) { pcIndex++; continue; }
-			}
+			if (g_trace) printf("[TRACE] %d %s\n", curLine, src);
+			if (g_profile) prof_line(pcIndex);
+
+			/* REM, DATA and blank lines; only reached while TRACE shows them or the
+			   program changed under RUN, otherwise prog_run_from steps over them */
+			if (!cl || cl->nrun == 0) { pcIndex++; pcSeg = 0; continue; }
+
+			/* --- execute this line (can run multiple : or \ segments) --- */
+			g_pc_index = pcIndex;
+			if (g_engine == ENGINE_TIERED) vm_tier_line(cl);
+			if (g_engine != ENGINE_TREE && cl->vm) code = vm_exec_line(cl, pcSeg, curLine, &jump);
+			else code = exec_crunched(cl, pcSeg, 1, curLine, &jump);
+			pcSeg = 0;
 		}
 
-		/* --- execute this line (can run multiple : or \ segments) --- */
-		code = exec_multi(src, 1, curLine, &jump);
-
 		/* --- Ctrl+C pressed during this line? break and report line --- */
 		if (g_ctrlc_pressed) {
 			g_ctrlc_pressed = 0;            /* reset the flag for next run */
@@ -366,12 +797,63 @@ static void run_program(void) {
 		else if (code == 1) {
 			int idx = find_prog_index_by_line(jump);
 			if (idx < 0) { printf("ERROR: Undefined line %d\n", jump); return; }
-			pcIndex = idx;
+			pcIndex = prog_run_from(idx);
+		}
+		else if (code == 3) {   /* NEXT / RETURN: resume at a statement, no lookup */
+			int idx = PC_INDEX(jump);
+			if (idx >= g_prog_count) return;
+			/* a FOR loop that just turned hot: promote its body while it runs */
+			if (g_engine == ENGINE_TIERED && g_for_top > 0 && idx <= pcIndex
+				&& g_for_stack[g_for_top - 1].trips == TIER_LOOP_HOT && g_for_stack[g_for_top - 1].body == jump)
+				vm_tier_loop(idx, pcIndex);
+			pcSeg = PC_SEG(jump);
+			pcIndex = pcSeg ? idx : prog_run_from(idx);
 		}
 		else {
-			pcIndex++;
+			pcIndex = prog_run_from(pcIndex + 1);
+		}
+	}
+}
+
+/* --bench-lex: scan identifier-heavy lines with lx_next (keywords, variables, calls) */
+static int bench_lex(void) {
+	static const char* const lines[] = {
+		"FOR INDEX = START TO FINISH STEP DELTA",
+		"TOTAL = TOTAL + PRICE * QUANTITY - DISCOUNT / RATE",
+		"IF COUNTER > LIMIT AND FLAG = 0 THEN GOSUB 1000 ELSE RESULT = ALPHA OR BETA",
+		"PRINT NAME$; TAB(COLUMN); SCORE, AVERAGE; LEFT$(TITLE$, WIDTH)",
+		"LET X1 = SQR(DX * DX + DY * DY): Y1 = ATN(DY / DX): NEXT INDEX",
+		"DIM MATRIX(ROWS, COLS): READ ROWS, COLS: RESTORE: RETURN",
+	};
+	const int nlines = (int)(sizeof(lines) / sizeof(lines[0]));
+	const int iters = 200000;
+	unsigned long ntok = 0, nident = 0;
+	clock_t t0;
+	double secs;
+	int i, k;
+
+	if (lx_kw_selftest() < 0) return 1;
+	t0 = clock();
+	for (i = 0; i < iters; i++) {
+		for (k = 0; k < nlines; k++) {
+			Lexer lx;
+			lx_init(&lx, lines[k]);
+			for (lx_next(&lx); lx.cur.type != T_END; lx_next(&lx)) {
+				ntok++;
+				if (lx.cur.type == T_IDENT) nident++;
+			}
 		}
 	}
+	secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+	printf("lx_next: %lu tokens (%lu identifiers) in %.3f s, %.1f ns/token\n",
+		ntok, nident, secs, ntok ? secs * 1e9 / (double)ntok : 0.0);
+	return 0;
+}
+
+static void run_program(void) {
+	run_lines();
+	if (g_vm_opstats) vm_opstats_report();
+	if (g_profile && g_prog_count > 0) prof_write();
 }
 
 
@@ -389,6 +871,7 @@ static int starts_with_kw(const char* s, const char* kw)
 	
 	return 1; 
 }
+#endif
 
 int prog_load(const char* filename) {
 	FILE* fp = fopen(filename, "r");
@@ -410,9 +893,11 @@ int prog_load(const char* filename) {
 			prog_set_line(ln, (*p ? p : NULL));
 	}
 	fclose(fp);
+	prof_source(filename);
 	return 1;
 }
 
+#ifndef CLINTER_RTLIB
 int main(int argc, char* argv[])
 {
 	/* Install Ctrl+C (SIGINT) handler */
@@ -433,12 +918,38 @@ int main(int argc, char* argv[])
 	char line[MAX_LINE_LEN];
 	memset(g_files, 0, sizeof(g_files));
 
-	/* ---- command-line args: [-T|--trace] [program.bas] ---- */
+	/* ---- command-line args: [-T|--trace] [--engine=tree|vm|jit|tiered] [--opstats] [--profile] [--emit-c] [--bench-lex] [program.bas] ---- */
 	int autorun = 0;
+	int emitc = 0;
+	const char* progFile = NULL;
 	for (int i = 1; i < argc; i++) {
 		if (strcmp(argv[i], "-T") == 0 || strcmp(argv[i], "--trace") == 0) {
 			g_trace = 1;                       /* TRACE ON at startup */
 		}
+		else if (strncmp(argv[i], "--engine=", 9) == 0) {
+			if (strcmp(argv[i] + 9, "tree") == 0) g_engine = ENGINE_TREE;
+			else if (strcmp(argv[i] + 9, "vm") == 0) g_engine = ENGINE_VM;
+			else if (strcmp(argv[i] + 9, "jit") == 0) g_engine = ENGINE_JIT;
+			else if (strcmp(argv[i] + 9, "tiered") == 0) g_engine = ENGINE_TIERED;
+			else {
+				printf("ERROR: Unknown engine '%s' (use tree, vm, jit or tiered)\n", argv[i] + 9);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--opstats") == 0) {
+			g_vm_opstats = 1;                  /* opcode pair counts after each RUN */
+			g_engine = ENGINE_VM;
+		}
+		else if (strcmp(argv[i], "--profile") == 0) {
+			g_profile = 1;                     /* write program.prof after each RUN */
+			g_engine = ENGINE_TREE;
+		}
+		else if (strcmp(argv[i], "--bench-lex") == 0) {
+			return bench_lex();                /* lexer microbenchmark */
+		}
+		else if (strcmp(argv[i], "--emit-c") == 0) {
+			emitc = 1;                         /* write program.c instead of running */
+		}
 		else {
 			/* treat as a filename to load */
 			if (!prog_load(argv[i])) {
@@ -446,9 +957,26 @@ int main(int argc, char* argv[])
 				return 1;
 			}
 			autorun = 1;                       /* auto-run after banner */
+			progFile = argv[i];
 		}
 	}
 
+	/* ---- translate to C and exit ---- */
+	if (emitc) {
+		char out[MAX_LINE_LEN];
+		const char* dot;
+		if (!progFile) {
+			printf("ERROR: --emit-c needs a program file\n");
+			return 1;
+		}
+		dot = strrchr(progFile, '.');
+		if (!dot || strpbrk(dot, "/\\")) dot = progFile + strlen(progFile);
+		snprintf(out, sizeof(out), "%.*s.c", (int)(dot - progFile), progFile);
+		if (emit_c_program(progFile, out) < 0) return 1;
+		printf("Wrote %s\n", out);
+		return 0;
+	}
+
 	/* ---- banner ---- */
 	if (autorun == 0)
 	{
@@ -525,3 +1053,4 @@ int main(int argc, char* argv[])
 	files_clear();
 	return 0;
 }
+#endif
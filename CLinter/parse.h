@@ -9,10 +9,57 @@ extern "C" {
 
 void lx_init(Lexer *lx, const char *s);
 
+void lx_init_crunched(Lexer *lx, const CrunchLine *cl, int seg);
+
 void lx_next(Lexer *lx);
 
+/* the crunched token record of the current identifier, NULL when scanning raw text */
+CrunchTok *lx_site(const Lexer *lx);
+
+/* keyword hash table check (--bench-lex); 0 = ok */
+int lx_kw_selftest(void);
+
 double parse_rel(Lexer *lx);
 
+/* parse_rel keeping an integer value exact: 1 with it in *iv, or 0 with the number in *dv */
+int parse_int(Lexer *lx, BasInt *iv, double *dv);
+
+/* ---- Typed expression values ----
+   parse_value evaluates any expression to a number or a string; parse_rel is parse_value
+   taken as a number. A string's bytes are s[0..len) with a NUL at s[len]; they point into
+   the token text, a variable or an array element (valid until that is assigned) or into
+   'own', which val_free releases. When they are a whole stored string, 'src' is that
+   string, so an assignment can share its buffer instead of copying the bytes.
+   A number with 'isint' set is exact in 'inum' (num holds it as a double too): integer
+   variables and elements, whole literals, MOD / IDIV / NOT, and + - * of those until a
+   result overflows, which then widens to a double (compile.cpp's node_ieval). */
+typedef struct { int str; double num; const char *s; int len; char *own; const BasStr *src;
+                 int isint; BasInt inum; } Value;
+
+void parse_value(Lexer *lx, Value *v);
+void val_free(Value *v);
+double val_num(const Value *v);          /* a string's atof */
+const char *val_text(Value *v);          /* make v a string (an integer becomes its %lld text, a number its %.15g) */
+int str_compare(const char *a, int al, const char *b, int bl);   /* memcmp order, shorter first */
+
+/* String builtins: SEG$ / MID$ (s$, start[, len]), LEFT$ / RIGHT$ (s$, n), TRM$ (s$) keep the
+   span str_span returns; VAL, LEN and ASC read the whole operand. */
+typedef enum { SF_VAL, SF_LEN, SF_ASC, SF_SEG, SF_MID, SF_LEFT, SF_RIGHT, SF_TRM } StrFn;
+int str_span(int fn, const char *s, int sl, double a, double b, int *off);
+
+/* ---- Builtin functions (parse_factor) ----
+   The handler is called with the function name as the current token, parses its own
+   argument list and returns the value (string-valued functions coerce with atof, as in
+   any numeric context; parse_value calls the string form of the built-in ones). nargs -1 = optional/variable. The statement compiler binds
+   the numeric builtins it knows directly (compile.cpp) and leaves every other
+   registered name to this table. */
+typedef enum { BI_NUM, BI_STR } BuiltinType;
+typedef double (*BuiltinFn)(Lexer *lx);
+typedef struct { const char *name; int nargs; BuiltinType ret; BuiltinFn fn; } Builtin;
+
+int builtin_register(const char *name, int nargs, BuiltinType ret, BuiltinFn fn);  /* add or replace; 0 = ok */
+const Builtin *builtin_find(const char *name);                                    /* case-insensitive; NULL = not a builtin */
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,6 +15,37 @@ extern "C" {
    Returns 0 on success, -1 on error. */
 int exec_print(Lexer* lx);
 
+/* One PRINT item is built into a byte buffer (binary-safe, truncated at cap). */
+#define PRINT_ITEM_MAX 4096
+
+typedef struct {
+    unsigned char* data;
+    size_t len;
+    size_t cap;
+} ByteBuf;
+
+void bb_init(ByteBuf* b, unsigned char* storage, size_t cap);
+void bb_putc(ByteBuf* b, unsigned char ch);
+void bb_append(ByteBuf* b, const void* src, size_t n);
+void bb_append_cstr(ByteBuf* b, const char* s);
+void bb_append_num(ByteBuf* b, double v);                          /* %.15g */
+void bb_append_int(ByteBuf* b, BasInt v);                          /* %lld: an exact integer */
+void bb_append_chr(ByteBuf* b, double v);                          /* CHR$ */
+void bb_append_seg(ByteBuf* b, const char* s, int sl, int start, int len); /* SEG$ of sl bytes */
+void bb_append_trm(ByteBuf* b, const char* s, int sl);                     /* TRM$ */
+
+/* Output side of PRINT, shared with the compiled engines. */
+typedef struct {
+    FILE* out;
+    int suppress_nl;   /* last thing printed was ';' or ',' */
+} PrintState;
+
+int  print_begin(PrintState* ps, int handle);   /* handle < 0: console; -1 on bad handle */
+void print_emit(PrintState* ps, const ByteBuf* item);
+void print_tab(PrintState* ps, int n);          /* TAB(n), 1-based column */
+void print_zone(PrintState* ps);                /* ',' separator */
+void print_end(PrintState* ps);                 /* newline unless suppressed */
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,161 @@
+/* profile.cpp - persisted run profiles (--profile)
+   File format, one record per line:
+     CLINTER-PROFILE 1 <program hash> <line count>
+     LINE <number> <executions>
+     BRANCH <line> <segment> <n> <taken> <not taken>   n-th IF in the segment, pre-order
+     VAR <name> NUM|STR|INT
+     ARRAY <name> <dim1> [<dim2> ...]
+   The hash covers every line number and text, so a profile of an edited program is
+   ignored rather than applied to the wrong lines. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "runtime.h"
+#include "compile.h"
+#include "vm.h"
+#include "profile.h"
+
+int g_profile = 0;
+
+static char g_prof_path[260];        /* <program>.prof, empty = no program file */
+static unsigned long* g_prof_hits;   /* per g_prog index during a profiling RUN */
+static int g_prof_nhits;
+static unsigned g_prof_epoch;        /* g_prog_epoch the counters belong to */
+
+void prof_source(const char* basPath) {
+    const char* dot;
+    g_prof_path[0] = 0;
+    if (!basPath || !basPath[0]) return;
+    dot = strrchr(basPath, '.');
+    if (!dot || strpbrk(dot, "/\\")) dot = basPath + strlen(basPath);
+    snprintf(g_prof_path, sizeof(g_prof_path), "%.*s.prof", (int)(dot - basPath), basPath);
+}
+
+static unsigned long prog_hash(void) {
+    unsigned long h = 2166136261UL;
+    int i;
+    for (i = 0; i < g_prog_count; i++) {
+        const char* p = g_prog[i].text;
+        h = (h ^ (unsigned long)g_prog[i].number) * 16777619UL;
+        for (; p && *p; p++) h = ((h ^ (unsigned char)*p) * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return h;
+}
+
+/* ---------- recording ---------- */
+static void stmt_reset(Stmt* s) {
+    if (!s) return;
+    s->taken = s->not_taken = 0;
+    stmt_reset(s->then_s);
+    stmt_reset(s->else_s);
+}
+
+void prof_begin(void) {
+    int i, k;
+    free(g_prof_hits);
+    g_prof_hits = (unsigned long*)calloc((size_t)(g_prog_count ? g_prog_count : 1), sizeof(unsigned long));
+    g_prof_nhits = g_prof_hits ? g_prog_count : 0;
+    g_prof_epoch = g_prog_epoch;
+    for (i = 0; i < g_prog_count; i++) {
+        const CrunchLine* cl = g_prog[i].code;
+        if (!cl) continue;
+        for (k = 0; k < cl->nseg; k++) stmt_reset(cl->segs[k].stmt);
+    }
+}
+
+void prof_line(int pcIndex) {
+    if (g_prof_epoch == g_prog_epoch && pcIndex < g_prof_nhits) g_prof_hits[pcIndex]++;
+}
+
+static void write_branches(FILE* f, int line, int seg, const Stmt* s, int* n) {
+    if (!s) return;
+    if (s->kind == S_IF) {
+        if (s->taken || s->not_taken) fprintf(f, "BRANCH %d %d %d %lu %lu\n", line, seg, *n, s->taken, s->not_taken);
+        (*n)++;
+    }
+    write_branches(f, line, seg, s->then_s, n);
+    write_branches(f, line, seg, s->else_s, n);
+}
+
+void prof_write(void) {
+    FILE* f;
+    int i, k, d;
+
+    if (!g_prof_path[0]) { printf("ERROR: --profile needs a program loaded from a file\n"); return; }
+    if (g_prof_epoch != g_prog_epoch) { printf("ERROR: program changed during RUN, profile not written\n"); return; }
+    f = fopen(g_prof_path, "w");
+    if (!f) { printf("ERROR: cannot write file %s\n", g_prof_path); return; }
+
+    fprintf(f, "CLINTER-PROFILE 1 %lu %d\n", prog_hash(), g_prog_count);
+    for (i = 0; i < g_prof_nhits; i++)
+        if (g_prof_hits[i]) fprintf(f, "LINE %d %lu\n", g_prog[i].number, g_prof_hits[i]);
+    for (i = 0; i < g_prog_count; i++) {
+        const CrunchLine* cl = g_prog[i].code;
+        if (!cl) continue;
+        for (k = 0; k < cl->nseg; k++) { int n = 0; write_branches(f, g_prog[i].number, k, cl->segs[k].stmt, &n); }
+    }
+    for (i = 0; i < g_var_count; i++)
+        fprintf(f, "VAR %s %s\n", g_var_name[i], g_var_type[i] == VT_STR ? "STR" : g_var_type[i] == VT_INT ? "INT" : "NUM");
+    for (i = 0; i < g_array_count; i++) {
+        fprintf(f, "ARRAY %s", g_arrays[i].name);
+        for (d = 0; d < g_arrays[i].ndims; d++) fprintf(f, " %d", g_arrays[i].dims[d]);
+        fprintf(f, "\n");
+    }
+    fclose(f);
+}
+
+/* ---------- applying ---------- */
+#define PROF_MAX_STR 64
+
+/* a hot line reading a variable that held a string would make the JIT decline on every
+   execution, so such lines stay on the VM */
+static int jit_safe(const VmChunk* ch, char (*str)[32], int nstr) {
+    int i, j;
+    for (i = 0; i < ch->nref; i++)
+        for (j = 0; j < nstr; j++)
+            if (!_stricmp(ch->refs[i].name, str[j])) return 0;
+    return 1;
+}
+
+void prof_apply(void) {
+    FILE* f;
+    char kw[16], name[32], (*str)[32];
+    unsigned long hash, hits;
+    int nlines, line, nstr = 0, i;
+
+    if (!g_prof_path[0]) return;
+    f = fopen(g_prof_path, "r");
+    if (!f) return;
+    if (fscanf(f, "CLINTER-PROFILE 1 %lu %d", &hash, &nlines) != 2 || hash != prog_hash() || nlines != g_prog_count) {
+        fclose(f);
+        return;
+    }
+
+    /* variable types first: they decide how far hot lines are promoted */
+    str = (char(*)[32])calloc(PROF_MAX_STR, sizeof(*str));
+    if (!str) { fclose(f); return; }
+    while (fscanf(f, "%15s", kw) == 1) {
+        if (!strcmp(kw, "VAR") && fscanf(f, "%31s %15s", name, kw) == 2) {
+            if (!strcmp(kw, "STR") && !is_string_var_name(name) && nstr < PROF_MAX_STR) strcpy(str[nstr++], name);
+        }
+        else { int c; while ((c = fgetc(f)) != EOF && c != '\n') {} }
+    }
+
+    rewind(f);
+    { int c; while ((c = fgetc(f)) != EOF && c != '\n') {} }
+    while (fscanf(f, "%15s", kw) == 1) {
+        if (!strcmp(kw, "LINE") && fscanf(f, "%d %lu", &line, &hits) == 2 && hits >= TIER_VM_HOT) {
+            i = find_prog_index_by_line(line);
+            if (i >= 0 && g_prog[i].code && g_prog[i].code->hits < TIER_JIT_HOT) {
+                CrunchLine* cl = g_prog[i].code;
+                vm_tier_preset(cl, 0);
+                if (hits >= TIER_JIT_HOT && cl->vm && jit_safe(cl->vm, str, nstr)) vm_tier_preset(cl, 1);
+            }
+        }
+        { int c; while ((c = fgetc(f)) != EOF && c != '\n') {} }
+    }
+    free(str);
+    fclose(f);
+}
@@ -0,0 +1,26 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+#include "runtime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ---- Run profiles (--profile) ----
+   A profiling RUN counts line executions and IF outcomes on the tree engine and
+   then writes <program>.prof next to the loaded .bas file: hot lines, the type each
+   variable ended up with, array shapes and the taken ratio of every compiled IF.
+   A later tiered RUN of the same program text reads that file and promotes the hot
+   lines before the first statement executes instead of warming them up again. */
+extern int g_profile;
+
+void prof_source(const char* basPath);   /* program file the profile belongs to (NULL = none) */
+void prof_begin(void);                   /* start of a profiling RUN */
+void prof_line(int pcIndex);             /* one execution of g_prog[pcIndex] */
+void prof_write(void);                   /* end of a profiling RUN */
+void prof_apply(void);                   /* start of a tiered RUN: pre-promote hot lines */
+
+#ifdef __cplusplus
+}
+#endif
+#endif
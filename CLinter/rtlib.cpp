@@ -0,0 +1,344 @@
+/* rtlib.cpp - runtime entry points for programs translated with --emit-c
+   - rt_init loads the program text into g_prog, so DATA, line lookups and the
+     statements left to the interpreter behave exactly as under RUN.
+   - FOR frames live here because their loop variable may be a plain C double in the
+     generated code; GOSUB uses the interpreter's stack.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <limits.h>
+
+#include "runtime.h"
+#include "parse.h"
+#include "wxecut.h"
+#include "printfunc.h"
+#include "compile.h"
+#include "rtlib.h"
+
+typedef struct {
+    char name[32];
+    double* var;       /* NULL: integer loop over ivar */
+    double end;
+    double step;
+    int body;          /* PC of the statement after FOR */
+    BasInt* ivar;
+    BasInt iend, istep;
+} RtFor;
+
+static RtFor g_rt_for[MAX_STACK];
+static int g_rt_for_top = 0;
+
+static PrintState g_rt_ps;
+static unsigned char g_rt_store[PRINT_ITEM_MAX];
+static ByteBuf g_rt_item;
+
+void rt_init(const RtLine* lines, int n) {
+    int i;
+    setlocale(LC_ALL, "");
+    memset(g_files, 0, sizeof(g_files));
+    for (i = 0; i < n; i++) prog_set_line(lines[i].line, lines[i].text);
+    sort_program();
+    prog_link();
+    g_for_top = 0;
+    g_gosub_top = 0;
+}
+
+int rt_exit(void) {
+    fflush(stdout);
+    return 0;
+}
+
+/* ---------- interpreter hand-off ---------- */
+static const CrunchLine* rt_line(int line) {
+    int i = find_prog_index_by_line(line);
+    return i >= 0 ? g_prog[i].code : NULL;
+}
+
+int rt_seg(int line, int seg, int* jump) {
+    const CrunchLine* cl = rt_line(line);
+    Lexer lx;
+    if (!cl || seg >= cl->nseg) return 0;
+    g_pc_index = find_prog_index_by_line(line);
+    g_pc_seg = seg;
+    lx_init_crunched(&lx, cl, seg);
+    lx_next(&lx);
+    return exec_statement_lx(&lx, 1, line, jump);
+}
+
+int rt_branch(int line, int seg, int tok, int* jump) {
+    const CrunchLine* cl = rt_line(line);
+    Lexer lx;
+    if (!cl || seg >= cl->nseg) return 0;
+    g_pc_index = find_prog_index_by_line(line);
+    g_pc_seg = seg;
+    lx_init_crunched(&lx, cl, seg);
+    lx.tk = cl->toks + tok;
+    lx_next(&lx);
+    return run_if_single_stmt(&lx, line, jump);
+}
+
+unsigned rt_epoch(void) { return g_var_epoch; }
+
+double* rt_num(const char* name) {
+    int v = ensure_var(name, 0);
+    if (v < 0) { printf("ERROR: VARIABLE TABLE FULL\n"); exit(1); }
+    return &g_var_num[v];
+}
+
+BasInt* rt_int(const char* name) {
+    int v = ensure_var(name, 0);
+    if (v < 0) { printf("ERROR: VARIABLE TABLE FULL\n"); exit(1); }
+    return &g_var_int[v];
+}
+
+int rt_ilet(BasInt* var, double val) { return num_to_int(val, var); }
+
+/* ---------- integer expressions (as compile.cpp's node_ieval) ---------- */
+static RtInt rt_wide(double d) { RtInt r; r.i = 0; r.d = d; r.exact = 0; return r; }
+static BasInt rt_iarg(RtInt a) { return a.exact ? a.i : num_trunc(a.d); }
+
+RtInt rt_ival(BasInt i) { RtInt r; r.i = i; r.d = (double)i; r.exact = 1; return r; }
+RtInt rt_itrunc(double v) { return rt_ival(num_trunc(v)); }
+RtInt rt_ineg(RtInt a) { return a.exact && a.i != LLONG_MIN ? rt_ival(-a.i) : rt_wide(-a.d); }
+RtInt rt_iadd(RtInt a, RtInt b) { BasInt r; return a.exact && b.exact && int_add(a.i, b.i, &r) ? rt_ival(r) : rt_wide(a.d + b.d); }
+RtInt rt_isub(RtInt a, RtInt b) { BasInt r; return a.exact && b.exact && int_sub(a.i, b.i, &r) ? rt_ival(r) : rt_wide(a.d - b.d); }
+RtInt rt_imul(RtInt a, RtInt b) { BasInt r; return a.exact && b.exact && int_mul(a.i, b.i, &r) ? rt_ival(r) : rt_wide(a.d * b.d); }
+RtInt rt_inot(RtInt a) { return rt_ival(~rt_iarg(a)); }
+
+RtInt rt_imod(RtInt a, RtInt b) {
+    BasInt r;
+    int_mod(rt_iarg(a), rt_iarg(b), &r);
+    return rt_ival(r);
+}
+
+RtInt rt_iidiv(RtInt a, RtInt b) {
+    BasInt x = rt_iarg(a), y = rt_iarg(b), r;
+    return int_idiv(x, y, &r) ? rt_ival(r) : rt_wide((double)x / (double)y);
+}
+
+int rt_iset(BasInt* var, RtInt v) {
+    if (v.exact) { *var = v.i; return 0; }
+    return num_to_int(v.d, var);
+}
+
+double rt_sval(const char* name) {
+    return var_value(find_var(name));
+}
+
+/* ---------- control flow ---------- */
+/* same checks and frame handling as for_push / for_next (wxecut.cpp) */
+static RtFor* rt_for_frame(const char* name, int line, int seg) {
+    int body = prog_pc_after(find_prog_index_by_line(line), seg);
+    RtFor* fr;
+    if (body < 0) { printf("ERROR: FOR cannot be last line\n"); return NULL; }
+    if (g_rt_for_top >= MAX_STACK) { printf("ERROR: FOR stack overflow\n"); return NULL; }
+    fr = &g_rt_for[g_rt_for_top];
+    memset(fr, 0, sizeof(*fr));
+    strncpy(fr->name, name, sizeof(fr->name) - 1);
+    fr->body = body;
+    return fr;
+}
+
+int rt_for(const char* name, double* var, double start, double to, double step, int line, int seg) {
+    RtFor* fr;
+    *var = start;
+    if (!(fr = rt_for_frame(name, line, seg))) return -1;
+    fr->var = var;
+    fr->end = to;
+    fr->step = step;
+    g_rt_for_top++;
+    return 0;
+}
+
+int rt_ifor(const char* name, BasInt* var, double start, double to, double step, int line, int seg) {
+    RtFor* fr;
+    if (num_to_int(start, var) < 0) return -1;
+    if (!(fr = rt_for_frame(name, line, seg))) return -1;
+    fr->ivar = var;
+    if (for_int_bounds(to, step, &fr->iend, &fr->istep) < 0) return -1;
+    g_rt_for_top++;
+    return 0;
+}
+
+int rt_next(const char* name, int* jump) {
+    int idx = g_rt_for_top - 1;
+    RtFor* fr;
+    double cur;
+    if (name) {
+        int k;
+        for (k = g_rt_for_top - 1; k >= 0; k--) { if (_stricmp(g_rt_for[k].name, name) == 0) { idx = k; break; } }
+        if (k < 0) { printf("ERROR: NEXT for unknown FOR var\n"); return -1; }
+    }
+    if (idx < 0) { printf("ERROR: NEXT without FOR\n"); return -1; }
+    fr = &g_rt_for[idx];
+    if (fr->ivar) {
+        int r = for_int_next(fr->ivar, fr->iend, fr->istep);
+        if (r < 0) return -1;
+        if (r) { *jump = fr->body; return 3; }
+    }
+    else {
+        cur = *fr->var + fr->step;
+        *fr->var = cur;
+        if (fr->step >= 0 ? cur <= fr->end : cur >= fr->end) { *jump = fr->body; return 3; }
+    }
+    memmove(&g_rt_for[idx], &g_rt_for[idx + 1], (size_t)(g_rt_for_top - 1 - idx) * sizeof(RtFor));
+    g_rt_for_top--;
+    return 0;
+}
+
+int rt_gosub(int line, int seg) {
+    g_pc_index = find_prog_index_by_line(line);
+    g_pc_seg = seg;
+    return gosub_push(line);
+}
+
+int rt_return(int* jump) { return gosub_return(jump); }
+
+void rt_undefined(int line) { printf("ERROR: Undefined line %d\n", line); }
+
+void rt_trace(int line) {
+    int i = find_prog_index_by_line(line);
+    if (g_trace && i >= 0) printf("[TRACE] %d %s\n", line, g_prog[i].text);
+}
+
+/* ---------- arrays, DATA, files ---------- */
+static void rt_subs(int* subs, int n, const double* d) {
+    int i;
+    for (i = 0; i < n; i++) subs[i] = (int)d[i];
+}
+
+static Array* rt_arr(RtArr* c, const char* name) {
+    if (!c->a || c->epoch != g_var_epoch) { c->a = array_find(name); c->epoch = g_var_epoch; }
+    return (Array*)c->a;
+}
+
+double rt_aget(RtArr* c, const char* name, int n, const double* subs) {
+    int s[MAX_DIMS];
+    Array* a = rt_arr(c, name);
+    rt_subs(s, n, subs);
+    if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return 0.0; }
+    return array_get(a, s, n);
+}
+
+int rt_aset(RtArr* c, const char* name, int n, const double* subs, double val) {
+    int s[MAX_DIMS];
+    Array* a = rt_arr(c, name);
+    rt_subs(s, n, subs);
+    if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
+    array_set(a, s, n, val);
+    return 0;
+}
+
+RtInt rt_iaget(RtArr* c, const char* name, int n, const double* subs) {
+    int s[MAX_DIMS], k;
+    Array* a = rt_arr(c, name);
+    rt_subs(s, n, subs);
+    if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return rt_wide(0.0); }
+    if (a->idata && (k = array_index(a, s, n)) >= 0) return rt_ival(a->idata[k]);
+    return rt_wide(array_get(a, s, n));
+}
+
+int rt_iaset(RtArr* c, const char* name, int n, const double* subs, RtInt val) {
+    int s[MAX_DIMS];
+    Array* a = rt_arr(c, name);
+    rt_subs(s, n, subs);
+    if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
+    if (val.exact) array_set_int(a, s, n, val.i);
+    else array_set(a, s, n, val.d);
+    return 0;
+}
+
+int rt_dim(const char* name, int n, const double* subs) {
+    int s[MAX_DIMS];
+    rt_subs(s, n, subs);
+    return dim_array(name, n, s);
+}
+
+void rt_read_begin(void) { data_maybe_rebuild(); }
+
+int rt_read(const char* name, int n, const double* subs) {
+    int s[MAX_DIMS];
+    if (n > 0) rt_subs(s, n, subs);
+    return read_into(name, s, n);
+}
+
+void rt_restore(int line) { restore_data(line); }
+int  rt_open(const char* name, int mode, int handle) { return open_file(name, mode, handle); }
+void rt_close(int handle) { close_file(handle); }
+
+/* ---------- PRINT ---------- */
+static const char* rt_str(const char* name, int* len) {
+    return var_strn(find_var(name), len);
+}
+
+int  rt_print_begin(int handle) { return print_begin(&g_rt_ps, handle); }
+void rt_item_begin(void) { bb_init(&g_rt_item, g_rt_store, sizeof(g_rt_store)); }
+void rt_part_num(double v) { bb_append_num(&g_rt_item, v); }
+void rt_part_int(RtInt v) { if (v.exact) bb_append_int(&g_rt_item, v.i); else bb_append_num(&g_rt_item, v.d); }
+void rt_part_str(const char* s) { bb_append_cstr(&g_rt_item, s); }
+void rt_part_svar(const char* name) { int sl; const char* s = rt_str(name, &sl); bb_append(&g_rt_item, s, (size_t)sl); }
+
+void rt_part_sarr(const char* name, int n, const double* subs) {
+    int s[MAX_DIMS], sl;
+    SArray* sa = sarray_find(name);
+    const char* p;
+    rt_subs(s, n, subs);
+    if (sa) { p = sarray_getn(sa, s, n, &sl); bb_append(&g_rt_item, p, (size_t)sl); }
+}
+
+void rt_part_chr(double v) { bb_append_chr(&g_rt_item, v); }
+
+/* a PRINT part's SEG$ / TRM$ source: literal s or string variable s */
+static const char* rt_part_src(const char* s, int isVar, int* len) {
+    if (!s) { *len = 0; return ""; }
+    if (isVar) return rt_str(s, len);
+    *len = (int)strlen(s);
+    return s;
+}
+
+void rt_part_seg(const char* s, int isVar, int hasStart, double start, int hasLen, double len) {
+    int sl;
+    const char* src = rt_part_src(s, isVar, &sl);
+    bb_append_seg(&g_rt_item, src, sl, hasStart ? (int)start : 1, hasLen ? (int)len : 0);
+}
+
+void rt_part_trm(const char* s, int isVar) { int sl; const char* src = rt_part_src(s, isVar, &sl); bb_append_trm(&g_rt_item, src, sl); }
+void rt_item_end(void) { print_emit(&g_rt_ps, &g_rt_item); }
+void rt_print_tab(double col) { print_tab(&g_rt_ps, (int)col); }
+void rt_print_zone(void) { print_zone(&g_rt_ps); }
+void rt_print_semi(void) { g_rt_ps.suppress_nl = 1; }
+void rt_print_end(void) { print_end(&g_rt_ps); }
+
+/* ---------- builtins ---------- */
+double rt_sgn(double v) { return (v > 0) - (v < 0); }
+double rt_eof(double f) { return fn_eof((int)f); }
+double rt_pos(void) { return (double)(g_print_col + 1); }
+double rt_rnd(void) { return fn_rnd(); }
+
+static const char* rt_srefn(const char* s, int src, int n, const double* subs, int* len) {
+    int sx[MAX_DIMS];
+    SArray* sa;
+    if (src == 0) { *len = (int)strlen(s); return s; }
+    if (src == 1) return rt_str(s, len);
+    sa = sarray_find(s);
+    rt_subs(sx, n, subs);
+    if (!sa) { *len = 0; return ""; }
+    return sarray_getn(sa, sx, n, len);
+}
+
+const char* rt_sref(const char* s, int src, int n, const double* subs) { int sl; return rt_srefn(s, src, n, subs, &sl); }
+
+double rt_strfn(int fn, const char* s, int src, int n, const double* subs, double a, double b) {
+    int sl;
+    const char* p = rt_srefn(s, src, n, subs, &sl);
+    return str_fn_num(fn, p, sl, a, b);
+}
+
+double rt_scmp(int kind, const char* a, const char* b) { return str_rel_num(kind, a, (int)strlen(a), b, (int)strlen(b)); }
+
+double rt_str_num(double v) { return fn_str_num(v); }
+double rt_istr(RtInt v) { return v.exact ? v.d : fn_str_num(v.d); }
+double rt_chr_num(double v) { return fn_chr_num(v); }
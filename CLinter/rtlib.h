@@ -0,0 +1,99 @@
+#ifndef RTLIB_H
+#define RTLIB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ---- Runtime for programs translated with --emit-c (emitc.cpp) ----
+   The generated C file keeps control flow and numeric variables native and calls
+   into this API for everything else. It is built from the interpreter sources with
+   CLINTER_RTLIB defined (which drops the interactive main), because statements the
+   compiler leaves to the interpreter still run through exec_statement. */
+
+typedef struct { int line; const char* text; } RtLine;   /* program as loaded */
+typedef struct { void* a; unsigned epoch; } RtArr;        /* bound array slot */
+
+void rt_init(const RtLine* lines, int n);
+int  rt_exit(void);
+
+/* statements left to the interpreter (same return codes as exec_statement; 3 resumes
+   at the statement PC in *jump, see the resume switch of the generated code) */
+int  rt_seg(int line, int seg, int* jump);
+int  rt_branch(int line, int seg, int tok, int* jump);
+unsigned rt_epoch(void);                   /* changes when the variable table is cleared */
+double*  rt_num(const char* name);         /* numeric variable shared with the interpreter */
+long long* rt_int(const char* name);       /* integer variable (A%, DEFINT), always shared */
+int      rt_ilet(long long* var, double val);   /* store truncated; -1 on overflow */
+
+/* integer-valued expressions (compile.h Node.isint): exact in i while 'exact' is set,
+   widened once a result overflows; d always holds the value as a double */
+typedef struct { long long i; double d; int exact; } RtInt;
+RtInt rt_ival(long long i);
+RtInt rt_itrunc(double v);                 /* a double operand of MOD / IDIV / NOT */
+RtInt rt_ineg(RtInt a);
+RtInt rt_iadd(RtInt a, RtInt b);
+RtInt rt_isub(RtInt a, RtInt b);
+RtInt rt_imul(RtInt a, RtInt b);
+RtInt rt_inot(RtInt a);
+RtInt rt_imod(RtInt a, RtInt b);
+RtInt rt_iidiv(RtInt a, RtInt b);
+int   rt_iset(long long* var, RtInt v);    /* rt_ilet of an integer value */
+double   rt_sval(const char* name);        /* string variable read as a number (atof) */
+
+/* control flow */
+int  rt_for(const char* name, double* var, double start, double to, double step, int line, int seg);
+int  rt_ifor(const char* name, long long* var, double start, double to, double step, int line, int seg);
+int  rt_next(const char* name, int* jump); /* name NULL = innermost */
+int  rt_gosub(int line, int seg);          /* call made from statement seg of line */
+int  rt_return(int* jump);
+void rt_undefined(int line);
+void rt_trace(int line);                  /* [TRACE] output when TRACE is on */
+
+/* arrays, DATA, files (subscripts as evaluated) */
+double rt_aget(RtArr* c, const char* name, int n, const double* subs);
+int    rt_aset(RtArr* c, const char* name, int n, const double* subs, double val);
+RtInt  rt_iaget(RtArr* c, const char* name, int n, const double* subs);   /* exact from an integer array */
+int    rt_iaset(RtArr* c, const char* name, int n, const double* subs, RtInt val);
+int    rt_dim(const char* name, int n, const double* subs);
+void   rt_read_begin(void);
+int    rt_read(const char* name, int n, const double* subs);   /* n < 0: scalar */
+void   rt_restore(int line);
+int    rt_open(const char* name, int mode, int handle);
+void   rt_close(int handle);
+
+/* PRINT */
+int  rt_print_begin(int handle);
+void rt_item_begin(void);
+void rt_part_num(double v);
+void rt_part_int(RtInt v);                 /* an integer part: %lld when exact */
+void rt_part_str(const char* s);
+void rt_part_svar(const char* name);
+void rt_part_sarr(const char* name, int n, const double* subs);
+void rt_part_chr(double v);
+void rt_part_seg(const char* s, int isVar, int hasStart, double start, int hasLen, double len);
+void rt_part_trm(const char* s, int isVar);
+void rt_item_end(void);
+void rt_print_tab(double col);
+void rt_print_zone(void);
+void rt_print_semi(void);
+void rt_print_end(void);
+
+/* builtins with interpreter semantics */
+double rt_sgn(double v);
+double rt_eof(double f);
+double rt_pos(void);
+double rt_rnd(void);
+/* string builtins in numeric context (compile.h StrFn); src: 0 literal s, 1 string
+   variable s, 2 element of string array s */
+double rt_strfn(int fn, const char* s, int src, int n, const double* subs, double a, double b);
+const char* rt_sref(const char* s, int src, int n, const double* subs);   /* the string itself */
+double rt_scmp(int kind, const char* a, const char* b);   /* A$ = B$ ... (compile.h N_EQ..N_GE) */
+double rt_str_num(double v);               /* STR$(v) */
+double rt_istr(RtInt v);                   /* STR$ of an integer */
+double rt_chr_num(double v);               /* CHR$(v) */
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -23,16 +23,23 @@ void install_sigint_handler(void);
 #define MAX_STACK       256
 #define MAX_FILES       16
 
-typedef enum { VT_NUM=0, VT_STR=1 } VarType;
+typedef enum { VT_NUM=0, VT_STR=1, VT_INT=2 } VarType;
+
+/* BASIC integers: A% variables and arrays, DEFINT letters, MOD/IDIV/NOT operands */
+typedef long long BasInt;
 
-typedef struct { char name[32]; VarType type; double num; char *str; } Variable;
 // typedef struct { int line; char *text; } ProgLine;
 
 /* ---- Program storage (adjust names/types if yours differ) ---- */
+struct CrunchLine;
+struct Stmt;
+struct VmChunk;
+
 typedef struct ProgLine {
     int number;
     char* text;     /* text after the line number */
     struct ProgLine* next;
+    struct CrunchLine* code;   /* pre-lexed token stream of 'text' (crunch.cpp) */
 } ProgLine;
 
 extern ProgLine* g_prog_head;
@@ -47,7 +54,9 @@ typedef enum {
     T_HASH, T_LINE, T_DIM,
     T_EQ, T_NE, T_LT, T_GT, T_LE, T_GE, T_AND, T_OR, T_XOR, T_NOT,
     T_PLUS, T_MINUS, T_STAR, T_SLASH, T_LPAREN, T_RPAREN, T_COMMA, T_SEMI, T_POWOP,
-    T_DATA, T_READ, T_RESTORE, T_TRACE, T_ON, T_OFF, T_ONKW, T_DUMP, T_VARS, T_ARRAYS, T_STACK, T_QUIT, T_RENUM, T_BYE, T_HELP
+    T_DATA, T_READ, T_RESTORE, T_TRACE, T_ON, T_OFF, T_ONKW, T_DUMP, T_VARS, T_ARRAYS, T_STACK, T_QUIT, T_RENUM, T_BYE, T_HELP,
+    T_DEFINT,
+    T__COUNT
 } TokType;
 
 /* +++ ARRAYS +++ */
@@ -59,6 +68,7 @@ typedef struct {
     int   ndims;
     int   dims[MAX_DIMS];
     double* data;            /* row-major, zero-based */
+    BasInt* idata;           /* integer array (A%, DEFINT): elements live here, data is NULL */
 } Array;
 
 extern Array g_arrays[MAX_ARRAYS];
@@ -76,8 +86,30 @@ Array* array_dim(const char* name, int ndims, int* dims);
 int    array_index(Array* a, int* subs, int nsubs);     /* -1 on OOB */
 double array_get(Array* a, int* subs, int nsubs);
 void   array_set(Array* a, int* subs, int nsubs, double val);
+void   array_set_int(Array* a, int* subs, int nsubs, BasInt val);   /* exact in an integer array */
 void   arrays_clear(void);
 
+/* +++ STRINGS +++ */
+/* A stored BASIC string keeps its length, so LEN is O(1) and CHR$(0) is an ordinary
+   byte; a NUL still follows the last byte for C-string readers. Short values live in
+   the struct, longer ones in a reference-counted heap buffer: copying a string shares
+   it, and a store writes in place only into a buffer it alone holds and that fits,
+   otherwise it lets go of its reference and takes a fresh one. All-zero is "". */
+#define STR_INLINE 16
+
+typedef struct { int refs; char data[1]; } StrBuf;   /* data: cap bytes */
+
+typedef struct {
+    int len;
+    int cap;                 /* capacity of u.heap->data, 0 = the value is in u.in */
+    union { char in[STR_INLINE]; StrBuf* heap; } u;
+} BasStr;
+
+const char* bstr_ptr(const BasStr* s);
+int  bstr_set(BasStr* s, const char* p, int n);   /* p may point into s; -1 = out of memory */
+void bstr_copy(BasStr* d, const BasStr* s);       /* d = s, sharing s's buffer */
+void bstr_free(BasStr* s);                         /* back to "" */
+
 /* +++ STRING ARRAYS +++ */
 #define MAX_SARRAYS 128
 
@@ -85,7 +117,7 @@ typedef struct {
     char  name[32];
     int   ndims;
     int   dims[MAX_DIMS];
-    char** data;             /* row-major array of char* (may be NULL) */
+    BasStr* data;            /* row-major, calloc'd (every element starts as "") */
 } SArray;
 
 extern SArray g_sarrays[MAX_SARRAYS];
@@ -100,29 +132,100 @@ SArray* sarray_find(const char* name);
 SArray* sarray_dim(const char* name, int ndims, int* dims);
 int     sarray_index(SArray* a, int* subs, int nsubs);    /* -1 on OOB */
 const char* sarray_get(SArray* a, int* subs, int nsubs);  /* never NULL, returns "" if unset */
+const char* sarray_getn(SArray* a, int* subs, int nsubs, int* len);   /* same, with its length */
+const BasStr* sarray_at(SArray* a, int* subs, int nsubs);  /* the element, NULL (reported) if OOB */
 void    sarray_set(SArray* a, int* subs, int nsubs, const char* val);
+void    sarray_setn(SArray* a, int* subs, int nsubs, const char* val, int len);
+void    sarray_copy(SArray* a, int* subs, int nsubs, const BasStr* val);   /* shares val's buffer */
 void    sarrays_clear(void);
 
 
-typedef struct { TokType type; char text[128]; double number; } Token;
-typedef struct { const char *s; size_t i; Token cur; } Lexer;
+/* Token text is a span, never copied by the lexer:
+   - replaying a crunched line, 'text' is the NUL-terminated copy in CrunchLine.pool and
+     stays valid as long as the line;
+   - scanning raw text, 'text' points into the source and only 'len' bytes belong to it.
+   Statements only execute from crunched lines, so parsers may use 'text' as a C string. */
+typedef struct { TokType type; const char* text; int len; double number; } Token;
+
+/* Pre-lexed ("crunched") token, built once when a line is stored */
+typedef struct {
+    TokType type;
+    int     end;       /* lexer offset just past this token (keeps lx_peek_stmt_sep working) */
+    int     text;      /* offset of NUL-terminated text in CrunchLine.pool, -1 if none */
+    int     len;       /* length of that text */
+    int     sym;       /* interned identifier id for T_IDENT, -1 otherwise */
+    int     skip;      /* T_THEN: tokens ahead to the ELSE, else to the T_END (false path);
+                          T_ELSE: tokens ahead to the T_END (true path) */
+    int     ic;        /* T_IDENT inline cache: slot + 1 it resolved to, 0 = none (find_var_at) */
+    int     ic_kind;
+    unsigned ic_epoch; /* g_var_epoch of ic */
+    double  number;    /* pre-parsed value for T_NUMBER */
+} CrunchTok;
 
-typedef struct { char var[32]; double end; double step; int afterForLine; int forLine; } ForFrame;
+typedef struct {
+    int first;         /* index of first token in CrunchLine.toks (stream ends with T_END) */
+    int src;           /* the statement's text: a span of the line text in CrunchLine.pool */
+    int len;           /* (not NUL-terminated; it runs up to the separator) */
+    int compiled;      /* compile step ran for this statement (compile.cpp) */
+    struct Stmt* stmt; /* compiled form, NULL = interpret the token stream */
+} CrunchSeg;
+
+/* What a stored line is, decided once by crunch_line */
+typedef enum { LK_CODE = 0, LK_REM, LK_DATA } LineKind;   /* LK_REM also covers blank lines */
+
+typedef struct CrunchLine {
+    int        nseg;   /* ':' / '\' separated statements, empty ones dropped */
+    int        nrun;   /* statements RUN executes: trailing REM/DATA dropped, 0 = skip the line */
+    LineKind   kind;
+    CrunchSeg* segs;
+    int        ntok;
+    CrunchTok* toks;
+    char*      pool;   /* line text + token texts */
+    struct VmChunk* vm; /* bytecode (vm.cpp), NULL until RUN builds it */
+    unsigned   hits;   /* executions, drives tier promotion (--engine=tiered) */
+} CrunchLine;
+
+/* When 'tk' is set, lx_next replays the crunched stream instead of scanning 's' */
+typedef struct { const char *s; size_t i; Token cur; const CrunchTok* tk; const char* pool; } Lexer;
+
+/* Program counter: statement 'seg' of g_prog[index], packed into one int so it fits the
+   GOSUB/FOR frames and outJump. NEXT and RETURN resume at one with return code 3
+   (1 = jump to the line number in outJump, 2 RUN, 9 END, < 0 error). */
+#define PC_SEG_BITS 10
+#define PC_MAKE(index, seg) (((index) << PC_SEG_BITS) | (seg))
+#define PC_INDEX(pc) ((pc) >> PC_SEG_BITS)
+#define PC_SEG(pc) ((pc) & ((1 << PC_SEG_BITS) - 1))
+
+typedef struct { char var[32]; double end; double step; int body; int forLine; unsigned trips;
+                 int isint; BasInt iend, istep; } ForFrame;   /* body: PC after FOR; isint: integer loop variable */
 typedef struct { int used; FILE* fp; } FileSlot;
 
 /* Globals (defined in main.c) */
 extern ProgLine g_prog[MAX_PROG_LINES];
 extern int g_prog_count;
-
-extern Variable g_vars[MAX_VARS];
+extern unsigned g_prog_epoch;   /* bumped whenever program lines are added/changed/removed */
+
+/* Variables are parallel arrays indexed by slot, so numeric loops only touch g_var_num;
+   names are read by lookups, DUMP VARS and SAVEVARS */
+extern double        g_var_num[MAX_VARS];
+extern BasInt        g_var_int[MAX_VARS];    /* value of a VT_INT variable */
+extern BasStr        g_var_str[MAX_VARS];    /* VT_STR value; "" for other types */
+extern unsigned char g_var_type[MAX_VARS];   /* VarType */
+extern unsigned char g_var_numok[MAX_VARS];  /* VT_STR: g_var_num holds the string's value (var_value) */
+extern char          g_var_name[MAX_VARS][32];
 extern int g_var_count;
+extern unsigned g_var_epoch;    /* bumped when variable/array tables are cleared (drops bound slots) */
+extern unsigned g_defint;       /* DEFINT letters, bit 0 = A; rebuilt by prog_link, cleared by NEW */
 
 extern ForFrame g_for_stack[MAX_STACK];
 extern int g_for_top;
 
-extern int g_gosub_stack[MAX_STACK];
+extern int g_gosub_stack[MAX_STACK];   /* return PCs */
 extern int g_gosub_top;
 
+extern int g_pc_index;   /* g_prog index of the running line, -1 in immediate mode */
+extern int g_pc_seg;     /* statement within it, kept current by the executors */
+
 extern FileSlot g_files[MAX_FILES];
 
 /* Utilities (main.c) */
@@ -131,9 +234,35 @@ char *trim(char *s);
 void sort_program(void);
 int  find_prog_index_by_line(int line);
 int  next_line_number_after(int current);
-Variable* find_var(const char *name);
-Variable* ensure_var(const char *name, int isStr);
+int  prog_link(void);   /* line index + undefined-target report, before RUN */
+int  prog_pc_after(int index, int seg);   /* PC of the next statement, -1 at the end */
+int  find_var(const char *name);               /* slot, -1 = no such variable */
+int  ensure_var(const char *name, int isStr);   /* slot, -1 = table full */
+const char* var_str(int slot);                  /* string value, "" unless a set string (slot may be -1) */
+const char* var_strn(int slot, int* len);       /* same, with its length */
+const BasStr* var_bstr(int slot);               /* the stored string, NULL unless a string variable */
+double var_value(int slot);                     /* numeric value, strings through atof (slot may be -1) */
+void var_set_str(int slot, const char* s);      /* store a copy of s as the variable's string */
+void var_set_strn(int slot, const char* s, int len);   /* same for len bytes (may include NUL) */
+void var_copy_str(int slot, const BasStr* s);   /* share another variable's or element's string */
+int  var_set_num(int slot, double val);         /* store a number (integer variables truncate); 0 or -1 */
+void var_set_int(int slot, BasInt val);         /* store an integer (exact in an integer variable) */
+int  num_to_int(double val, BasInt* out);       /* truncate toward zero; -1 (reported) if out of range */
+BasInt num_trunc(double val);                   /* truncate toward zero, clamped to the BasInt range (NaN: 0) */
+int  int_add(BasInt a, BasInt b, BasInt* out);  /* 1 = *out exact, 0 = would overflow */
+int  int_sub(BasInt a, BasInt b, BasInt* out);
+int  int_mul(BasInt a, BasInt b, BasInt* out);
+int  int_mod(BasInt a, BasInt b, BasInt* out);  /* a MOD b, 0 when b is 0 */
+int  int_idiv(BasInt a, BasInt b, BasInt* out); /* a \ b, 0 when b is 0; 0 = LLONG_MIN \ -1 */
+/* the same lookups through the inline cache of the identifier token 'site' (lx_site;
+   NULL = plain lookup) */
+int       find_var_at(CrunchTok* site, const char *name);
+int       ensure_var_at(CrunchTok* site, const char *name, int isStr);
+Array*    array_find_at(CrunchTok* site, const char *name);
+SArray*   sarray_find_at(CrunchTok* site, const char *name);
 int  is_string_var_name(const char *name);
+int  is_int_var_name(const char *name);         /* ends with '%', or starts with a DEFINT letter */
+void prog_defint(void);                         /* apply the program's DEFINT statements (prog_link) */
 void prog_set_line(int line, const char *text);
 void prog_clear(void);
 void vars_clear(void);
@@ -141,6 +270,7 @@ void files_clear(void);
 void cmd_list(int startGiven,int start,int endGiven,int end);
 
 double fn_eof(int fileno);
+double fn_rnd(void);
 void print_help(void);
 
 /* DATA table API */
@@ -0,0 +1,869 @@
+/* vm.cpp - bytecode engine for RUN (--engine=vm)
+   - Each program line's compiled statements (compile.h) are flattened into one chunk of
+     stack code; control flow between lines still goes through run_program's line loop,
+     FOR/NEXT and GOSUB use the same stacks as the interpreter.
+   - Statements the compiler could not take become OP_STMT and run through exec_statement_lx,
+     so a line never needs to fall back as a whole.
+   - Expressions use a fixed double stack; lines that would need more than VM_STACK slots
+     are left to the tree engine.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+#include "runtime.h"
+#include "parse.h"
+#include "wxecut.h"
+#include "printfunc.h"
+#include "compile.h"
+#include "vm.h"
+#include "jit.h"
+
+int g_engine = ENGINE_TIERED;
+int g_vm_opstats = 0;
+
+#define VM_NAME(name, nargs) #name,
+#define VM_NARGS(name, nargs) nargs,
+static const char* const vm_op_name[OP__COUNT] = { VM_OPS(VM_NAME) };
+static const int vm_op_nargs[OP__COUNT] = { VM_OPS(VM_NARGS) };
+#undef VM_NAME
+#undef VM_NARGS
+
+/* ---------- chunk builder ---------- */
+typedef struct {
+    VmChunk* ch;
+    int cap;
+    int depth;       /* operand stack depth while emitting */
+    int maxdepth;
+    int ok;
+    int last;        /* start of the last instruction emitted */
+    int label;       /* latest jump target (code offset) */
+} Vc;
+
+static void* vc_grow(void* p, int n, size_t elsz) {
+    void* np = realloc(p, (size_t)(n + 1) * elsz);
+    if (!np) { fprintf(stderr, "ERROR: out of memory in VM compiler\n"); exit(1); }
+    return np;
+}
+
+static int emit(Vc* v, int w) {
+    VmChunk* ch = v->ch;
+    if (ch->ncode >= v->cap) {
+        int nc = v->cap ? v->cap * 2 : 64;
+        int* np = (int*)realloc(ch->code, (size_t)nc * sizeof(int));
+        if (!np) { fprintf(stderr, "ERROR: out of memory in VM compiler\n"); exit(1); }
+        ch->code = np; v->cap = nc;
+    }
+    ch->code[ch->ncode] = w;
+    return ch->ncode++;
+}
+
+static void stack_adj(Vc* v, int n) {
+    v->depth += n;
+    if (v->depth > v->maxdepth) v->maxdepth = v->depth;
+}
+
+static int k_add(Vc* v, double d) {
+    VmChunk* ch = v->ch;
+    ch->k = (double*)vc_grow(ch->k, ch->nk, sizeof(double));
+    ch->k[ch->nk] = d;
+    return ch->nk++;
+}
+
+static int str_add(Vc* v, const char* s) {
+    VmChunk* ch = v->ch;
+    ch->str = (const char**)vc_grow((void*)ch->str, ch->nstr, sizeof(const char*));
+    ch->str[ch->nstr] = s;
+    return ch->nstr++;
+}
+
+static int ref_add(Vc* v, const char* name) {
+    VmChunk* ch = v->ch;
+    ch->refs = (VmRef*)vc_grow(ch->refs, ch->nref, sizeof(VmRef));
+    ch->refs[ch->nref].name = name;
+    ch->refs[ch->nref].slot = NULL;
+    ch->refs[ch->nref].epoch = 0;
+    return ch->nref++;
+}
+
+static int fn_add(Vc* v, const Node* n) {
+    VmChunk* ch = v->ch;
+    ch->fns = (VmFn*)vc_grow(ch->fns, ch->nfn, sizeof(VmFn));
+    ch->fns[ch->nfn].f0 = n->fn0;
+    ch->fns[ch->nfn].f1 = n->fn1;
+    ch->fns[ch->nfn].f2 = n->fn2;
+    return ch->nfn++;
+}
+
+/* ---------- superinstructions ----------
+   Picked from --opstats on loop-heavy programs: a constant right operand
+   (OP_NUM + arithmetic), two variable loads in a row, X = X + k (OP_VAR OP_ADDK
+   OP_LET as one store in place) and a named NEXT, which steps and tests a numeric
+   loop variable in place. Fusion never spans a jump target
+   (v->label) and is off under --opstats so the raw pairs are counted. */
+static int emit_op(Vc* v, VmOp op) {
+    v->last = emit(v, op);
+    return v->last;
+}
+
+static VmOp fuse_k(VmOp op) {
+    if (g_vm_opstats) return op;
+    switch (op) {
+    case OP_ADD: return OP_ADDK;
+    case OP_SUB: return OP_SUBK;
+    case OP_MUL: return OP_MULK;
+    case OP_DIV: return OP_DIVK;
+    default: return op;
+    }
+}
+
+static void emit_var(Vc* v, int ref) {
+    VmChunk* ch = v->ch;
+    if (!g_vm_opstats && v->last >= 0 && v->last + 2 == ch->ncode && v->label != ch->ncode
+        && ch->code[v->last] == OP_VAR) {
+        ch->code[v->last] = OP_VAR2;
+        emit(v, ref);
+        return;
+    }
+    emit_op(v, OP_VAR); emit(v, ref);
+}
+
+/* src s n operands of a string operand (N_STR): 1 literal, 2 variable ref, 3 array ref */
+static void emit_sop(Vc* v, Node* n) {
+    int src = n->str ? 1 : n->sarray ? 3 : 2;
+    emit(v, src);
+    emit(v, src == 1 ? str_add(v, n->str) : ref_add(v, n->name)); emit(v, n->nsubs);
+}
+
+static void emit_expr(Vc* v, Node* n);
+static void emit_iexpr(Vc* v, Node* n);
+
+/* MOD / IDIV / NOT operand: a double one is truncated to an integer first */
+static void emit_ioperand(Vc* v, Node* n) {
+    if (n->isint) { emit_iexpr(v, n); return; }
+    emit_expr(v, n);
+    emit_op(v, OP_ITRUNC);
+}
+
+/* an integer-valued tree (Node.isint), exact on the BasInt stack; emit_expr takes a
+   whole literal in a numeric context as a plain OP_NUM (so it fuses and stays native) */
+static void emit_iexpr(Vc* v, Node* n) {
+    int i;
+    switch (n->kind) {
+    case N_NUM: emit_op(v, OP_INUM); emit(v, k_add(v, n->num)); stack_adj(v, 1); return;
+    case N_VAR: emit_op(v, OP_IVAR); emit(v, ref_add(v, n->name)); stack_adj(v, 1); return;
+    case N_ARR:
+        for (i = 0; i < n->nsubs; i++) emit_expr(v, n->subs[i]);
+        emit_op(v, OP_IARR); emit(v, ref_add(v, n->name)); emit(v, n->nsubs);
+        stack_adj(v, 1 - n->nsubs);
+        return;
+    case N_NEG: emit_iexpr(v, n->a); emit_op(v, OP_INEG); return;
+    case N_NOT: emit_ioperand(v, n->a); emit_op(v, OP_NOT); return;
+    case N_ADD: case N_SUB: case N_MUL:
+        emit_iexpr(v, n->a); emit_iexpr(v, n->b);
+        emit_op(v, n->kind == N_ADD ? OP_IADD : n->kind == N_SUB ? OP_ISUB : OP_IMUL);
+        stack_adj(v, -1);
+        return;
+    case N_MOD: case N_IDIV:
+        emit_ioperand(v, n->a); emit_ioperand(v, n->b);
+        emit_op(v, n->kind == N_MOD ? OP_MOD : OP_IDIV);
+        stack_adj(v, -1);
+        return;
+    default: v->ok = 0;
+    }
+}
+
+static void emit_expr(Vc* v, Node* n) {
+    int i;
+    if (n->isint && n->kind != N_NUM) { emit_iexpr(v, n); return; }
+    switch (n->kind) {
+    case N_NUM: emit_op(v, OP_NUM); emit(v, k_add(v, n->num)); stack_adj(v, 1); return;
+    case N_VAR: emit_var(v, ref_add(v, n->name)); stack_adj(v, 1); return;
+    case N_ARR:
+        for (i = 0; i < n->nsubs; i++) emit_expr(v, n->subs[i]);
+        emit_op(v, OP_ARR); emit(v, ref_add(v, n->name)); emit(v, n->nsubs);
+        stack_adj(v, 1 - n->nsubs);
+        return;
+    case N_NEG: emit_expr(v, n->a); emit_op(v, OP_NEG); return;
+    case N_FN0: emit_op(v, OP_FN0); emit(v, fn_add(v, n)); stack_adj(v, 1); return;
+    case N_FN1:
+        if (n->fn1 == fn_str_num && n->a->isint) { emit_iexpr(v, n->a); emit_op(v, OP_ISTR); return; }
+        emit_expr(v, n->a);
+        emit_op(v, OP_FN1); emit(v, fn_add(v, n));
+        return;
+    case N_FN2: emit_expr(v, n->a); emit_expr(v, n->b); emit_op(v, OP_FN2); emit(v, fn_add(v, n)); stack_adj(v, -1); return;
+    case N_RND:
+        if (n->a) emit_expr(v, n->a);
+        emit_op(v, OP_RND); emit(v, n->a != NULL);
+        if (!n->a) stack_adj(v, 1);
+        return;
+    case N_STR:
+        for (i = 0; i < n->nsubs; i++) emit_expr(v, n->subs[i]);
+        if (n->a) emit_expr(v, n->a);
+        if (n->b) emit_expr(v, n->b);
+        emit_op(v, OP_STR); emit(v, n->sfn); emit_sop(v, n);
+        stack_adj(v, 1 - n->nsubs - str_fn_nargs(n->sfn));
+        return;
+    case N_SCMP:
+        for (i = 0; i < n->a->nsubs; i++) emit_expr(v, n->a->subs[i]);
+        for (i = 0; i < n->b->nsubs; i++) emit_expr(v, n->b->subs[i]);
+        emit_op(v, OP_SCMP); emit(v, n->sfn); emit_sop(v, n->a); emit_sop(v, n->b);
+        stack_adj(v, 1 - n->a->nsubs - n->b->nsubs);
+        return;
+    default: {
+        static const struct { NodeKind k; VmOp op; } bin[] = {
+            { N_POW, OP_POW }, { N_MUL, OP_MUL }, { N_DIV, OP_DIV }, { N_ADD, OP_ADD }, { N_SUB, OP_SUB },
+            { N_EQ, OP_EQ }, { N_NE, OP_NE }, { N_LT, OP_LT }, { N_GT, OP_GT }, { N_LE, OP_LE }, { N_GE, OP_GE },
+            { N_AND, OP_AND }, { N_OR, OP_OR }, { N_XOR, OP_XOR }
+        };
+        for (i = 0; i < (int)(sizeof(bin) / sizeof(bin[0])); i++) {
+            if (bin[i].k == n->kind) {
+                VmChunk* ch = v->ch;
+                VmOp k = fuse_k(bin[i].op);
+                emit_expr(v, n->a); emit_expr(v, n->b);
+                if (k != bin[i].op && v->last >= 0 && v->last + 2 == ch->ncode && v->label != ch->ncode
+                    && ch->code[v->last] == OP_NUM)
+                    ch->code[v->last] = k;   /* OP_NUM k OP_ADD -> OP_ADDK k */
+                else emit_op(v, bin[i].op);
+                stack_adj(v, -1);
+                return;
+            }
+        }
+        v->ok = 0;
+    }
+    }
+}
+
+static void emit_subs(Vc* v, Node** subs, int n) {
+    int i;
+    for (i = 0; i < n; i++) emit_expr(v, subs[i]);
+}
+
+static void emit_print(Vc* v, Stmt* s) {
+    int i, j;
+    emit_op(v, OP_PRINT_BEGIN); emit(v, s->handle);
+    for (i = 0; i < s->npops; i++) {
+        PrintOp* op = &s->pops[i];
+        switch (op->kind) {
+        case PO_ITEM:
+            emit_op(v, OP_ITEM_BEGIN);
+            for (j = 0; j < op->nparts; j++) {
+                PrintPart* pp = &op->parts[j];
+                switch (pp->kind) {
+                case PP_NUM: case PP_STRS:
+                    if (pp->a->isint) { emit_iexpr(v, pp->a); emit_op(v, OP_PART_INT); }
+                    else { emit_expr(v, pp->a); emit_op(v, OP_PART_NUM); }
+                    stack_adj(v, -1);
+                    break;
+                case PP_CHR: emit_expr(v, pp->a); emit_op(v, OP_PART_CHR); stack_adj(v, -1); break;
+                case PP_STR: emit_op(v, OP_PART_STR); emit(v, str_add(v, pp->text)); break;
+                case PP_SVAR: emit_op(v, OP_PART_SVAR); emit(v, ref_add(v, pp->text)); break;
+                case PP_SARR:
+                    emit_subs(v, pp->subs, pp->nsubs);
+                    emit_op(v, OP_PART_SARR); emit(v, ref_add(v, pp->text)); emit(v, pp->nsubs);
+                    stack_adj(v, -pp->nsubs);
+                    break;
+                case PP_SEG: case PP_TRM: {
+                    int src = !pp->text ? 0 : pp->text_is_var ? 2 : 1;
+                    int idx = src == 2 ? ref_add(v, pp->text) : src == 1 ? str_add(v, pp->text) : 0;
+                    if (pp->kind == PP_TRM) { emit_op(v, OP_PART_TRM); emit(v, src); emit(v, idx); break; }
+                    if (pp->a) emit_expr(v, pp->a);
+                    if (pp->b) emit_expr(v, pp->b);
+                    emit_op(v, OP_PART_SEG); emit(v, src); emit(v, idx); emit(v, pp->a != NULL); emit(v, pp->b != NULL);
+                    stack_adj(v, -((pp->a != NULL) + (pp->b != NULL)));
+                } break;
+                }
+            }
+            emit_op(v, OP_ITEM_END);
+            break;
+        case PO_TAB: emit_expr(v, op->expr); emit_op(v, OP_PRINT_TAB); stack_adj(v, -1); break;
+        case PO_ZONE: emit_op(v, OP_PRINT_ZONE); break;
+        case PO_SEMI: emit_op(v, OP_PRINT_SEMI); break;
+        }
+    }
+    emit_op(v, OP_PRINT_END);
+}
+
+static void emit_stmt(Vc* v, Stmt* s, int seg);
+
+static void emit_branch(Vc* v, Stmt* b, int seg) {
+    if (b->kind == S_INTERP) { emit_op(v, OP_BRANCH); emit(v, seg); emit(v, b->tok); }
+    else emit_stmt(v, b, seg);
+}
+
+static void emit_if(Vc* v, Stmt* s, int seg) {
+    int jz, jmp;
+    emit_expr(v, s->expr);
+    emit_op(v, OP_JZ); jz = emit(v, 0);
+    stack_adj(v, -1);
+
+    emit_branch(v, s->then_s, seg);
+
+    emit_op(v, OP_JMP); jmp = emit(v, 0);
+    v->ch->code[jz] = v->ch->ncode - (jz + 1);
+    v->label = v->ch->ncode;
+    if (s->else_s) emit_branch(v, s->else_s, seg);
+    v->ch->code[jmp] = v->ch->ncode - (jmp + 1);
+    v->label = v->ch->ncode;
+}
+
+/* X = X + k / X = X - k on a numeric variable: one OP_LETADDK (X - k adds -k) */
+static int emit_letk(Vc* v, Stmt* s) {
+    Node* e = s->expr;
+    if (g_vm_opstats || is_int_var_name(s->name) || (e->kind != N_ADD && e->kind != N_SUB)) return 0;
+    if (e->a->kind != N_VAR || _stricmp(e->a->name, s->name) || e->b->kind != N_NUM || e->b->isstr) return 0;
+    emit_op(v, OP_LETADDK); emit(v, ref_add(v, s->name));
+    emit(v, k_add(v, e->kind == N_ADD ? e->b->num : -e->b->num)); emit(v, s->clear_str);
+    return 1;
+}
+
+static void emit_stmt(Vc* v, Stmt* s, int seg) {
+    int i;
+    if (!s) { emit_op(v, OP_STMT); emit(v, seg); return; }
+    switch (s->kind) {
+    case S_LET:
+        if (emit_letk(v, s)) break;
+        if (s->expr->isint && is_int_var_name(s->name)) { emit_iexpr(v, s->expr); emit_op(v, OP_ILET); }
+        else { emit_expr(v, s->expr); emit_op(v, OP_LET); }
+        emit(v, ref_add(v, s->name)); emit(v, s->clear_str);
+        stack_adj(v, -1);
+        break;
+    case S_LETARR:
+        emit_subs(v, s->subs, s->nsubs);
+        if (s->expr->isint && is_int_var_name(s->name)) { emit_iexpr(v, s->expr); emit_op(v, OP_ILETARR); }
+        else { emit_expr(v, s->expr); emit_op(v, OP_LETARR); }
+        emit(v, ref_add(v, s->name)); emit(v, s->nsubs);
+        stack_adj(v, -(s->nsubs + 1));
+        break;
+    case S_FOR:
+        emit_expr(v, s->expr);
+        emit_expr(v, s->to);
+        if (s->step) emit_expr(v, s->step);
+        else { emit_op(v, OP_NUM); emit(v, k_add(v, 1.0)); stack_adj(v, 1); }
+        emit_op(v, OP_FOR); emit(v, str_add(v, s->name)); emit(v, seg);
+        stack_adj(v, -3);
+        break;
+    case S_NEXT:
+        if (s->name && !g_vm_opstats) { emit_op(v, OP_NEXTV); emit(v, ref_add(v, s->name)); emit(v, str_add(v, s->name)); }
+        else { emit_op(v, OP_NEXT); emit(v, s->name ? str_add(v, s->name) : -1); }
+        break;
+    case S_GOTO: emit_op(v, OP_GOTO); emit(v, s->line); break;
+    case S_GOSUB: emit_op(v, OP_GOSUB); emit(v, s->line); emit(v, seg); break;
+    case S_RETURN: emit_op(v, OP_RETURN); break;
+    case S_END: emit_op(v, OP_END); break;
+    case S_IF: emit_if(v, s, seg); break;
+    case S_ON:
+        emit_expr(v, s->expr);
+        emit_op(v, OP_ON); emit(v, s->mode); emit(v, seg); emit(v, s->nlines);
+        for (i = 0; i < s->nlines; i++) emit(v, s->lines[i]);
+        stack_adj(v, -1);
+        break;
+    case S_PRINT: emit_print(v, s); break;
+    case S_DIM: case S_READ:
+        if (s->kind == S_READ) emit_op(v, OP_READ_BEGIN);
+        for (i = 0; i < s->ntg; i++) {
+            Target* t = &s->tg[i];
+            if (t->nsubs > 0) emit_subs(v, t->subs, t->nsubs);
+            emit(v, s->kind == S_DIM ? OP_DIM : OP_READ); emit(v, str_add(v, t->name)); emit(v, t->nsubs);
+            if (t->nsubs > 0) stack_adj(v, -t->nsubs);
+        }
+        break;
+    case S_RESTORE: emit_op(v, OP_RESTORE); emit(v, s->line); break;
+    case S_OPEN: emit_op(v, OP_OPEN); emit(v, str_add(v, s->name)); emit(v, s->mode); emit(v, s->handle); break;
+    case S_CLOSE: emit_op(v, OP_CLOSE); emit(v, s->handle); break;
+    case S_REM: break;
+    case S_INTERP: emit_branch(v, s, seg); break;
+    }
+}
+
+static VmChunk* vm_compile_line(const CrunchLine* cl) {
+    Vc v;
+    int s;
+    memset(&v, 0, sizeof(v));
+    v.ok = 1;
+    v.last = -1;
+    v.ch = (VmChunk*)calloc(1, sizeof(VmChunk));
+    if (!v.ch) return NULL;
+    v.ch->segpc = (int*)calloc((size_t)(cl->nrun ? cl->nrun : 1), sizeof(int));
+    if (!v.ch->segpc) { vm_free(v.ch); return NULL; }
+    v.ch->nseg = cl->nrun;   /* trailing REM/DATA compile to nothing */
+    for (s = 0; s < cl->nrun; s++) {
+        v.ch->segpc[s] = v.label = v.ch->ncode;   /* NEXT/RETURN enter here: no fusion across */
+        emit_stmt(&v, cl->segs[s].stmt, s);
+    }
+    emit_op(&v, OP_RET0);
+    if (!v.ok || v.maxdepth > VM_STACK) { vm_free(v.ch); return NULL; }
+    return v.ch;
+}
+
+void vm_compile_program(void) {
+    int i;
+    for (i = 0; i < g_prog_count; i++) {
+        CrunchLine* cl = g_prog[i].code;
+        if (cl && !cl->vm) cl->vm = vm_compile_line(cl);
+        if (g_engine == ENGINE_JIT && cl && cl->vm && !cl->vm->jit) cl->vm->jit = jit_compile(cl->vm);
+    }
+}
+
+/* ---------- tiers ---------- */
+static void tier_promote(CrunchLine* cl, int jit) {
+    line_compile(cl);
+    if (!cl->vm) cl->vm = vm_compile_line(cl);
+    if (jit && cl->vm && !cl->vm->jit) cl->vm->jit = jit_compile(cl->vm);
+}
+
+void vm_tier_line(CrunchLine* cl) {
+    unsigned h = ++cl->hits;
+    if (h == TIER_VM_HOT) tier_promote(cl, 0);
+    else if (h == TIER_JIT_HOT) tier_promote(cl, 1);
+}
+
+void vm_tier_loop(int first, int last) {
+    int i;
+    for (i = first; i <= last && i < g_prog_count; i++) {
+        CrunchLine* cl = g_prog[i].code;
+        if (!cl || cl->hits >= TIER_JIT_HOT) continue;
+        cl->hits = TIER_JIT_HOT;
+        tier_promote(cl, 1);
+    }
+}
+
+void vm_tier_preset(CrunchLine* cl, int jit) {
+    unsigned h = jit ? TIER_JIT_HOT : TIER_VM_HOT;
+    if (cl->hits < h) cl->hits = h;
+    tier_promote(cl, jit);
+}
+
+void vm_free(VmChunk* ch) {
+    if (!ch) return;
+    jit_free(ch->jit);
+    free(ch->code);
+    free(ch->k);
+    free((void*)ch->str);
+    free(ch->refs);
+    free(ch->fns);
+    free(ch->segpc);
+    free(ch);
+}
+
+/* ---------- interpreter loop ---------- */
+/* variable refs keep &g_var_num[slot], so compiled code can load and store it directly */
+static void ref_var_bind(VmRef* r, int v) {
+    r->slot = v < 0 ? NULL : (void*)&g_var_num[v];
+    r->epoch = g_var_epoch;
+}
+
+static int ref_var(VmRef* r) {
+    if (!r->slot || r->epoch != g_var_epoch) ref_var_bind(r, find_var(r->name));
+    return r->slot ? (int)((double*)r->slot - g_var_num) : -1;
+}
+
+static Array* ref_arr(VmRef* r) {
+    if (!r->slot || r->epoch != g_var_epoch) { r->slot = array_find(r->name); r->epoch = g_var_epoch; }
+    return (Array*)r->slot;
+}
+
+static SArray* ref_sarr(VmRef* r) {
+    if (!r->slot || r->epoch != g_var_epoch) { r->slot = sarray_find(r->name); r->epoch = g_var_epoch; }
+    return (SArray*)r->slot;
+}
+
+static const char* ref_str_text(VmRef* r, int* len) {
+    return var_strn(ref_var(r), len);
+}
+
+/* the string a src s n operand names, and its length; an array element's n subscripts
+   are at sub[0..n) */
+static const char* vm_sref(VmChunk* ch, int src, int idx, int n, const double* sub, int* len) {
+    int subs[MAX_DIMS], q;
+    SArray* sa;
+    if (src == 1) { *len = (int)strlen(ch->str[idx]); return ch->str[idx]; }
+    if (src == 2) return ref_str_text(&ch->refs[idx], len);
+    sa = ref_sarr(&ch->refs[idx]);
+    for (q = 0; q < n; q++) subs[q] = (int)sub[q];
+    if (!sa) { *len = 0; return ""; }
+    return sarray_getn(sa, subs, n, len);
+}
+
+/* OP_LET: store into the variable r names, creating it on first use (exact: ival, into an
+   integer variable) */
+static int vm_let(VmRef* r, int clear, double val, int exact, BasInt ival) {
+    int v = (r->slot && r->epoch == g_var_epoch) ? (int)((double*)r->slot - g_var_num) : -1;
+    if (v < 0) {
+        v = clear ? find_var(r->name) : -1;
+        if (v < 0) v = ensure_var(r->name, 0);
+        if (v < 0) { printf("ERROR: VARIABLE TABLE FULL\n"); return -1; }
+        ref_var_bind(r, v);
+    }
+    if (g_var_type[v] == VT_INT) {
+        if (exact) g_var_int[v] = ival;
+        else if (num_to_int(val, &g_var_int[v]) < 0) return -1;
+        return 0;
+    }
+    g_var_type[v] = VT_NUM;
+    if (clear && g_var_str[v].len) bstr_free(&g_var_str[v]);
+    g_var_num[v] = val;
+    return 0;
+}
+
+/* pop n subscripts (pushed left to right) into subs */
+#define POP_SUBS(n) do { int q_; sp -= (n); for (q_ = 0; q_ < (n); q_++) subs[q_] = (int)st[sp + q_]; } while (0)
+
+/* Dispatch: GCC/Clang thread the handlers with computed goto (one indirect jump per
+   handler, so the branch predictor sees opcode pairs); elsewhere a plain switch. */
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(VM_NO_THREADED)
+#define VM_THREADED
+#define CASE(op)   L_##op:
+#define NEXT()     goto *labels[code[pc++]]
+#define DISPATCH() NEXT()
+#else
+#define CASE(op)   case op:
+#define NEXT()     continue
+#endif
+
+static int vm_run(VmChunk* ch, int pc, const CrunchLine* cl, int currentLine, int* outJump, unsigned epoch) {
+    double st[VM_STACK];
+    BasInt ist[VM_STACK];     /* integer ops: the exact value of st[i] when iok[i] */
+    char iok[VM_STACK];
+    int sp = 0;
+    int subs[MAX_DIMS];
+    const int* code = ch->code;
+    PrintState ps;
+    unsigned char store[PRINT_ITEM_MAX];
+    ByteBuf item;
+
+#ifdef VM_THREADED
+#define VM_LABEL(name, nargs) &&L_##name,
+    static void* const labels[OP__COUNT] = { VM_OPS(VM_LABEL) };
+#undef VM_LABEL
+    DISPATCH();
+#else
+    for (;;) {
+        switch ((VmOp)code[pc++]) {
+#endif
+        CASE(OP_NUM) st[sp++] = ch->k[code[pc++]]; NEXT();
+        CASE(OP_VAR) st[sp++] = var_value(ref_var(&ch->refs[code[pc++]])); NEXT();
+        CASE(OP_VAR2) {
+            st[sp++] = var_value(ref_var(&ch->refs[code[pc++]]));
+            st[sp++] = var_value(ref_var(&ch->refs[code[pc++]]));
+        } NEXT();
+        CASE(OP_ARR) {
+            VmRef* r = &ch->refs[code[pc++]];
+            int n = code[pc++];
+            Array* a;
+            POP_SUBS(n);
+            a = ref_arr(r);
+            if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", r->name); st[sp++] = 0.0; }
+            else st[sp++] = array_get(a, subs, n);
+        } NEXT();
+        CASE(OP_NEG) st[sp - 1] = -st[sp - 1]; NEXT();
+        CASE(OP_POW) sp--; st[sp - 1] = pow(st[sp - 1], st[sp]); NEXT();
+        CASE(OP_MUL) sp--; st[sp - 1] = st[sp - 1] * st[sp]; NEXT();
+        CASE(OP_DIV) sp--; st[sp - 1] = st[sp - 1] / st[sp]; NEXT();
+        CASE(OP_ADD) sp--; st[sp - 1] = st[sp - 1] + st[sp]; NEXT();
+        CASE(OP_SUB) sp--; st[sp - 1] = st[sp - 1] - st[sp]; NEXT();
+        CASE(OP_ADDK) st[sp - 1] = st[sp - 1] + ch->k[code[pc++]]; NEXT();
+        CASE(OP_SUBK) st[sp - 1] = st[sp - 1] - ch->k[code[pc++]]; NEXT();
+        CASE(OP_MULK) st[sp - 1] = st[sp - 1] * ch->k[code[pc++]]; NEXT();
+        CASE(OP_DIVK) st[sp - 1] = st[sp - 1] / ch->k[code[pc++]]; NEXT();
+        CASE(OP_EQ) sp--; st[sp - 1] = (st[sp - 1] == st[sp]) ? 1.0 : 0.0; NEXT();
+        CASE(OP_NE) sp--; st[sp - 1] = (st[sp - 1] != st[sp]) ? 1.0 : 0.0; NEXT();
+        CASE(OP_LT) sp--; st[sp - 1] = (st[sp - 1] < st[sp]) ? 1.0 : 0.0; NEXT();
+        CASE(OP_GT) sp--; st[sp - 1] = (st[sp - 1] > st[sp]) ? 1.0 : 0.0; NEXT();
+        CASE(OP_LE) sp--; st[sp - 1] = (st[sp - 1] <= st[sp]) ? 1.0 : 0.0; NEXT();
+        CASE(OP_GE) sp--; st[sp - 1] = (st[sp - 1] >= st[sp]) ? 1.0 : 0.0; NEXT();
+        CASE(OP_AND) sp--; st[sp - 1] = (st[sp - 1] != 0.0 && st[sp] != 0.0) ? 1.0 : 0.0; NEXT();
+        CASE(OP_OR) sp--; st[sp - 1] = (st[sp - 1] != 0.0 || st[sp] != 0.0) ? 1.0 : 0.0; NEXT();
+        CASE(OP_XOR) sp--; st[sp - 1] = ((st[sp - 1] != 0.0) != (st[sp] != 0.0)) ? 1.0 : 0.0; NEXT();
+        CASE(OP_FN0) st[sp++] = ch->fns[code[pc++]].f0(); NEXT();
+        CASE(OP_FN1) st[sp - 1] = ch->fns[code[pc++]].f1(st[sp - 1]); NEXT();
+        CASE(OP_FN2) sp--; st[sp - 1] = ch->fns[code[pc++]].f2(st[sp - 1], st[sp]); NEXT();
+
+        CASE(OP_INUM) st[sp] = ch->k[code[pc++]]; ist[sp] = (BasInt)st[sp]; iok[sp++] = 1; NEXT();
+        CASE(OP_IVAR) {
+            int v = ref_var(&ch->refs[code[pc++]]);
+            if (v >= 0 && g_var_type[v] == VT_INT) { ist[sp] = g_var_int[v]; st[sp] = (double)ist[sp]; iok[sp++] = 1; }
+            else { st[sp] = var_value(v); iok[sp++] = 0; }
+        } NEXT();
+        CASE(OP_IARR) {
+            VmRef* r = &ch->refs[code[pc++]];
+            int n = code[pc++], k;
+            Array* a;
+            POP_SUBS(n);
+            a = ref_arr(r);
+            iok[sp] = 0;
+            if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", r->name); st[sp++] = 0.0; }
+            else if (a->idata && (k = array_index(a, subs, n)) >= 0) { ist[sp] = a->idata[k]; st[sp] = (double)ist[sp]; iok[sp++] = 1; }
+            else st[sp++] = array_get(a, subs, n);
+        } NEXT();
+        CASE(OP_INEG)
+            if (iok[sp - 1] && ist[sp - 1] != LLONG_MIN) { ist[sp - 1] = -ist[sp - 1]; st[sp - 1] = (double)ist[sp - 1]; }
+            else { st[sp - 1] = -st[sp - 1]; iok[sp - 1] = 0; }
+            NEXT();
+        CASE(OP_IADD) CASE(OP_ISUB) CASE(OP_IMUL) {
+            int op = code[pc - 1];
+            sp--;
+            if (iok[sp - 1] && iok[sp] && (op == OP_IADD ? int_add(ist[sp - 1], ist[sp], &ist[sp - 1])
+                                           : op == OP_ISUB ? int_sub(ist[sp - 1], ist[sp], &ist[sp - 1])
+                                           : int_mul(ist[sp - 1], ist[sp], &ist[sp - 1])))
+                st[sp - 1] = (double)ist[sp - 1];
+            else {
+                st[sp - 1] = op == OP_IADD ? st[sp - 1] + st[sp] : op == OP_ISUB ? st[sp - 1] - st[sp] : st[sp - 1] * st[sp];
+                iok[sp - 1] = 0;
+            }
+        } NEXT();
+        CASE(OP_ITRUNC) ist[sp - 1] = num_trunc(st[sp - 1]); st[sp - 1] = (double)ist[sp - 1]; iok[sp - 1] = 1; NEXT();
+        CASE(OP_NOT) {
+            BasInt x = iok[sp - 1] ? ist[sp - 1] : num_trunc(st[sp - 1]);
+            ist[sp - 1] = ~x; st[sp - 1] = (double)ist[sp - 1]; iok[sp - 1] = 1;
+        } NEXT();
+        CASE(OP_MOD) CASE(OP_IDIV) {
+            BasInt a = iok[sp - 2] ? ist[sp - 2] : num_trunc(st[sp - 2]);
+            BasInt b = iok[sp - 1] ? ist[sp - 1] : num_trunc(st[sp - 1]);
+            sp--;
+            iok[sp - 1] = (char)(code[pc - 1] == OP_MOD ? int_mod(a, b, &ist[sp - 1]) : int_idiv(a, b, &ist[sp - 1]));
+            st[sp - 1] = iok[sp - 1] ? (double)ist[sp - 1] : (double)a / (double)b;
+        } NEXT();
+        CASE(OP_ISTR) if (!iok[sp - 1]) st[sp - 1] = fn_str_num(st[sp - 1]); NEXT();
+
+        CASE(OP_RND)
+            if (code[pc++]) sp--;
+            st[sp++] = fn_rnd();
+            NEXT();
+        CASE(OP_STR) {
+            int fn = code[pc++], src = code[pc++], idx = code[pc++], n = code[pc++];
+            int k = str_fn_nargs(fn), sl;
+            double b = k > 1 ? st[--sp] : 0.0;
+            double a = k > 0 ? st[--sp] : 0.0;
+            const char* s;
+            sp -= n;
+            s = vm_sref(ch, src, idx, n, st + sp, &sl);
+            st[sp] = str_fn_num(fn, s, sl, a, b);
+            sp++;
+        } NEXT();
+        CASE(OP_SCMP) {
+            int kind = code[pc], sa = code[pc + 1], ia = code[pc + 2], na = code[pc + 3];
+            int sb = code[pc + 4], ib = code[pc + 5], nb = code[pc + 6];
+            const char* a, * b;
+            int al, bl;
+            pc += 7;
+            sp -= nb; b = vm_sref(ch, sb, ib, nb, st + sp, &bl);
+            sp -= na; a = vm_sref(ch, sa, ia, na, st + sp, &al);
+            st[sp++] = str_rel_num(kind, a, al, b, bl);
+        } NEXT();
+
+        CASE(OP_LET) CASE(OP_ILET) {
+            int exact = code[pc - 1] == OP_ILET && iok[sp - 1];
+            VmRef* r = &ch->refs[code[pc++]];
+            int clear = code[pc++];
+            sp--;
+            if (vm_let(r, clear, st[sp], exact, exact ? ist[sp] : 0) < 0) return -1;
+        } NEXT();
+        CASE(OP_LETADDK) {
+            VmRef* r = &ch->refs[code[pc]];
+            double k = ch->k[code[pc + 1]];
+            int clear = code[pc + 2];
+            int v = ref_var(r);
+            pc += 3;
+            if (v >= 0 && g_var_type[v] == VT_NUM && !(clear && g_var_str[v].len)) { g_var_num[v] += k; NEXT(); }
+            if (vm_let(r, clear, var_value(v) + k, 0, 0) < 0) return -1;
+        } NEXT();
+        CASE(OP_LETARR) CASE(OP_ILETARR) {
+            int exact = code[pc - 1] == OP_ILETARR && iok[sp - 1];
+            VmRef* r = &ch->refs[code[pc++]];
+            int n = code[pc++];
+            BasInt ival = exact ? ist[sp - 1] : 0;
+            double val = st[--sp];
+            Array* a;
+            POP_SUBS(n);
+            a = ref_arr(r);
+            if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", r->name); return -1; }
+            if (exact) array_set_int(a, subs, n, ival);
+            else array_set(a, subs, n, val);
+        } NEXT();
+        CASE(OP_FOR) {
+            int r;
+            sp -= 3;
+            g_pc_seg = code[pc + 1];
+            r = for_push(ch->str[code[pc]], st[sp], st[sp + 1], st[sp + 2], currentLine);
+            pc += 2;
+            if (r) return r;
+        } NEXT();
+        CASE(OP_NEXT) {
+            int s = code[pc++];
+            int r = for_next(s < 0 ? NULL : ch->str[s], outJump);
+            if (r) return r;
+        } NEXT();
+        CASE(OP_NEXTV) {
+            /* the innermost loop over a numeric variable: increment and compare here */
+            ForFrame* f = g_for_top > 0 ? &g_for_stack[g_for_top - 1] : NULL;
+            const char* name = ch->str[code[pc + 1]];
+            int v = ref_var(&ch->refs[code[pc]]), r;
+            pc += 2;
+            if (f && v >= 0 && !f->isint && g_var_type[v] == VT_NUM && _stricmp(f->var, name) == 0) {
+                double cur = g_var_num[v] + f->step;
+                g_var_num[v] = cur;
+                if (f->step >= 0 ? cur <= f->end : cur >= f->end) { f->trips++; *outJump = f->body; return 3; }
+                g_for_top--;
+                NEXT();
+            }
+            r = for_next(name, outJump);
+            if (r) return r;
+        } NEXT();
+        CASE(OP_GOTO) *outJump = code[pc]; return 1;
+        CASE(OP_GOSUB)
+            g_pc_seg = code[pc + 1];
+            if (gosub_push(currentLine) < 0) return -1;
+            *outJump = code[pc];
+            return 1;
+        CASE(OP_RETURN) return gosub_return(outJump);
+        CASE(OP_END) return 9;
+        CASE(OP_JZ) { int off = code[pc++]; if (st[--sp] == 0.0) pc += off; } NEXT();
+        CASE(OP_JMP) pc += code[pc] + 1; NEXT();
+        CASE(OP_ON) {
+            int gos = code[pc++], cnt, r;
+            g_pc_seg = code[pc++];
+            cnt = code[pc++];
+            r = on_jump((int)st[--sp], gos, code + pc, cnt, currentLine, outJump);
+            pc += cnt;
+            if (r) return r;
+        } NEXT();
+        CASE(OP_DIM) {
+            const char* name = ch->str[code[pc++]];
+            int n = code[pc++];
+            POP_SUBS(n);
+            if (dim_array(name, n, subs) < 0) return -1;
+        } NEXT();
+        CASE(OP_READ_BEGIN) data_maybe_rebuild(); NEXT();
+        CASE(OP_READ) {
+            const char* name = ch->str[code[pc++]];
+            int n = code[pc++];
+            if (n > 0) POP_SUBS(n);
+            if (read_into(name, subs, n) < 0) return -1;
+        } NEXT();
+        CASE(OP_RESTORE) restore_data(code[pc++]); NEXT();
+        CASE(OP_OPEN) {
+            const char* name = ch->str[code[pc++]];
+            int mode = code[pc++], handle = code[pc++];
+            if (open_file(name, mode, handle) < 0) return -1;
+        } NEXT();
+        CASE(OP_CLOSE) close_file(code[pc++]); NEXT();
+
+        CASE(OP_PRINT_BEGIN) if (print_begin(&ps, code[pc++]) < 0) return -1; NEXT();
+        CASE(OP_ITEM_BEGIN) bb_init(&item, store, sizeof(store)); NEXT();
+        CASE(OP_PART_NUM) bb_append_num(&item, st[--sp]); NEXT();
+        CASE(OP_PART_INT) sp--; if (iok[sp]) bb_append_int(&item, ist[sp]); else bb_append_num(&item, st[sp]); NEXT();
+        CASE(OP_PART_STR) bb_append_cstr(&item, ch->str[code[pc++]]); NEXT();
+        CASE(OP_PART_SVAR) {
+            int sl;
+            const char* s = ref_str_text(&ch->refs[code[pc++]], &sl);
+            bb_append(&item, s, (size_t)sl);
+        } NEXT();
+        CASE(OP_PART_SARR) {
+            SArray* sa = ref_sarr(&ch->refs[code[pc++]]);
+            int n = code[pc++], sl;
+            const char* s;
+            POP_SUBS(n);
+            if (sa) { s = sarray_getn(sa, subs, n, &sl); bb_append(&item, s, (size_t)sl); }
+        } NEXT();
+        CASE(OP_PART_CHR) bb_append_chr(&item, st[--sp]); NEXT();
+        CASE(OP_PART_SEG) CASE(OP_PART_TRM) {
+            int op = code[pc - 1], src = code[pc++], idx = code[pc++];
+            int sl = 0;
+            const char* s = src == 2 ? ref_str_text(&ch->refs[idx], &sl) : src == 1 ? ch->str[idx] : "";
+            if (src != 2) sl = (int)strlen(s);
+            if (op == OP_PART_TRM) { bb_append_trm(&item, s, sl); NEXT(); }
+            {
+                int hasStart = code[pc++], hasLen = code[pc++];
+                int len = hasLen ? (int)st[--sp] : 0;
+                int start = hasStart ? (int)st[--sp] : 1;
+                bb_append_seg(&item, s, sl, start, len);
+            }
+        } NEXT();
+        CASE(OP_ITEM_END) print_emit(&ps, &item); NEXT();
+        CASE(OP_PRINT_TAB) print_tab(&ps, (int)st[--sp]); NEXT();
+        CASE(OP_PRINT_ZONE) print_zone(&ps); NEXT();
+        CASE(OP_PRINT_SEMI) ps.suppress_nl = 1; NEXT();
+        CASE(OP_PRINT_END) print_end(&ps); NEXT();
+
+        CASE(OP_STMT) {
+            Lexer lx;
+            int r;
+            g_pc_seg = code[pc++];
+            lx_init_crunched(&lx, cl, g_pc_seg);
+            lx_next(&lx);
+            r = exec_statement_lx(&lx, 1, currentLine, outJump);
+            if (r) return r;
+            if (g_prog_epoch != epoch) return 0;   /* NEW/LOAD freed this chunk */
+        } NEXT();
+        CASE(OP_BRANCH) {
+            Lexer lx;
+            int r, seg = code[pc++], tok = code[pc++];
+            g_pc_seg = seg;
+            lx_init_crunched(&lx, cl, seg);
+            lx.tk = cl->toks + tok;
+            lx_next(&lx);
+            r = run_if_single_stmt(&lx, currentLine, outJump);
+            if (r) return r;
+        } NEXT();
+        CASE(OP_RET0) return 0;
+#ifndef VM_THREADED
+        default: return 0;
+        }
+    }
+#endif
+}
+
+int vm_exec_line(const CrunchLine* cl, int seg, int currentLine, int* outJump) {
+    int r;
+    cl->vm->runs++;
+    if (seg > 0) return seg < cl->vm->nseg ? vm_run(cl->vm, cl->vm->segpc[seg], cl, currentLine, outJump, g_prog_epoch) : 0;
+    if (cl->vm->jit && jit_exec(cl->vm->jit, cl->vm, currentLine, outJump, &r)) return r;
+    return vm_run(cl->vm, 0, cl, currentLine, outJump, g_prog_epoch);
+}
+
+/* ---------- --opstats ----------
+   Static opcode pairs of every chunk, weighted by how many times the chunk ran.
+   The most frequent pairs are the candidates for superinstructions. */
+static int vm_op_len(const int* code, int pc) {
+    int n = vm_op_nargs[code[pc]];
+    return n >= 0 ? 1 + n : 4 + code[pc + 3];   /* OP_ON: gosub seg count lines... */
+}
+
+typedef struct { unsigned long long n; int a, b; } VmPair;
+
+static int pair_cmp(const void* x, const void* y) {
+    const VmPair* p = (const VmPair*)x;
+    const VmPair* q = (const VmPair*)y;
+    return p->n < q->n ? 1 : p->n > q->n ? -1 : 0;
+}
+
+void vm_opstats_report(void) {
+    static VmPair pairs[OP__COUNT * OP__COUNT];
+    unsigned long long total = 0;
+    int i, n = 0;
+
+    memset(pairs, 0, sizeof(pairs));
+    for (i = 0; i < OP__COUNT * OP__COUNT; i++) { pairs[i].a = i / OP__COUNT; pairs[i].b = i % OP__COUNT; }
+    for (i = 0; i < g_prog_count; i++) {
+        const CrunchLine* cl = g_prog[i].code;
+        const VmChunk* ch = cl ? cl->vm : NULL;
+        int pc, prev = -1;
+        if (!ch || !ch->runs) continue;
+        for (pc = 0; pc < ch->ncode; pc += vm_op_len(ch->code, pc)) {
+            int op = ch->code[pc];
+            if (prev >= 0) { pairs[prev * OP__COUNT + op].n += ch->runs; total += ch->runs; }
+            prev = op;
+        }
+    }
+    qsort(pairs, OP__COUNT * OP__COUNT, sizeof(VmPair), pair_cmp);
+
+    fprintf(stderr, "---- opcode pairs (%llu executed) ----\n", total);
+    for (i = 0; i < 20 && pairs[i].n; i++, n++)
+        fprintf(stderr, "%12llu %5.1f%%  %s %s\n", pairs[i].n, total ? 100.0 * (double)pairs[i].n / (double)total : 0.0,
+                vm_op_name[pairs[i].a], vm_op_name[pairs[i].b]);
+    if (!n) fprintf(stderr, "(no bytecode ran)\n");
+}
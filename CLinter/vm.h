@@ -0,0 +1,162 @@
+#ifndef VM_H
+#define VM_H
+#include "runtime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Execution engine for RUN, chosen with --engine=tree|vm|jit|tiered
+   (jit: VM plus native code for numeric lines, jit.cpp; tiered: see below) */
+typedef enum { ENGINE_TREE = 0, ENGINE_VM = 1, ENGINE_JIT = 2, ENGINE_TIERED = 3 } Engine;
+extern int g_engine;
+
+#define VM_STACK 256    /* operand stack slots; deeper lines stay on the tree engine */
+
+/* ---- Bytecode ----
+   One chunk per program line, generated from the compiled statements (compile.h).
+   Operands follow the opcode inline in VmChunk.code; expressions run on a
+   double stack, integer-valued ones (Node.isint) also on an exact BasInt stack beside
+   it until a result has to widen, as node_ieval does. Statements the compiler left to the interpreter become OP_STMT.
+   X(name, operand words); -1 = variable (OP_ON: gosub seg count lines...).
+   seg operands name the statement a FOR/GOSUB frame resumes after (g_pc_seg). */
+#define VM_OPS(X) \
+    /* expressions */ \
+    X(OP_NUM, 1)        /* k              push constant */ \
+    X(OP_VAR, 1)        /* ref            push numeric value of variable */ \
+    X(OP_ARR, 2)        /* ref n          pop n subscripts, push element */ \
+    X(OP_NEG, 0) \
+    X(OP_POW, 0) X(OP_MUL, 0) X(OP_DIV, 0) X(OP_ADD, 0) X(OP_SUB, 0) \
+    X(OP_EQ, 0) X(OP_NE, 0) X(OP_LT, 0) X(OP_GT, 0) X(OP_LE, 0) X(OP_GE, 0) \
+    X(OP_AND, 0) X(OP_OR, 0) X(OP_XOR, 0) \
+    X(OP_FN0, 1)        /* f */ \
+    X(OP_FN1, 1)        /* f */ \
+    X(OP_FN2, 1)        /* f */ \
+    X(OP_RND, 1)        /* hasArg         (argument is popped and ignored) */ \
+    X(OP_STR, 4)        /* fn src s n     N_STR: pop its arguments, then n subscripts (src 1 literal, \
+                                          2 variable ref, 3 array ref) */ \
+    X(OP_SCMP, 7)       /* kind src s n src s n   N_SCMP: pop the second operand's subscripts, \
+                                          then the first's */ \
+    /* integers: the double slot always holds the value, the BasInt slot when it is exact */ \
+    X(OP_INUM, 1)       /* k              push a whole constant, exact */ \
+    X(OP_IVAR, 1)       /* ref            push a variable, exact when it is an integer */ \
+    X(OP_IARR, 2)       /* ref n          OP_ARR, exact from an integer array */ \
+    X(OP_INEG, 0) X(OP_IADD, 0) X(OP_ISUB, 0) X(OP_IMUL, 0)   /* widen on overflow */ \
+    X(OP_ITRUNC, 0)     /* truncate a double operand of MOD / IDIV / NOT */ \
+    X(OP_NOT, 0) X(OP_MOD, 0) X(OP_IDIV, 0) \
+    X(OP_ISTR, 0)       /* STR$ of an integer in numeric context */ \
+    /* superinstructions (see vm.cpp) */ \
+    X(OP_VAR2, 2)       /* ref ref        OP_VAR OP_VAR */ \
+    X(OP_ADDK, 1)       /* k              OP_NUM OP_ADD */ \
+    X(OP_SUBK, 1) X(OP_MULK, 1) X(OP_DIVK, 1) \
+    X(OP_NEXTV, 2)      /* ref s          OP_NEXT s, stepping a numeric variable in place */ \
+    X(OP_LETADDK, 3)    /* ref k clear    OP_VAR ref OP_ADDK k OP_LET ref clear, in place */ \
+    \
+    /* statements */ \
+    X(OP_LET, 2)        /* ref clear      pop value into numeric variable */ \
+    X(OP_LETARR, 2)     /* ref n          pop value, pop n subscripts */ \
+    X(OP_ILET, 2)       /* ref clear      OP_LET of an integer value (exact into an integer) */ \
+    X(OP_ILETARR, 2)    /* ref n          OP_LETARR of an integer value */ \
+    X(OP_FOR, 2)        /* s seg          pop step, to, start */ \
+    X(OP_NEXT, 1)       /* s|-1 */ \
+    X(OP_GOTO, 1)       /* line */ \
+    X(OP_GOSUB, 2)      /* line seg */ \
+    X(OP_RETURN, 0) \
+    X(OP_END, 0) \
+    X(OP_JZ, 1)         /* off            pop condition, jump if 0 */ \
+    X(OP_JMP, 1)        /* off */ \
+    X(OP_ON, -1)        /* gosub seg count lines... */ \
+    X(OP_DIM, 2)        /* s n            pop n sizes */ \
+    X(OP_READ_BEGIN, 0) \
+    X(OP_READ, 2)       /* s n            n < 0: scalar */ \
+    X(OP_RESTORE, 1)    /* line|-1 */ \
+    X(OP_OPEN, 3)       /* s mode handle */ \
+    X(OP_CLOSE, 1)      /* handle|-1 */ \
+    \
+    /* PRINT */ \
+    X(OP_PRINT_BEGIN, 1) /* handle|-1 */ \
+    X(OP_ITEM_BEGIN, 0) \
+    X(OP_PART_NUM, 0)   /* pop value, %.15g (also STR$) */ \
+    X(OP_PART_INT, 0)   /* pop an integer value, %lld when it is exact */ \
+    X(OP_PART_STR, 1)   /* s */ \
+    X(OP_PART_SVAR, 1)  /* ref */ \
+    X(OP_PART_SARR, 2)  /* ref n */ \
+    X(OP_PART_CHR, 0) \
+    X(OP_PART_SEG, 4)   /* src s hasStart hasLen   (src: 0 none, 1 literal, 2 variable ref) */ \
+    X(OP_PART_TRM, 2)   /* src s */ \
+    X(OP_ITEM_END, 0) \
+    X(OP_PRINT_TAB, 0) \
+    X(OP_PRINT_ZONE, 0) \
+    X(OP_PRINT_SEMI, 0) \
+    X(OP_PRINT_END, 0) \
+    \
+    /* interpreter hand-off */ \
+    X(OP_STMT, 1)       /* seg            exec_statement_lx on the crunched segment */ \
+    X(OP_BRANCH, 2)     /* seg tok        run_if_single_stmt (an IF branch the compiler left) */ \
+    X(OP_RET0, 0)       /* end of line */
+
+#define VM_OP_ENUM(name, nargs) name,
+typedef enum { VM_OPS(VM_OP_ENUM) OP__COUNT } VmOp;
+#undef VM_OP_ENUM
+
+/* Reference slot, bound to its table entry on first use (dropped when g_var_epoch changes) */
+typedef struct {
+    const char* name;
+    void* slot;          /* &g_var_num[slot], Array* or SArray* */
+    unsigned epoch;
+} VmRef;
+
+typedef struct {
+    double (*f0)(void);
+    double (*f1)(double);
+    double (*f2)(double, double);
+} VmFn;
+
+typedef struct VmChunk {
+    int* code;
+    int ncode;
+    double* k;          /* numeric constants */
+    int nk;
+    const char** str;   /* names and literals (point into the CrunchLine pool) */
+    int nstr;
+    VmRef* refs;
+    int nref;
+    VmFn* fns;
+    int nfn;
+    int* segpc;         /* code offset where each statement of the line starts */
+    int nseg;
+    unsigned long runs;  /* times vm_exec_line ran this chunk (--opstats) */
+    struct JitCode* jit; /* native code (--engine=jit), NULL = run the bytecode */
+} VmChunk;
+
+/* Build chunks for every program line that does not have one yet (after prog_compile). */
+void vm_compile_program(void);
+void vm_free(VmChunk* ch);
+
+/* Run one line's chunk from statement 'seg' (native code only starts at 0);
+   same return codes as exec_statement. */
+int vm_exec_line(const CrunchLine* cl, int seg, int currentLine, int* outJump);
+
+/* ---- Tiered execution (default engine) ----
+   Lines start on the token interpreter. After TIER_VM_HOT executions a line gets its
+   compiled statements and bytecode, after TIER_JIT_HOT native code. A FOR loop that
+   has iterated TIER_LOOP_HOT times promotes its whole body at once, so a loop that is
+   already running continues in the faster tiers from its next iteration; its frame on
+   g_for_stack is shared by all tiers. */
+#define TIER_VM_HOT   8
+#define TIER_JIT_HOT  64
+#define TIER_LOOP_HOT 8
+
+void vm_tier_line(CrunchLine* cl);              /* count one execution, promote when hot */
+void vm_tier_loop(int first, int last);         /* promote g_prog[first..last] to the top tier */
+void vm_tier_preset(CrunchLine* cl, int jit);   /* promote before it runs (profile.cpp) */
+
+/* --opstats: run on the VM without superinstructions, then report the most
+   frequent adjacent opcode pairs (weighted by line executions) to stderr. */
+extern int g_vm_opstats;
+void vm_opstats_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -2,10 +2,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
+#include <limits.h>
 #include "runtime.h"
 #include "parse.h"
 #include "wxecut.h"
 #include "printfunc.h"
+#include "crunch.h"
+#include "profile.h"
 
 /* --- exec helpers (no parsing here) --- */
 static int read_filename_after(Lexer*lx, char*out, size_t outsz){
@@ -31,6 +35,7 @@ static int read_line_from_file(FILE*fp, char*buf, size_t cap){
 
 /* -------- DATA pool (lazy build) -------- */
 static char** g_data_vals = NULL;
+static double* g_data_nums = NULL;   /* each item read as a number, parsed once when the table is built */
 static int    g_data_count = 0;
 static int    g_data_ptr = 0;
 static int    g_data_built = 0;
@@ -66,13 +71,20 @@ static void data_clear(void) {
         for (i = 0; i < g_data_count; i++) if (g_data_vals[i]) free(g_data_vals[i]);
         free(g_data_vals);
     }
+    free(g_data_nums);
+    g_data_nums = NULL;
     g_data_vals = NULL; g_data_count = 0; g_data_ptr = 0; g_data_built = 0;
 }
 
 static void data_push(const char* s) {
     char** nv = (char**)realloc(g_data_vals, sizeof(char*) * (g_data_count + 1));
+    double* nn;
     if (!nv) return;
     g_data_vals = nv;
+    nn = (double*)realloc(g_data_nums, sizeof(double) * (g_data_count + 1));
+    if (!nn) return;
+    g_data_nums = nn;
+    g_data_nums[g_data_count] = atof(s ? s : "");
     g_data_vals[g_data_count++] = strdup_c(s ? s : "");
 }
 
@@ -81,24 +93,19 @@ static void data_build_from_program(void) {
     data_clear();
     sort_program();  /* ensure order */
     for (i = 0; i < g_prog_count; i++) {
-        const char* src = g_prog[i].text;
-        Lexer lx; lx_init(&lx, src); lx_next(&lx);
-        if (lx.cur.type != T_DATA) continue;
-        /* After DATA: comma-separated list of string literals or numeric expressions */
+        const CrunchLine* cl = g_prog[i].code;
+        Lexer lx;
+        if (!cl || cl->kind != LK_DATA) continue;
+        /* parse the values from the line's token stream: its texts are NUL-terminated */
+        lx_init_crunched(&lx, cl, 0); lx_next(&lx);
+        /* After DATA: comma-separated list of expressions (string literals, numbers, ...) */
         lx_next(&lx);
         while (lx.cur.type != T_END) {
-            if (lx.cur.type == T_STRING) {
-                data_push(lx.cur.text);
-                lx_next(&lx);
-            }
-            else {
-                /* evaluate as number using parser */
-                double v = parse_rel(&lx);
-                char buf[64];
-                /* match your numeric print precision style */
-                _snprintf(buf, sizeof(buf), "%.15g", v);
-                data_push(buf);
-            }
+            /* any expression; numbers are kept as their %.15g text */
+            Value v;
+            parse_value(&lx, &v);
+            data_push(val_text(&v));
+            val_free(&v);
             if (lx.cur.type == T_COMMA) { lx_next(&lx); continue; }
             /* tolerate stray tokens; stop at line end */
             if (lx.cur.type != T_END) { /* consume unexpected */ lx_next(&lx); }
@@ -107,21 +114,23 @@ static void data_build_from_program(void) {
     g_data_built = 1;
 }
 
-static const char* data_next_string(void) {
+const char* data_next_string(void) {
     if (!g_data_built) data_build_from_program();
     if (g_data_ptr >= g_data_count) { printf("ERROR: OUT OF DATA\n"); return ""; }
     return g_data_vals[g_data_ptr++];
 }
 
-static double data_next_number(void) {
-    const char* s = data_next_string();
-    return atof(s);
+double data_next_number(void) {
+    if (!g_data_built) data_build_from_program();
+    if (g_data_ptr >= g_data_count) { printf("ERROR: OUT OF DATA\n"); return 0.0; }
+    return g_data_nums[g_data_ptr++];
 }
 
 static void dump_vars(void) {
     int i; for (i = 0; i < g_var_count; i++) {
-        if (g_vars[i].type == VT_STR) printf("%s$ = \"%s\"\n", g_vars[i].name, g_vars[i].str ? g_vars[i].str : "");
-        else printf("%s = %.15g\n", g_vars[i].name, g_vars[i].num);
+        if (g_var_type[i] == VT_STR) printf("%s$ = \"%s\"\n", g_var_name[i], bstr_ptr(&g_var_str[i]));
+        else if (g_var_type[i] == VT_INT) printf("%s = %lld\n", g_var_name[i], g_var_int[i]);
+        else printf("%s = %.15g\n", g_var_name[i], g_var_num[i]);
     }
 }
 static void dump_arrays(void) {
@@ -129,7 +138,7 @@ static void dump_arrays(void) {
         size_t total = 1; int d; for (d = 0; d < g_arrays[i].ndims; d++) total *= g_arrays[i].dims[d];
         printf("%s(", g_arrays[i].name);
         for (d = 0; d < g_arrays[i].ndims; d++) { printf("%d%s", g_arrays[i].dims[d], d + 1 < g_arrays[i].ndims ? "," : ""); }
-        printf(") total=%zu\n", total);
+        printf(") total=%zu%s\n", total, g_arrays[i].idata ? " (integer)" : "");
     }
     for (i = 0; i < g_sarray_count; i++) {
         size_t total = 1; int d; for (d = 0; d < g_sarrays[i].ndims; d++) total *= g_sarrays[i].dims[d];
@@ -138,12 +147,13 @@ static void dump_arrays(void) {
         printf(") total=%zu (string)\n", total);
     }
 }
+static int pc_line(int pc) { return PC_INDEX(pc) < g_prog_count ? g_prog[PC_INDEX(pc)].number : -1; }
 static void dump_stack(void) {
     int k; printf("FOR stack depth=%d\n", g_for_top);
-    for (k = g_for_top - 1; k >= 0; k--) printf("  FOR %s to %.15g step %.15g (after=%d)\n",
-        g_for_stack[k].var, g_for_stack[k].end, g_for_stack[k].step, g_for_stack[k].afterForLine);
+    for (k = g_for_top - 1; k >= 0; k--) printf("  FOR %s to %.15g step %.15g (after=%d:%d)\n",
+        g_for_stack[k].var, g_for_stack[k].end, g_for_stack[k].step, pc_line(g_for_stack[k].body), PC_SEG(g_for_stack[k].body));
     printf("GOSUB stack depth=%d\n", g_gosub_top);
-    for (k = g_gosub_top - 1; k >= 0; k--) printf("  return to line %d\n", g_gosub_stack[k]);
+    for (k = g_gosub_top - 1; k >= 0; k--) printf("  return to line %d:%d\n", pc_line(g_gosub_stack[k]), PC_SEG(g_gosub_stack[k]));
 }
 
 /* ------- RENUM support ------- */
@@ -161,25 +171,30 @@ static char* renum_rewrite_stmt(const char* src, const int* oldL, const int* new
     int expectLineNum = 0; /* 1 if last emitted token was THEN/GOTO/GOSUB */
     lx_init(&lx, src); lx_next(&lx);
 
-    /* helper: append a token-sized string with a leading space if needed */
-#define APPEND_STR(S) do{ \
-        const char*_s=(S); size_t _len=strlen(_s); \
-        if(oi && oi<sizeof(outbuf)-1 && outbuf[oi-1]!=' ' && outbuf[oi-1]!=',' && outbuf[oi-1]!='(') { outbuf[oi++]=' '; } \
+    /* helpers: append a token-sized string with a leading space if needed; raw spans
+       (token texts scanned from src are not NUL-terminated) are appended as is */
+#define APPEND_RAW(S, N) do{ \
+        const char*_s=(S); size_t _len=(N); \
         if(oi+_len>=sizeof(outbuf)) _len = sizeof(outbuf)-1-oi; \
         memcpy(outbuf+oi,_s,_len); oi+=_len; outbuf[oi]=0; \
     }while(0)
+#define APPEND_SPAN(S, N) do{ \
+        if(oi && oi<sizeof(outbuf)-1 && outbuf[oi-1]!=' ' && outbuf[oi-1]!=',' && outbuf[oi-1]!='(') { outbuf[oi++]=' '; } \
+        APPEND_RAW(S, N); \
+    }while(0)
+#define APPEND_STR(S) APPEND_SPAN(S, strlen(S))
 
     outbuf[0] = 0;
     while (lx.cur.type != T_END) {
         switch (lx.cur.type) {
         case T_STRING: {
-            char tmp[140];
-            _snprintf(tmp, sizeof(tmp), "\"%s\"", lx.cur.text);
-            APPEND_STR(tmp);
+            APPEND_STR("\"");
+            APPEND_RAW(lx.cur.text, (size_t)lx.cur.len);
+            APPEND_RAW("\"", 1);
             lx_next(&lx);
         } break;
         case T_IDENT: {
-            APPEND_STR(lx.cur.text);
+            APPEND_SPAN(lx.cur.text, (size_t)lx.cur.len);
             lx_next(&lx);
         } break;
         case T_NUMBER: {
@@ -216,61 +231,54 @@ static char* renum_rewrite_stmt(const char* src, const int* oldL, const int* new
  
 // #endif // TEST
 #undef APPEND_STR
+#undef APPEND_SPAN
+#undef APPEND_RAW
 	return strdup_c(outbuf);
 }
 /* ===== Variable helper implementations (minimal) =====
    These provide simple creation/assignment for numeric and string vars.
    They rely on:
-	 - Variable { name[], int type; double num; char* str; }  (from runtime.h)
+	 - the g_var_* slot arrays (from runtime.h)
 	 - VT_NUM / VT_STR enum values
-	 - ensure_var(const char* name, int isString) -> Variable*
+	 - ensure_var(const char* name, int isString) -> slot, -1 when the table is full
 */
 
-static char* dup_cstr(const char* s) {
-	if (!s) s = "";
-	size_t n = strlen(s) + 1;
-	char* p = (char*)malloc(n);
-	if (p) memcpy(p, s, n);
-	return p;
-}
-
-Variable* create_string_var(const char* name) {
+int create_string_var(const char* name) {
 	/* ensure var exists and is marked as string */
-	Variable* v = ensure_var(name, 1);
-	if (!v) return NULL;
-	if (v->type != VT_STR) {
-		if (v->str) { free(v->str); v->str = NULL; }
-		v->type = VT_STR;
-	}
-	if (!v->str) { v->str = dup_cstr(""); }
+	int v = ensure_var(name, 1);
+	if (v < 0) return -1;
 	return v;
 }
 
-void set_string_var(Variable* v, const char* s) {
-	if (!v) return;
-	if (v->type != VT_STR) {
-		if (v->str) { free(v->str); v->str = NULL; }
-		v->type = VT_STR;
-	}
-	if (v->str) { free(v->str); v->str = NULL; }
-	v->str = dup_cstr(s);
+void set_string_var(int v, const char* s) {
+	var_set_str(v, s);
 }
 
-Variable* create_numeric_var(const char* name) {
-	/* ensure var exists and is marked as numeric */
-	Variable* v = ensure_var(name, 0);
-	if (!v) return NULL;
-	v->type = VT_NUM;
-	v->num = 0.0;
-	if (v->str) { free(v->str); v->str = NULL; }
+int create_numeric_var(const char* name) {
+	/* ensure var exists and is marked as numeric (VT_INT for integer names) */
+	int v = ensure_var(name, 0);
+	if (v < 0) return -1;
+	g_var_num[v] = 0.0;
+	g_var_int[v] = 0;
+	bstr_free(&g_var_str[v]);
 	return v;
 }
 
-void set_numeric_var(Variable* v, double val) {
-	if (!v) return;
-	v->type = VT_NUM;
-	v->num = val;
-	if (v->str) { free(v->str); v->str = NULL; }
+int set_numeric_var(int v, double val) {
+	if (v < 0) return -1;
+	bstr_free(&g_var_str[v]);
+	return var_set_num(v, val);
+}
+
+/* store a string Value; a whole variable or element shares its buffer (A$ = B$) */
+static void store_str_var(int v, const Value* sv) {
+	if (sv->src) var_copy_str(v, sv->src);
+	else var_set_strn(v, sv->s, sv->len);
+}
+
+static void store_str_elem(SArray* sa, int* subs, int nsubs, const Value* sv) {
+	if (sv->src) sarray_copy(sa, subs, nsubs, sv->src);
+	else sarray_setn(sa, subs, nsubs, sv->s, sv->len);
 }
 
 
@@ -314,66 +322,39 @@ static int exec_assignment(Lexer* lx) {
 	lx_next(lx);
 
 	if (isStr) {
-		/* Minimal RHS: string literal or string var/array; otherwise numeric->string */
-		const char* ssrc = NULL;
-		char tmp[1024]; tmp[0] = 0;
-
-		if (lx->cur.type == T_STRING) { ssrc = lx->cur.text; lx_next(lx); }
-		else if (lx->cur.type == T_IDENT && is_string_var_name(lx->cur.text)) {
-			/* copy from existing string var/array element */
-			char rhsn[64]; strncpy(rhsn, lx->cur.text, sizeof(rhsn) - 1); rhsn[sizeof(rhsn) - 1] = 0; lx_next(lx);
-			if (lx->cur.type == T_LPAREN) {
-				int rsubs[MAX_DIMS], rn = 0; SArray* sa = sarray_find(rhsn);
-				lx_next(lx);
-				while (lx->cur.type != T_RPAREN && lx->cur.type != T_END) {
-					if (rn >= MAX_DIMS) { printf("ERROR: TOO MANY SUBSCRIPTS\n"); return -1; }
-					rsubs[rn++] = (int)parse_rel(lx);
-					if (lx->cur.type == T_COMMA) { lx_next(lx); continue; }
-					else break;
-				}
-				if (lx->cur.type == T_RPAREN) lx_next(lx);
-				ssrc = sa ? sarray_get(sa, rsubs, rn) : "";
-			}
-			else {
-				Variable* rv = find_var(rhsn);
-				ssrc = (rv && rv->type == VT_STR && rv->str) ? rv->str : "";
-			}
-		}
-		else {
-			/* fallback: numeric expr -> string */
-			double v = parse_rel(lx);
-#ifdef _MSC_VER
-			_snprintf(tmp, sizeof(tmp), "%.15g", v);
-#else
-			snprintf(tmp, sizeof(tmp), "%.15g", v);
-#endif
-			ssrc = tmp;
-		}
+		/* any expression; a number is stored as its %.15g text */
+		Value sv;
+		parse_value(lx, &sv);
+		val_text(&sv);
 
 		if (isArray) {
 			SArray* sa = sarray_find(name);
-			if (!sa) { printf("ERROR: UNDIM'D STRING ARRAY %s\n", name); return -1; }
-			sarray_set(sa, subs, nsubs, ssrc);
+			if (!sa) { val_free(&sv); printf("ERROR: UNDIM'D STRING ARRAY %s\n", name); return -1; }
+			store_str_elem(sa, subs, nsubs, &sv);
 		}
 		else {
-			Variable* v = find_var(name);
-			if (!v) { v = create_string_var(name); }           /* use your own creator */
-			set_string_var(v, ssrc);                         /* or inline: free/strdup into v->str, set v->type=VT_STR */
+			int v = find_var(name);
+			if (v < 0) { v = create_string_var(name); }       /* use your own creator */
+			store_str_var(v, &sv);
 		}
+		val_free(&sv);
 		return 0;
 	}
 	else {
-		double val = parse_rel(lx);
+		BasInt ival; double val;
+		int exact = parse_int(lx, &ival, &val);
 
 		if (isArray) {
 			Array* a = array_find(name);
 			if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
-			array_set(a, subs, nsubs, val);
+			if (exact) array_set_int(a, subs, nsubs, ival);
+			else array_set(a, subs, nsubs, val);
 		}
 		else {
-			Variable* v = find_var(name);
-			if (!v) { v = create_numeric_var(name); }          /* use your own creator */
-			set_numeric_var(v, val);                         /* or inline: v->type=VT_NUM; v->num=val; free v->str if any */
+			int v = find_var(name);
+			if (v < 0) { v = create_numeric_var(name); }      /* use your own creator */
+			if (v >= 0 && exact) { bstr_free(&g_var_str[v]); var_set_int(v, ival); }
+			else if (set_numeric_var(v, val) < 0) return -1;      /* or inline: var_set_num, free the string if any */
 		}
 		return 0;
 	}
@@ -391,8 +372,171 @@ double fn_eof(int fileno) {
 	return 0;
 }
 
+/* ----- control-stack helpers (shared with the compiled-statement executor) ----- */
+
+/* PC a frame pushed now resumes at: the statement after the running one. Immediate
+   statements have no PC and resume at the program line after currentLine. */
+static int pc_after_current(int currentLine) {
+	int i;
+	if (g_pc_index >= 0) return prog_pc_after(g_pc_index, g_pc_seg);
+	i = find_prog_index_by_line(next_line_number_after(currentLine));
+	return i >= 0 ? PC_MAKE(i, 0) : -1;
+}
+
+/* Push the GOSUB return PC for a call made from currentLine. Returns 0 or -1 on error. */
+int gosub_push(int currentLine) {
+	int ret = pc_after_current(currentLine);
+	if (ret < 0) { printf("ERROR: GOSUB at last line\n"); return -1; }
+	if (g_gosub_top >= MAX_STACK) { printf("ERROR: GOSUB stack overflow\n"); return -1; }
+	g_gosub_stack[g_gosub_top++] = ret;
+	return 0;
+}
+
+/* RETURN: 3 with the PC to resume at in *outJump, or -1. */
+int gosub_return(int* outJump) {
+	if (g_gosub_top <= 0) { printf("ERROR: RETURN without GOSUB\n"); return -1; }
+	*outJump = g_gosub_stack[--g_gosub_top];
+	return 3;
+}
+
+/* Integer FOR loops count in BasInt: the step is truncated and the limit rounded toward
+   the start (floor going up, ceil going down), so the integer compare stops where
+   comparing against toVal would. Returns 0 or -1 (reported). */
+int for_int_bounds(double toVal, double step, BasInt* iend, BasInt* istep) {
+	double lim = step >= 0 ? floor(toVal) : ceil(toVal);
+	if (lim != lim) *iend = step >= 0 ? LLONG_MIN : LLONG_MAX;   /* NaN: the first NEXT ends the loop */
+	else if (lim >= 9223372036854775808.0) *iend = LLONG_MAX;
+	else if (lim < -9223372036854775808.0) *iend = LLONG_MIN;
+	else *iend = (BasInt)lim;
+	return num_to_int(step, istep);
+}
+
+/* NEXT on an integer loop variable: 1 loop again, 0 done, -1 overflow (reported) */
+int for_int_next(BasInt* var, BasInt iend, BasInt istep) {
+	BasInt cur = *var;
+	if (istep >= 0 ? cur > LLONG_MAX - istep : cur < LLONG_MIN - istep) { printf("ERROR: INTEGER OVERFLOW\n"); return -1; }
+	*var = cur += istep;
+	return (istep >= 0) ? (cur <= iend) : (cur >= iend);
+}
+
+/* FOR <vname> = start TO toVal STEP step, executed on currentLine. Returns 0 or -1 on error. */
+int for_push(const char* vname, double start, double toVal, double step, int currentLine) {
+	int body, v = ensure_var(vname, 0);
+	ForFrame* fr;
+	if (v < 0) { printf("ERROR: VARIABLE TABLE FULL\n"); return -1; }
+	if (var_set_num(v, start) < 0) return -1;
+	body = pc_after_current(currentLine);
+	if (body < 0) { printf("ERROR: FOR cannot be last line\n"); return -1; }
+	if (g_for_top >= MAX_STACK) { printf("ERROR: FOR stack overflow\n"); return -1; }
+	fr = &g_for_stack[g_for_top];
+	strncpy(fr->var, vname, sizeof(fr->var) - 1);
+	fr->var[sizeof(fr->var) - 1] = 0;
+	fr->end = toVal; fr->step = step;
+	fr->body = body; fr->forLine = currentLine;
+	fr->trips = 0;
+	fr->isint = g_var_type[v] == VT_INT;
+	if (fr->isint && for_int_bounds(toVal, step, &fr->iend, &fr->istep) < 0) return -1;
+	g_for_top++; return 0;
+}
+
+/* NEXT [vname] (vname NULL = innermost loop). Returns 3 (loop again, body PC in *outJump), 0 (done) or -1. */
+int for_next(const char* vname, int* outJump) {
+	int idx = g_for_top - 1;
+	if (vname) {
+		int k; for (k = g_for_top - 1; k >= 0; k--) { if (_stricmp(g_for_stack[k].var, vname) == 0) { idx = k; break; } }
+		if (k < 0) { printf("ERROR: NEXT for unknown FOR var\n"); return -1; }
+	}
+	if (idx < 0) { printf("ERROR: NEXT without FOR\n"); return -1; }
+	{
+		ForFrame fr = g_for_stack[idx]; int v = ensure_var(fr.var, 0), cont;
+		if (v < 0) { printf("ERROR: VARIABLE TABLE FULL\n"); return -1; }
+		if (fr.isint && g_var_type[v] == VT_INT) {
+			if ((cont = for_int_next(&g_var_int[v], fr.iend, fr.istep)) < 0) return -1;
+		}
+		else {
+			double cur = var_value(v) + fr.step; cont = (fr.step >= 0) ? (cur <= fr.end) : (cur >= fr.end);
+			if (var_set_num(v, cur) < 0) return -1;
+		}
+		if (cont) { g_for_stack[idx].trips++; *outJump = fr.body; return 3; }
+		else { int m; for (m = idx; m < g_for_top - 1; m++) g_for_stack[m] = g_for_stack[m + 1]; g_for_top--; return 0; }
+	}
+}
+
+/* ON n GOTO/GOSUB lines[0..count-1]: out-of-range n falls through (returns 0). */
+int on_jump(int n, int isGosub, const int* lines, int count, int currentLine, int* outJump) {
+	if (n >= 1 && n <= count) {
+		int target = lines[n - 1];
+		if (isGosub && gosub_push(currentLine) < 0) return -1;
+		*outJump = target;
+		return 1;
+	}
+	return 0;
+}
+
+/* DIM one numeric or string array. Returns 0 or -1 on error. */
+int dim_array(const char* name, int nd, int* dims) {
+	if (is_string_var_name(name)) {
+		if (!sarray_dim(name, nd, dims)) return -1;
+	}
+	else {
+		if (!array_dim(name, nd, dims)) return -1;
+	}
+	return 0;
+}
+
+/* READ the next DATA item into a scalar (nsubs < 0) or an array element. Returns 0 or -1. */
+int read_into(const char* name, int* subs, int nsubs) {
+	int isStr = is_string_var_name(name);
+	if (nsubs >= 0) {
+		if (isStr) {
+			SArray* sa = sarray_find(name);
+			if (!sa) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
+			sarray_set(sa, subs, nsubs, data_next_string());
+		}
+		else {
+			Array* a = array_find(name);
+			if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
+			array_set(a, subs, nsubs, data_next_number());
+		}
+	}
+	else if (isStr) {
+		int v = ensure_var(name, 1);
+		if (v < 0) return -1;
+		var_set_str(v, data_next_string());
+	}
+	else {
+		int v = ensure_var(name, 0);
+		if (v < 0) return -1;
+		if (var_set_num(v, data_next_number()) < 0) return -1;
+	}
+	return 0;
+}
+
+/* RESTORE [line] (line < 0: from the top) */
+void restore_data(int line) {
+	data_maybe_rebuild();   /* if never built or program changed, build now */
+	if (line >= 0) data_restore_at_line(line);
+	else data_restore();
+}
+
+/* OPEN fname FOR INPUT(0)|OUTPUT(1)|APPEND(2) AS #handle. Returns 0 or -1. */
+int open_file(const char* fname, int mode, int handle) {
+	FILE* fp;
+	if (handle < 0 || handle >= MAX_FILES) { printf("ERROR: handle out of range\n"); return -1; }
+	if (g_files[handle].used) { printf("ERROR: handle already open\n"); return -1; }
+	if (mode == 0) fp = fopen(fname, "rb"); else if (mode == 1) fp = fopen(fname, "wb"); else fp = fopen(fname, "ab");
+	if (!fp) { printf("ERROR: cannot open file\n"); return -1; }
+	g_files[handle].used = 1; g_files[handle].fp = fp; return 0;
+}
+
+/* CLOSE #handle (handle < 0: close all) */
+void close_file(int handle) {
+	if (handle < 0) { files_clear(); return; }
+	if (handle < MAX_FILES && g_files[handle].used) { fclose(g_files[handle].fp); g_files[handle].used = 0; g_files[handle].fp = NULL; }
+}
+
 /* Helper for IF THEN/ELSE single statement execution */
-static int run_if_single_stmt(Lexer* plx, int currentLine, int* outJump) {
+int run_if_single_stmt(Lexer* plx, int currentLine, int* outJump) {
 	/* THEN <line> */
 	if (plx->cur.type == T_NUMBER) {
 		*outJump = (int)plx->cur.number;
@@ -410,21 +554,12 @@ static int run_if_single_stmt(Lexer* plx, int currentLine, int* outJump) {
 	}
 	/* THEN GOSUB <line> */
 	if (plx->cur.type == T_GOSUB) {
-		int nextLine = next_line_number_after(currentLine);
 		lx_next(plx);
 		if (plx->cur.type != T_NUMBER) {
 			printf("ERROR: line number expected\n");
 			return -1;
 		}
-		if (nextLine < 0) {
-			printf("ERROR: GOSUB at last line\n");
-			return -1;
-		}
-		if (g_gosub_top >= MAX_STACK) {
-			printf("ERROR: GOSUB stack overflow\n");
-			return -1;
-		}
-		g_gosub_stack[g_gosub_top++] = nextLine;
+		if (gosub_push(currentLine) < 0) return -1;
 		*outJump = (int)plx->cur.number;
 		return 1;
 	}
@@ -442,722 +577,622 @@ static int run_if_single_stmt(Lexer* plx, int currentLine, int* outJump) {
 }
 
 
-/* ----------------- executor ----------------- */
-int exec_statement(const char* src, int duringRun, int currentLine, int* outJump)
+/* ----------------- statement handlers -----------------
+   Each runs one statement whose first token is current; same return codes as exec_statement. */
+/* REM, DATA */
+static int st_ignore(Lexer* lx, int duringRun, int currentLine, int* outJump)
 {
-	Lexer lx;
-	lx_init(&lx, src);
-	lx_next(&lx);
-
-	if (lx.cur.type == T_REM) return 0;
-	if (lx.cur.type == T_DATA) return 0;
+	return 0;
+}
 
-	if (lx.cur.type == T_BYE) {
-		if (duringRun) { printf("ERROR: BYE not allowed during RUN\n"); return -1; }
-		exit(0);
-	}
+static int st_bye(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	if (duringRun) { printf("ERROR: BYE not allowed during RUN\n"); return -1; }
+	exit(0);
+}
 
-	/* Example: handle NEW command */
-	if (lx.cur.type == T_NEW) {
-		prog_clear();
-		vars_clear();
-		arrays_clear();
-		sarrays_clear();
-		g_for_top = 0;
-		g_gosub_top = 0;
-		files_clear();
-		data_clear();
-		data_mark_dirty();    /* program is empty now; table is stale */
-		printf("NEW PROGRAM\n");
-		return 0;
-	}
+static int st_new(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	prog_clear();
+	prof_source(NULL);
+	vars_clear();
+	g_defint = 0;
+	arrays_clear();
+	sarrays_clear();
+	g_for_top = 0;
+	g_gosub_top = 0;
+	files_clear();
+	data_clear();
+	data_mark_dirty();    /* program is empty now; table is stale */
+	printf("NEW PROGRAM\n");
+	return 0;
+}
 
-	/* ON <expr> GOTO <l1>[,l2,...]   or   ON <expr> GOSUB <l1>[,l2,...] */
 /* ON <expr> GOTO l1[,l2,...]   |   ON <expr> GOSUB l1[,l2,...] */
-	if (lx.cur.type == T_ONKW) {
-		lx_next(&lx);
-		int n = (int)parse_rel(&lx);  // 1-based index
-		int is_gosub = 0;
-
-		if (lx.cur.type == T_GOTO) { is_gosub = 0; lx_next(&lx); }
-		else if (lx.cur.type == T_GOSUB) { is_gosub = 1; lx_next(&lx); }
-		else { printf("ERROR: expected GOTO or GOSUB\n"); return -1; }
-
-		int lines[64], count = 0;
-		while (lx.cur.type == T_NUMBER && count < (int)(sizeof(lines) / sizeof(lines[0]))) {
-			lines[count++] = (int)lx.cur.number;
-			lx_next(&lx);
-			if (lx.cur.type == T_COMMA) { lx_next(&lx); continue; }
-			else break;
-		}
-		if (count == 0) { printf("ERROR: line list expected\n"); return -1; }
-
-		if (n >= 1 && n <= count) {
-			int target = lines[n - 1];
-			if (is_gosub) {
-				int nextLine = next_line_number_after(currentLine);
-				if (nextLine < 0) { printf("ERROR: GOSUB at last line\n"); return -1; }
-				if (g_gosub_top >= MAX_STACK) { printf("ERROR: GOSUB stack overflow\n"); return -1; }
-				g_gosub_stack[g_gosub_top++] = nextLine;
-			}
-			*outJump = target;
-			return 1;
-		}
-		return 0; // out-of-range index -> no jump
+static int st_on(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	lx_next(lx);
+	int n = (int)parse_rel(lx);  // 1-based index
+	int is_gosub = 0;
+
+	if (lx->cur.type == T_GOTO) { is_gosub = 0; lx_next(lx); }
+	else if (lx->cur.type == T_GOSUB) { is_gosub = 1; lx_next(lx); }
+	else { printf("ERROR: expected GOTO or GOSUB\n"); return -1; }
+
+	int lines[64], count = 0;
+	while (lx->cur.type == T_NUMBER && count < (int)(sizeof(lines) / sizeof(lines[0]))) {
+		lines[count++] = (int)lx->cur.number;
+		lx_next(lx);
+		if (lx->cur.type == T_COMMA) { lx_next(lx); continue; }
+		else break;
 	}
+	if (count == 0) { printf("ERROR: line list expected\n"); return -1; }
 
-	if (lx.cur.type == T_HELP) {
-		lx_next(&lx);   /* no args */
-		print_help();
-		return 0;
-	}
+	return on_jump(n, is_gosub, lines, count, currentLine, outJump); // out-of-range index -> no jump
+}
 
-	if (lx.cur.type == T_DUMP) {
-		// Save current lexer
-		Lexer lxSave;
-		lxSave.i = lx.i;
-		lxSave.s = lx.s;
-		lxSave.cur.number = lx.cur.number;
-		strcpy(lxSave.cur.text, lx.cur.text);
-		lxSave.cur.type = lx.cur.type;
-
-		lx_next(&lx);
-		if (lx.cur.type == T_VARS) { dump_vars();   return 0; }
-		if (lx.cur.type == T_ARRAYS) { dump_arrays(); return 0; }
-		if (lx.cur.type == T_STACK) { dump_stack();  return 0; }
-		// printf("ERROR: DUMP VARS|ARRAYS|STACK\n"); return -1;
-		// Restore prev lx
-		lx.i = lxSave.i;
-		lx.s = lxSave.s;
-		lx.cur.number = lxSave.cur.number;
-		strcpy(lx.cur.text, lxSave.cur.text);
-		lx.cur.type = T_PRINT;
-	}
+static int st_help(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	lx_next(lx);   /* no args */
+	print_help();
+	return 0;
+}
 
-	/* LIST [start [end]] */
-	if (lx.cur.type == T_LIST) {
-		Token a; lx_next(&lx); a = lx.cur;
-		if (a.type == T_END) { cmd_list(0, 0, 0, 0); return 0; }
-		if (a.type == T_NUMBER) {
-			int start = (int)a.number; Token b; lx_next(&lx); b = lx.cur;
-			if (b.type == T_NUMBER) { int end = (int)b.number; cmd_list(1, start, 1, end); return 0; }
-			cmd_list(1, start, 0, 0); return 0;
-		}
-		printf("ERROR: LIST syntax\n"); return -1;
+/* DUMP VARS|ARRAYS|STACK */
+static int st_dump(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	// Save current lexer
+	Lexer lxSave;
+	lxSave.i = lx->i;
+	lxSave.s = lx->s;
+	lxSave.cur.number = lx->cur.number;
+	lxSave.cur.text = lx->cur.text;
+	lxSave.cur.len = lx->cur.len;
+	lxSave.cur.type = lx->cur.type;
+	lxSave.tk = lx->tk;
+
+	lx_next(lx);
+	if (lx->cur.type == T_VARS) { dump_vars();   return 0; }
+	if (lx->cur.type == T_ARRAYS) { dump_arrays(); return 0; }
+	if (lx->cur.type == T_STACK) { dump_stack();  return 0; }
+	// printf("ERROR: DUMP VARS|ARRAYS|STACK\n"); return -1;
+	// Restore prev lx
+	lx->i = lxSave.i;
+	lx->s = lxSave.s;
+	lx->tk = lxSave.tk;
+	lx->cur.number = lxSave.cur.number;
+	lx->cur.text = lxSave.cur.text;
+	lx->cur.len = lxSave.cur.len;
+	lx->cur.type = T_PRINT;
+	return exec_print(lx);   /* not VARS/ARRAYS/STACK: print the rest */
+}
+
+/* LIST [start [end]] */
+static int st_list(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	Token a; lx_next(lx); a = lx->cur;
+	if (a.type == T_END) { cmd_list(0, 0, 0, 0); return 0; }
+	if (a.type == T_NUMBER) {
+		int start = (int)a.number; Token b; lx_next(lx); b = lx->cur;
+		if (b.type == T_NUMBER) { int end = (int)b.number; cmd_list(1, start, 1, end); return 0; }
+		cmd_list(1, start, 0, 0); return 0;
 	}
+	printf("ERROR: LIST syntax\n"); return -1;
+}
 
-	/* program SAVE/LOAD */
-	if (lx.cur.type == T_SAVE || lx.cur.type == T_LOAD)
-	{
-		int isLoad = (lx.cur.type == T_LOAD);
-		char fname[260]; fname[0] = 0;
-		if (!read_filename_after(&lx, fname, sizeof(fname))) { printf("ERROR: filename\n"); return -1; }
-		if (isLoad) {
-			FILE* f = fopen(fname, "rb"); char linebuf[1024]; int ln;
-			if (!f) { printf("ERROR: cannot open file\n"); return -1; }
-			prog_clear();
-			while (fscanf(f, "%d", &ln) == 1) {
-				if (fgets(linebuf, sizeof(linebuf), f)) { char* p = linebuf; if (*p == ' ') p++; trim(p); prog_set_line(ln, p); }
-			}
-			fclose(f); printf("Loaded %s (%d lines)\n", fname, g_prog_count); return 0;
-			data_rebuild_from_program();   /* program just changed -> rebuild DATA table */
-		}
-		else {
-			FILE* f = fopen(fname, "wb"); int i; if (!f) { printf("ERROR: cannot write file %s\n", fname); return -1; }
-			sort_program(); for (i = 0; i < g_prog_count; i++) fprintf(f, "%d %s\n", g_prog[i].number, g_prog[i].text);
-			fclose(f); printf("Saved to %s\n", fname); return 0;
+/* program SAVE/LOAD */
+static int st_save_load(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	int isLoad = (lx->cur.type == T_LOAD);
+	char fname[260]; fname[0] = 0;
+	if (!read_filename_after(lx, fname, sizeof(fname))) { printf("ERROR: filename\n"); return -1; }
+	if (isLoad) {
+		FILE* f = fopen(fname, "rb"); char linebuf[1024]; int ln;
+		if (!f) { printf("ERROR: cannot open file\n"); return -1; }
+		prog_clear();
+		while (fscanf(f, "%d", &ln) == 1) {
+			if (fgets(linebuf, sizeof(linebuf), f)) { char* p = linebuf; if (*p == ' ') p++; trim(p); prog_set_line(ln, p); }
 		}
+		fclose(f); prof_source(fname); printf("Loaded %s (%d lines)\n", fname, g_prog_count); return 0;
+		data_rebuild_from_program();   /* program just changed -> rebuild DATA table */
 	}
+	else {
+		FILE* f = fopen(fname, "wb"); int i; if (!f) { printf("ERROR: cannot write file %s\n", fname); return -1; }
+		sort_program(); for (i = 0; i < g_prog_count; i++) fprintf(f, "%d %s\n", g_prog[i].number, g_prog[i].text);
+		fclose(f); printf("Saved to %s\n", fname); return 0;
+	}
+}
 
-	/* SAVEVARS / LOADVARS (scalars only, as before) */
-	if (lx.cur.type == T_SAVEVARS || lx.cur.type == T_LOADVARS) {
-		int isLoad = (lx.cur.type == T_LOADVARS); char fname[260]; fname[0] = 0;
-		if (!read_filename_after(&lx, fname, sizeof(fname))) { printf("ERROR: filename\n"); return -1; }
-		if (isLoad) {
-			FILE* f = fopen(fname, "rb"); char line[512];
-			if (!f) { printf("ERROR: cannot open file: %s\n", fname); return -1; }
-			vars_clear();
-			while (fgets(line, sizeof(line), f)) {
-				char* name = strtok(line, "\t\r\n");
-				char* type = strtok(NULL, "\t\r\n");
-				char* val = strtok(NULL, "\r\n");
-				if (name && type && val) {
-					Variable* v = ensure_var(name, (type[0] == 'S'));
-					if (v->type == VT_STR) { if (v->str) free(v->str); v->str = strdup_c(val); }
-					else v->num = atof(val);
-				}
+/* SAVEVARS / LOADVARS (scalars only, as before) */
+static int st_save_load_vars(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	int isLoad = (lx->cur.type == T_LOADVARS); char fname[260]; fname[0] = 0;
+	if (!read_filename_after(lx, fname, sizeof(fname))) { printf("ERROR: filename\n"); return -1; }
+	if (isLoad) {
+		FILE* f = fopen(fname, "rb"); char line[512];
+		if (!f) { printf("ERROR: cannot open file: %s\n", fname); return -1; }
+		vars_clear();
+		while (fgets(line, sizeof(line), f)) {
+			char* name = strtok(line, "\t\r\n");
+			char* type = strtok(NULL, "\t\r\n");
+			char* val = strtok(NULL, "\r\n");
+			if (name && type && val) {
+				int v = ensure_var(name, (type[0] == 'S'));
+				if (v < 0) break;
+				if (g_var_type[v] == VT_STR) var_set_str(v, val);
+				else var_set_num(v, atof(val));
 			}
-			fclose(f); printf("Variables loaded from %s (%d)\n", fname, g_var_count); return 0;
 		}
-		else {
-			FILE* f = fopen(fname, "wb"); int i; if (!f) { printf("ERROR: cannot write file\n"); return -1; }
-			for (i = 0; i < g_var_count; i++) {
-				if (g_vars[i].type == VT_STR) fprintf(f, "%s\tS\t%s\n", g_vars[i].name, g_vars[i].str ? g_vars[i].str : "");
-				else fprintf(f, "%s\tN\t%.15g\n", g_vars[i].name, g_vars[i].num);
-			}
-			fclose(f); printf("Variables saved to %s\n", fname); return 0;
+		fclose(f); printf("Variables loaded from %s (%d)\n", fname, g_var_count); return 0;
+	}
+	else {
+		FILE* f = fopen(fname, "wb"); int i; if (!f) { printf("ERROR: cannot write file\n"); return -1; }
+		for (i = 0; i < g_var_count; i++) {
+			if (g_var_type[i] == VT_STR) fprintf(f, "%s\tS\t%s\n", g_var_name[i], bstr_ptr(&g_var_str[i]));
+			else if (g_var_type[i] == VT_INT) fprintf(f, "%s\tN\t%lld\n", g_var_name[i], g_var_int[i]);
+			else fprintf(f, "%s\tN\t%.15g\n", g_var_name[i], g_var_num[i]);
 		}
+		fclose(f); printf("Variables saved to %s\n", fname); return 0;
 	}
+}
 
-	/* FILE I/O */
-	if (lx.cur.type == T_OPEN) {
-		char fname[260]; fname[0] = 0; int mode = 0; int handle = -1; FILE* fp;
-		if (!read_filename_after(&lx, fname, sizeof(fname))) { printf("ERROR: OPEN needs filename\n"); return -1; }
-		if (lx.cur.type != T_FOR) { printf("ERROR: OPEN needs FOR\n"); return -1; }
-		lx_next(&lx);
-		if (lx.cur.type == T_INPUT) mode = 0;
-		else if (lx.cur.type == T_OUTPUTKW) mode = 1;
-		else if (lx.cur.type == T_APPEND) mode = 2;
-		else { printf("ERROR: OPEN mode\n"); return -1; }
-		lx_next(&lx);
-		if (lx.cur.type != T_AS) { printf("ERROR: OPEN needs AS\n"); return -1; }
-		lx_next(&lx);
-		if (lx.cur.type == T_HASH) lx_next(&lx);
-		if (lx.cur.type != T_NUMBER) { printf("ERROR: OPEN needs handle number\n"); return -1; }
-		handle = (int)lx.cur.number;
-		if (handle < 0 || handle >= MAX_FILES) { printf("ERROR: handle out of range\n"); return -1; }
-		if (g_files[handle].used) { printf("ERROR: handle already open\n"); return -1; }
-		if (mode == 0) fp = fopen(fname, "rb"); else if (mode == 1) fp = fopen(fname, "wb"); else fp = fopen(fname, "ab");
-		if (!fp) { printf("ERROR: cannot open file\n"); return -1; }
-		g_files[handle].used = 1; g_files[handle].fp = fp; return 0;
-	}
+/* FILE I/O */
+static int st_open(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	char fname[260]; fname[0] = 0; int mode = 0; int handle = -1;
+	if (!read_filename_after(lx, fname, sizeof(fname))) { printf("ERROR: OPEN needs filename\n"); return -1; }
+	lx_next(lx);
+	if (lx->cur.type != T_FOR) { printf("ERROR: OPEN needs FOR\n"); return -1; }
+	lx_next(lx);
+	if (lx->cur.type == T_INPUT) mode = 0;
+	else if (lx->cur.type == T_OUTPUTKW) mode = 1;
+	else if (lx->cur.type == T_APPEND) mode = 2;
+	else { printf("ERROR: OPEN mode\n"); return -1; }
+	lx_next(lx);
+	if (lx->cur.type != T_AS) { printf("ERROR: OPEN needs AS\n"); return -1; }
+	lx_next(lx);
+	if (lx->cur.type == T_HASH) lx_next(lx);
+	if (lx->cur.type != T_NUMBER) { printf("ERROR: OPEN needs handle number\n"); return -1; }
+	handle = (int)lx->cur.number;
+	return open_file(fname, mode, handle);
+}
 
-	if (lx.cur.type == T_CLOSE) {
-		lx_next(&lx);
-		if (lx.cur.type == T_HASH || lx.cur.type == T_NUMBER) {
-			int handle; if (lx.cur.type == T_HASH) lx_next(&lx);
-			if (lx.cur.type != T_NUMBER) { printf("ERROR: CLOSE needs number\n"); return -1; }
-			handle = (int)lx.cur.number;
-			if (handle >= 0 && handle < MAX_FILES && g_files[handle].used) { fclose(g_files[handle].fp); g_files[handle].used = 0; g_files[handle].fp = NULL; }
-		}
-		else { files_clear(); }
-		return 0;
+static int st_close(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	lx_next(lx);
+	if (lx->cur.type == T_HASH || lx->cur.type == T_NUMBER) {
+		int handle; if (lx->cur.type == T_HASH) lx_next(lx);
+		if (lx->cur.type != T_NUMBER) { printf("ERROR: CLOSE needs number\n"); return -1; }
+		handle = (int)lx->cur.number;
+		if (handle >= 0) close_file(handle);
 	}
+	else { close_file(-1); }
+	return 0;
+}
 
-	/* RUN / END */
-	if (lx.cur.type == T_RUN) { return 2; }
+/* RUN / END */
+static int st_run(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	return 2;
+}
 
-	if (lx.cur.type == T_ENDKW || lx.cur.type == T_STOP) { if (duringRun) return 9; printf("OK\n"); return 0; }
+static int st_end(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	if (duringRun) return 9;
+	printf("OK\n");
+	return 0;
+}
 
-	if (lx.cur.type == T_QUIT) {
-		exit(0);  /* terminate the whole app immediately */
-	}
+static int st_quit(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	exit(0);  /* terminate the whole app immediately */
+}
 
-	// RENUM
-	/* RENUM [start [step]]  immediate mode only */
-	if (lx.cur.type == T_RENUM) {
-		if (duringRun) { printf("ERROR: RENUM not allowed during RUN\n"); return -1; }
-
-		/* defaults */
-		int start = 10, step = 10;
-		lx_next(&lx);
-		if (lx.cur.type == T_NUMBER) {
-			start = (int)lx.cur.number; lx_next(&lx);
-			if (lx.cur.type == T_NUMBER) { step = (int)lx.cur.number; lx_next(&lx); }
-		}
+/* RENUM [start [step]] - immediate mode only */
+static int st_renum(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	if (duringRun) { printf("ERROR: RENUM not allowed during RUN\n"); return -1; }
 
-		if (g_prog_count <= 0) { printf("NO PROGRAM\n"); return 0; }
+	/* defaults */
+	int start = 10, step = 10;
+	lx_next(lx);
+	if (lx->cur.type == T_NUMBER) {
+		start = (int)lx->cur.number; lx_next(lx);
+		if (lx->cur.type == T_NUMBER) { step = (int)lx->cur.number; lx_next(lx); }
+	}
 
-		sort_program();
+	if (g_prog_count <= 0) { printf("NO PROGRAM\n"); return 0; }
 
-		/* Build old->new map */
-		int i; int* oldL = (int*)malloc(sizeof(int) * g_prog_count);
-		int* newL = (int*)malloc(sizeof(int) * g_prog_count);
-		if (!oldL || !newL) { printf("ERROR: OUT OF MEMORY\n"); if (oldL)free(oldL); if (newL)free(newL); return -1; }
+	sort_program();
 
-		for (i = 0; i < g_prog_count; i++) {
-			oldL[i] = g_prog[i].number;
-			newL[i] = start + i * step;
-		}
+	/* Build old->new map */
+	int i; int* oldL = (int*)malloc(sizeof(int) * g_prog_count);
+	int* newL = (int*)malloc(sizeof(int) * g_prog_count);
+	if (!oldL || !newL) { printf("ERROR: OUT OF MEMORY\n"); if (oldL)free(oldL); if (newL)free(newL); return -1; }
 
-		/* Rewrite each line's text for THEN/GOTO/GOSUB numeric targets */
-		for (i = 0; i < g_prog_count; i++) {
-			char* re = renum_rewrite_stmt(g_prog[i].text, oldL, newL, g_prog_count);
-			if (re) {
-				free(g_prog[i].text);
-				g_prog[i].text = re;
-			}
-		}
+	for (i = 0; i < g_prog_count; i++) {
+		oldL[i] = g_prog[i].number;
+		newL[i] = start + i * step;
+	}
 
-		/* Apply new line numbers */
-		for (i = 0; i < g_prog_count; i++) {
-			g_prog[i].number = newL[i];
+	/* Rewrite each line's text for THEN/GOTO/GOSUB numeric targets */
+	for (i = 0; i < g_prog_count; i++) {
+		char* re = renum_rewrite_stmt(g_prog[i].text, oldL, newL, g_prog_count);
+		if (re) {
+			free(g_prog[i].text);
+			g_prog[i].text = re;
+			crunch_free(g_prog[i].code);
+			g_prog[i].code = crunch_line(re);
 		}
-
-		free(oldL); free(newL);
-		sort_program();
-		printf("RENUM OK (start=%d, step=%d)\n", start, step);
-		data_mark_dirty();
-		return 0;
 	}
 
-	// PRINT 
-	if (lx.cur.type == T_PRINT) {
-		return exec_print(&lx);
+	/* Apply new line numbers */
+	for (i = 0; i < g_prog_count; i++) {
+		g_prog[i].number = newL[i];
 	}
 
-	/* IF <cond> THEN
-		  <line>
-		| GOTO <line>
-		| GOSUB <line>
-		| <single statement>   (e.g., LET X=1 or X=1 or PRINT ... )
-	*/
-	/* IF <cond> THEN
-		 <line>
-	   | GOTO <line>
-	   | GOSUB <line>
-	   | <single statement>  (PRINT , LET , or <ident>=)
-	*/
-	/* IF <cond> THEN
+	free(oldL); free(newL);
+	sort_program();
+	g_prog_epoch++;
+	printf("RENUM OK (start=%d, step=%d)\n", start, step);
+	data_mark_dirty();
+	return 0;
+}
+
+static int st_print(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	return exec_print(lx);
+}
+
+/* IF <cond> THEN
 	 <line>
    | GOTO <line>
    | GOSUB <line>
    | <single statement>
    [ ELSE <single statement> ]
 */
-	if (lx.cur.type == T_IF) {
-		lx_next(&lx);
-		double cond = parse_rel(&lx);
+static int st_if(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	lx_next(lx);
+	double cond = parse_rel(lx);
 
-		if (lx.cur.type != T_THEN) {
-			printf("ERROR: THEN expected\n");
-			return -1;
+	if (lx->cur.type != T_THEN) {
+		printf("ERROR: THEN expected\n");
+		return -1;
+	}
+	const CrunchTok* thenTk = lx->tk ? lx->tk - 1 : NULL;   /* replaying: the THEN token */
+	lx_next(lx);
+
+	if (cond != 0.0) {
+		/* Run THEN part */
+		int rv = run_if_single_stmt(lx, currentLine, outJump);
+		if (rv != 0) return rv; /* jump or error */
+
+		/* Skip ELSE part if present: one jump when the line was crunched */
+		if (lx->cur.type == T_ELSE) {
+			const CrunchTok* elseTk = lx->tk ? lx->tk - 1 : NULL;
+			if (elseTk) { lx->tk = elseTk + elseTk->skip; lx_next(lx); }
+			else while (lx->cur.type != T_END && !lx_peek_stmt_sep(lx)) lx_next(lx);
 		}
-		lx_next(&lx);
-
-		if (cond != 0.0) {
-			/* Run THEN part */
-			int rv = run_if_single_stmt(&lx, currentLine, outJump);
-			if (rv != 0) return rv; /* jump or error */
-
-			/* Skip ELSE part if present */
-			if (lx.cur.type == T_ELSE) {
-				lx_next(&lx);
-				/* Skip one statement after ELSE */
-				(void)run_if_single_stmt(&lx, currentLine, outJump);
-			}
-			return 0;
+		return 0;
+	}
+	else {
+		/* Skip THEN part: one jump when the line was crunched */
+		if (thenTk) { lx->tk = thenTk + thenTk->skip; lx_next(lx); }
+		else while (lx->cur.type != T_ELSE && lx->cur.type != T_END && !lx_peek_stmt_sep(lx)) {
+			lx_next(lx);
 		}
-		else {
-			/* Skip THEN part */
-			while (lx.cur.type != T_ELSE && lx.cur.type != T_END && !lx_peek_stmt_sep(&lx)) {
-				lx_next(&lx);
-			}
-			if (lx.cur.type == T_ELSE) {
-				lx_next(&lx);
-				return run_if_single_stmt(&lx, currentLine, outJump);
-			}
-			return 0;
+		if (lx->cur.type == T_ELSE) {
+			lx_next(lx);
+			return run_if_single_stmt(lx, currentLine, outJump);
 		}
+		return 0;
 	}
+}
 
+static int st_goto(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	lx_next(lx);
+	if (lx->cur.type != T_NUMBER) { printf("ERROR: GOTO needs line\n"); return -1; }
+	*outJump = (int)lx->cur.number;
+	return 1;
+}
 
-	if (lx.cur.type == T_GOTO) { lx_next(&lx); if (lx.cur.type != T_NUMBER) { printf("ERROR: GOTO needs line\n"); return -1; } *outJump = (int)lx.cur.number; return 1; }
-
-	if (lx.cur.type == T_GOSUB)
-	{
-		int nextLine = next_line_number_after(currentLine); lx_next(&lx);
-		if (lx.cur.type != T_NUMBER) { printf("ERROR: GOSUB needs line\n"); return -1; }
-		if (nextLine < 0) { printf("ERROR: GOSUB at last line\n"); return -1; }
-		if (g_gosub_top >= MAX_STACK) { printf("ERROR: GOSUB stack overflow\n"); return -1; }
-		g_gosub_stack[g_gosub_top++] = nextLine; *outJump = (int)lx.cur.number; return 1;
-	}
+static int st_gosub(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	lx_next(lx);
+	if (lx->cur.type != T_NUMBER) { printf("ERROR: GOSUB needs line\n"); return -1; }
+	if (gosub_push(currentLine) < 0) return -1;
+	*outJump = (int)lx->cur.number; return 1;
+}
 
-	if (lx.cur.type == T_RETURN) { if (g_gosub_top <= 0) { printf("ERROR: RETURN without GOSUB\n"); return -1; } *outJump = g_gosub_stack[--g_gosub_top]; return 1; }
+static int st_return(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	return gosub_return(outJump);
+}
 
-	/* FOR / NEXT */
-	if (lx.cur.type == T_FOR)
-	{
-		char vname[32]; double start, toVal, step = 1.0; int afterFor;
-		lx_next(&lx); if (lx.cur.type != T_IDENT) { printf("ERROR: FOR needs var\n"); return -1; }
-		strncpy(vname, lx.cur.text, sizeof(vname) - 1); vname[sizeof(vname) - 1] = 0;
-		lx_next(&lx); if (lx.cur.type != T_EQ) { printf("ERROR: FOR needs '='\n"); return -1; }
-		lx_next(&lx); start = parse_rel(&lx);
-		if (lx.cur.type != T_TO) { printf("ERROR: FOR needs TO\n"); return -1; }
-		lx_next(&lx); toVal = parse_rel(&lx);
-		if (lx.cur.type == T_STEP) { lx_next(&lx); step = parse_rel(&lx); }
-		ensure_var(vname, 0)->num = start;
-		afterFor = next_line_number_after(currentLine);
-		if (afterFor < 0) { printf("ERROR: FOR cannot be last line\n"); return -1; }
-		if (g_for_top >= MAX_STACK) { printf("ERROR: FOR stack overflow\n"); return -1; }
-		strncpy(g_for_stack[g_for_top].var, vname, sizeof(g_for_stack[g_for_top].var) - 1);
-		g_for_stack[g_for_top].var[sizeof(g_for_stack[g_for_top].var) - 1] = 0;
-		g_for_stack[g_for_top].end = toVal; g_for_stack[g_for_top].step = step;
-		g_for_stack[g_for_top].afterForLine = afterFor; g_for_stack[g_for_top].forLine = currentLine;
-		g_for_top++; return 0;
-	}
+/* FOR / NEXT */
+static int st_for(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	char vname[32]; double start, toVal, step = 1.0;
+	lx_next(lx); if (lx->cur.type != T_IDENT) { printf("ERROR: FOR needs var\n"); return -1; }
+	strncpy(vname, lx->cur.text, sizeof(vname) - 1); vname[sizeof(vname) - 1] = 0;
+	lx_next(lx); if (lx->cur.type != T_EQ) { printf("ERROR: FOR needs '='\n"); return -1; }
+	lx_next(lx); start = parse_rel(lx);
+	if (lx->cur.type != T_TO) { printf("ERROR: FOR needs TO\n"); return -1; }
+	lx_next(lx); toVal = parse_rel(lx);
+	if (lx->cur.type == T_STEP) { lx_next(lx); step = parse_rel(lx); }
+	return for_push(vname, start, toVal, step, currentLine);
+}
 
-	if (lx.cur.type == T_NEXT)
-	{
-		int idx = g_for_top - 1; lx_next(&lx);
-		if (lx.cur.type == T_IDENT) {
-			int k; for (k = g_for_top - 1; k >= 0; k--) { if (_stricmp(g_for_stack[k].var, lx.cur.text) == 0) { idx = k; break; } }
-			if (k < 0) { printf("ERROR: NEXT for unknown FOR var\n"); return -1; }
-		}
-		if (idx < 0) { printf("ERROR: NEXT without FOR\n"); return -1; }
-		{
-			ForFrame fr = g_for_stack[idx]; Variable* v = ensure_var(fr.var, 0);
-			double cur = v->num + fr.step; int cont = (fr.step >= 0) ? (cur <= fr.end) : (cur >= fr.end);
-			v->num = cur; if (cont) { *outJump = fr.afterForLine; return 1; }
-			else { int m; for (m = idx; m < g_for_top - 1; m++) g_for_stack[m] = g_for_stack[m + 1]; g_for_top--; return 0; }
-		}
-	}
+static int st_next(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	lx_next(lx);
+	return for_next(lx->cur.type == T_IDENT ? lx->cur.text : NULL, outJump);
+}
 
-	// TRACE ON/OFF
 /* TRACE ON|OFF */
-	if (lx.cur.type == T_TRACE) {
-		lx_next(&lx);
-		int on = g_trace; // default to ON if omitted
-		
-		if ((lx.cur.type == T_ON) || (lx.cur.type == T_ONKW))
-			on = 1;
-		else if (lx.cur.type == T_OFF)
-			on = 0;
-		else if (lx.cur.type == T_IDENT) {
-			char up[8]; strncpy(up, lx.cur.text, 7); up[7] = 0;
-			for (int i = 0; up[i]; ++i) up[i] = (char)toupper((unsigned char)up[i]);
-			if (!strcmp(up, "ON"))  on = 1;
-			else if (!strcmp(up, "OFF")) on = 0;
-			else { printf("ERROR: TRACE expects ON or OFF\n"); return -1; }
-			lx_next(&lx);
-		}
-		g_trace = on;
-		printf("TRACE %s\n", on ? "ON" : "OFF");
-		return 0;
+static int st_trace(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	lx_next(lx);
+	int on = g_trace; // default to ON if omitted
+	
+	if ((lx->cur.type == T_ON) || (lx->cur.type == T_ONKW))
+		on = 1;
+	else if (lx->cur.type == T_OFF)
+		on = 0;
+	else if (lx->cur.type == T_IDENT) {
+		char up[8]; strncpy(up, lx->cur.text, 7); up[7] = 0;
+		for (int i = 0; up[i]; ++i) up[i] = (char)toupper((unsigned char)up[i]);
+		if (!strcmp(up, "ON"))  on = 1;
+		else if (!strcmp(up, "OFF")) on = 0;
+		else { printf("ERROR: TRACE expects ON or OFF\n"); return -1; }
+		lx_next(lx);
 	}
+	g_trace = on;
+	printf("TRACE %s\n", on ? "ON" : "OFF");
+	return 0;
+}
 
-	/* Handle DIM (numeric + string arrays) */
-	if (lx.cur.type == T_DIM)
-	{
-		for (;;) {
-			char aname[32]; int dims[MAX_DIMS]; int nd = 0;
-			lx_next(&lx);
-			if (lx.cur.type != T_IDENT) { printf("ERROR: DIM needs name\n"); return -1; }
-			strncpy(aname, lx.cur.text, sizeof(aname) - 1); aname[sizeof(aname) - 1] = 0;
-			lx_next(&lx);
-			if (lx.cur.type != T_LPAREN) { printf("ERROR: DIM needs '('\n"); return -1; }
-			lx_next(&lx);
-			while (lx.cur.type != T_RPAREN && lx.cur.type != T_END) {
-				if (nd >= MAX_DIMS) { printf("ERROR: > %d DIMENSIONS\n", MAX_DIMS); return -1; }
-				dims[nd++] = (int)parse_rel(&lx); /* sizes; zero-based indexing for elements */
-				if (lx.cur.type == T_COMMA) { lx_next(&lx); continue; }
-				else break;
-			}
-			if (lx.cur.type != T_RPAREN) { printf("ERROR: DIM missing ')'\n"); return -1; }
-			lx_next(&lx);
-			if (is_string_var_name(aname)) {
-				if (!sarray_dim(aname, nd, dims)) return -1;
-			}
-			else {
-				if (!array_dim(aname, nd, dims)) return -1;
-			}
-			if (lx.cur.type == T_COMMA) { /* DIM A(10),B$(2,2) */ continue; }
-			break;
+/* DEFINT letter list after the DEFINT token: A, B-D, ... Returns 0 or -1 (not reported). */
+int defint_letters(Lexer* lx, unsigned* letters) {
+	*letters = 0;
+	for (;;) {
+		int from, to;
+		lx_next(lx);
+		if (lx->cur.type != T_IDENT || lx->cur.len != 1) return -1;
+		from = to = toupper((unsigned char)lx->cur.text[0]);
+		lx_next(lx);
+		if (lx->cur.type == T_MINUS) {
+			lx_next(lx);
+			if (lx->cur.type != T_IDENT || lx->cur.len != 1) return -1;
+			to = toupper((unsigned char)lx->cur.text[0]);
+			lx_next(lx);
 		}
-		return 0;
+		if (from < 'A' || to > 'Z' || from > to) return -1;
+		for (; from <= to; from++) *letters |= 1u << (from - 'A');
+		if (lx->cur.type != T_COMMA) break;
 	}
+	return lx->cur.type == T_END ? 0 : -1;
+}
 
-	if (lx.cur.type == T_RESTORE) {
-		lx_next(&lx);
-		data_maybe_rebuild();   /* if never built or program changed, build now */
+/* DEFINT: variables and arrays whose names start with these letters are created as
+   integers (prog_link applies the program's DEFINT lines before RUN starts) */
+static int st_defint(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	unsigned letters;
+	if (defint_letters(lx, &letters) < 0) { printf("ERROR: DEFINT expects letters, e.g. DEFINT I-N\n"); return -1; }
+	g_defint |= letters;
+	return 0;
+}
 
-		if (lx.cur.type == T_NUMBER) {
-			int ln = (int)lx.cur.number;
-			lx_next(&lx);
-			data_restore_at_line(ln);
-		}
-		else {
-			data_restore();
+/* DIM (numeric + string arrays) */
+static int st_dim(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	for (;;) {
+		char aname[32]; int dims[MAX_DIMS]; int nd = 0;
+		lx_next(lx);
+		if (lx->cur.type != T_IDENT) { printf("ERROR: DIM needs name\n"); return -1; }
+		strncpy(aname, lx->cur.text, sizeof(aname) - 1); aname[sizeof(aname) - 1] = 0;
+		lx_next(lx);
+		if (lx->cur.type != T_LPAREN) { printf("ERROR: DIM needs '('\n"); return -1; }
+		lx_next(lx);
+		while (lx->cur.type != T_RPAREN && lx->cur.type != T_END) {
+			if (nd >= MAX_DIMS) { printf("ERROR: > %d DIMENSIONS\n", MAX_DIMS); return -1; }
+			dims[nd++] = (int)parse_rel(lx); /* sizes; zero-based indexing for elements */
+			if (lx->cur.type == T_COMMA) { lx_next(lx); continue; }
+			else break;
 		}
-		return 0;
+		if (lx->cur.type != T_RPAREN) { printf("ERROR: DIM missing ')'\n"); return -1; }
+		lx_next(lx);
+		if (dim_array(aname, nd, dims) < 0) return -1;
+		if (lx->cur.type == T_COMMA) { /* DIM A(10),B$(2,2) */ continue; }
+		break;
 	}
+	return 0;
+}
 
-	if (lx.cur.type == T_READ)
-	{
-		/* Lazily build DATA pool on first READ */
-		data_maybe_rebuild();   /* if never built or program changed, build now */
-
-		for (;;) {
-			lx_next(&lx);
-			if (lx.cur.type != T_IDENT) { printf("ERROR: READ needs variable\n"); return -1; }
-
-			/* capture name and whether string */
-			char name[32]; int isStr = is_string_var_name(lx.cur.text);
-			strncpy(name, lx.cur.text, sizeof(name) - 1); name[sizeof(name) - 1] = 0;
-			lx_next(&lx);
-
-			/* Array element? */
-			if (lx.cur.type == T_LPAREN) {
-				int subs[MAX_DIMS], nsubs = 0;
-				lx_next(&lx);
-				while (lx.cur.type != T_RPAREN && lx.cur.type != T_END) {
-					if (nsubs >= MAX_DIMS) { printf("ERROR: TOO MANY SUBSCRIPTS\n"); return -1; }
-					subs[nsubs++] = (int)parse_rel(&lx);
-					if (lx.cur.type == T_COMMA) { lx_next(&lx); continue; }
-					else break;
-				}
-				if (lx.cur.type != T_RPAREN) { printf("ERROR: missing ')'\n"); return -1; }
-				lx_next(&lx);
-
-				if (isStr) {
-					SArray* sa = sarray_find(name);
-					if (!sa) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
-					sarray_set(sa, subs, nsubs, data_next_string());
-				}
-				else {
-					Array* a = array_find(name);
-					if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
-					array_set(a, subs, nsubs, data_next_number());
-				}
-			}
-			else {
-				/* scalar */
-				if (isStr) {
-					Variable* v = ensure_var(name, 1);
-					if (!v) return -1;
-					if (v->str) { free(v->str); v->str = NULL; }
-					v->str = strdup_c(data_next_string());
-				}
-				else {
-					ensure_var(name, 0)->num = data_next_number();
-				}
-			}
-
-			/* More variables? READ A,B$,C(1) */
-			if (lx.cur.type == T_COMMA) continue;
-			break;
-		}
-		return 0;
+static int st_restore(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	lx_next(lx);
+	if (lx->cur.type == T_NUMBER) {
+		int ln = (int)lx->cur.number;
+		lx_next(lx);
+		restore_data(ln);
+	}
+	else {
+		restore_data(-1);
 	}
+	return 0;
+}
 
-	/* Handle assignment to variable or array element */
-	if (lx.cur.type == T_LET) lx_next(&lx);
+static int st_read(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	/* Lazily build DATA pool on first READ */
+	data_maybe_rebuild();   /* if never built or program changed, build now */
+
+	for (;;) {
+		lx_next(lx);
+		if (lx->cur.type != T_IDENT) { printf("ERROR: READ needs variable\n"); return -1; }
 
-	if (lx.cur.type == T_IDENT) {
-		int isStr; char name[32]; strncpy(name, lx.cur.text, sizeof(name) - 1); name[sizeof(name) - 1] = 0; isStr = is_string_var_name(name);
-		lx_next(&lx);
+		/* capture name */
+		char name[32];
+		strncpy(name, lx->cur.text, sizeof(name) - 1); name[sizeof(name) - 1] = 0;
+		lx_next(lx);
 
-		/* Array element assignment: NAME '(' subs ')' '=' expr/string */
-		if (lx.cur.type == T_LPAREN) {
+		/* Array element? */
+		if (lx->cur.type == T_LPAREN) {
 			int subs[MAX_DIMS], nsubs = 0;
-			lx_next(&lx);
-			while (lx.cur.type != T_RPAREN && lx.cur.type != T_END) {
+			lx_next(lx);
+			while (lx->cur.type != T_RPAREN && lx->cur.type != T_END) {
 				if (nsubs >= MAX_DIMS) { printf("ERROR: TOO MANY SUBSCRIPTS\n"); return -1; }
-				subs[nsubs++] = (int)parse_rel(&lx);
-				if (lx.cur.type == T_COMMA) { lx_next(&lx); continue; }
+				subs[nsubs++] = (int)parse_rel(lx);
+				if (lx->cur.type == T_COMMA) { lx_next(lx); continue; }
 				else break;
 			}
-			if (lx.cur.type != T_RPAREN) { printf("ERROR: missing ')'\n"); return -1; }
-			lx_next(&lx);
-			if (lx.cur.type != T_EQ) { printf("ERROR: '=' expected\n"); return -1; }
-			lx_next(&lx);
-
-			if (isStr) {
-				/* RHS: string literal, scalar string var, or string array elem */
-				if (lx.cur.type == T_STRING) {
-					SArray* sa = sarray_find(name);
-					if (!sa) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
-					sarray_set(sa, subs, nsubs, lx.cur.text); lx_next(&lx);
-				}
-				else if (lx.cur.type == T_IDENT && is_string_var_name(lx.cur.text)) {
-					char srcname[32]; strncpy(srcname, lx.cur.text, sizeof(srcname) - 1); srcname[sizeof(srcname) - 1] = 0; lx_next(&lx);
-					if (_stricmp(srcname, "CHR$") == 0) {
-						if (lx.cur.type == T_LPAREN) { lx_next(&lx); }
-						{
-							double v = parse_rel(&lx); char ch[2]; ch[0] = (char)((int)v); ch[1] = 0;
-							SArray* sa = sarray_find(name); if (!sa) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
-							sarray_set(sa, subs, nsubs, ch);
-						}
-						if (lx.cur.type == T_RPAREN) lx_next(&lx);
-
-					}
-					else if (_stricmp(srcname, "STR$") == 0)
-					{
-						if (lx.cur.type == T_LPAREN) { lx_next(&lx); }
-						{
-							double v = parse_rel(&lx); char buf[64];
-#ifdef _MSC_VER
-							_snprintf(buf, sizeof(buf), "%.15g", v);
-#else
-							snprintf(buf, sizeof(buf), "%.15g", v);
-#endif
-							SArray* sa = sarray_find(name); if (!sa) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
-							sarray_set(sa, subs, nsubs, buf);
-						}
-						if (lx.cur.type == T_RPAREN) lx_next(&lx);
-					}
-					else if (_stricmp(srcname, "SEG$") == 0) {
-						if (lx.cur.type == T_LPAREN) { lx_next(&lx); }
-						{
-							const char* s = ""; int start = 1, len = 0;
-							if (lx.cur.type == T_STRING) { s = lx.cur.text; lx_next(&lx); }
-							else if (lx.cur.type == T_IDENT && is_string_var_name(lx.cur.text)) {
-								Variable* v = find_var(lx.cur.text); s = (v && v->type == VT_STR && v->str) ? v->str : ""; lx_next(&lx);
-							}
-							if (lx.cur.type == T_COMMA) { lx_next(&lx); start = (int)parse_rel(&lx); }
-							if (lx.cur.type == T_COMMA) { lx_next(&lx); len = (int)parse_rel(&lx); }
-							if (lx.cur.type == T_RPAREN) lx_next(&lx);
-							{
-								int sl = (int)strlen(s), i0 = start < 1 ? 0 : start - 1; if (i0 > sl) i0 = sl; int l = len; if (l < 0) l = 0; if (i0 + l > sl) l = sl - i0;
-								char tmp[1024]; if (l > (int)sizeof(tmp) - 1) l = (int)sizeof(tmp) - 1; memcpy(tmp, s + i0, l); tmp[l] = 0;
-								SArray* sa = sarray_find(name); if (!sa) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
-								sarray_set(sa, subs, nsubs, tmp);
-							}
-						}
-					}
-					else if (_stricmp(srcname, "TRM$") == 0) {
-						if (lx.cur.type == T_LPAREN) { lx_next(&lx); }
-						{
-							const char* s = ""; if (lx.cur.type == T_STRING) { s = lx.cur.text; lx_next(&lx); }
-							else if (lx.cur.type == T_IDENT && is_string_var_name(lx.cur.text)) {
-								Variable* v = find_var(lx.cur.text); s = (v && v->type == VT_STR && v->str) ? v->str : ""; lx_next(&lx);
-							}
-							if (lx.cur.type == T_RPAREN) lx_next(&lx);
-							{
-								size_t n = strlen(s), a = 0, b = n; while (a < b && isspace((unsigned char)s[a]))a++; while (b > a && isspace((unsigned char)s[b - 1]))b--;
-								char tmp[1024]; size_t l = b - a; if (l > sizeof(tmp) - 1) l = sizeof(tmp) - 1; memcpy(tmp, s + a, l); tmp[l] = 0;
-								SArray* sa = sarray_find(name); if (!sa) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
-								sarray_set(sa, subs, nsubs, tmp);
-							}
-						}
-					}
-
-					else if (lx.cur.type == T_LPAREN) {
-						int s2[MAX_DIMS], n2 = 0;
-						lx_next(&lx);
-						while (lx.cur.type != T_RPAREN && lx.cur.type != T_END) {
-							if (n2 >= MAX_DIMS) { printf("ERROR: TOO MANY SUBSCRIPTS\n"); return -1; }
-							s2[n2++] = (int)parse_rel(&lx);
-							if (lx.cur.type == T_COMMA) { lx_next(&lx); continue; }
-							else break;
-						}
-						if (lx.cur.type != T_RPAREN) { printf("ERROR: missing ')'\n"); return -1; }
-						lx_next(&lx);
-						{
-							SArray* sb = sarray_find(srcname); const char* sval = sb ? sarray_get(sb, s2, n2) : "";
-							SArray* sa = sarray_find(name); if (!sa) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
-							sarray_set(sa, subs, nsubs, sval);
-						}
-					}
-					else {
-						/* source is scalar string var */
-						Variable* sv = find_var(srcname); const char* sval = (sv && sv->type == VT_STR && sv->str) ? sv->str : "";
-						SArray* sa = sarray_find(name); if (!sa) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
-						sarray_set(sa, subs, nsubs, sval);
-					}
-				}
-
-				else {
-					printf("ERROR: string array assignment needs a string\n"); return -1;
-				}
-			}
-			else {
-				double vnum = parse_rel(&lx);
-				{
-					Array* a = array_find(name); if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
-					array_set(a, subs, nsubs, vnum);
-				}
-			}
-			return 0;
+			if (lx->cur.type != T_RPAREN) { printf("ERROR: missing ')'\n"); return -1; }
+			lx_next(lx);
+			if (read_into(name, subs, nsubs) < 0) return -1;
+		}
+		else {
+			/* scalar */
+			if (read_into(name, NULL, -1) < 0) return -1;
 		}
 
-		/* Scalar assignment */
-		if (lx.cur.type != T_EQ) { printf("ERROR: '=' expected at line %d\n", currentLine); return -1; }
-		lx_next(&lx);
+		/* More variables? READ A,B$,C(1) */
+		if (lx->cur.type == T_COMMA) continue;
+		break;
+	}
+	return 0;
+}
+
+/* assignment to variable or array element */
+static int st_assign(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	int isStr; char name[32]; strncpy(name, lx->cur.text, sizeof(name) - 1); name[sizeof(name) - 1] = 0; isStr = is_string_var_name(name);
+	CrunchTok* site = lx_site(lx);
+	lx_next(lx);
+
+	/* Array element assignment: NAME '(' subs ')' '=' expr/string */
+	if (lx->cur.type == T_LPAREN) {
+		int subs[MAX_DIMS], nsubs = 0;
+		lx_next(lx);
+		while (lx->cur.type != T_RPAREN && lx->cur.type != T_END) {
+			if (nsubs >= MAX_DIMS) { printf("ERROR: TOO MANY SUBSCRIPTS\n"); return -1; }
+			subs[nsubs++] = (int)parse_rel(lx);
+			if (lx->cur.type == T_COMMA) { lx_next(lx); continue; }
+			else break;
+		}
+		if (lx->cur.type != T_RPAREN) { printf("ERROR: missing ')'\n"); return -1; }
+		lx_next(lx);
+		if (lx->cur.type != T_EQ) { printf("ERROR: '=' expected\n"); return -1; }
+		lx_next(lx);
 
 		if (isStr) {
-			if (lx.cur.type == T_STRING)
+			Value sv; SArray* sa;
+			parse_value(lx, &sv);
+			if (!sv.str) { val_free(&sv); printf("ERROR: string array assignment needs a string\n"); return -1; }
+			sa = sarray_find_at(site, name);
+			if (!sa) { val_free(&sv); printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
+			store_str_elem(sa, subs, nsubs, &sv);
+			val_free(&sv);
+		}
+		else {
+			BasInt ival; double vnum;
+			int exact = parse_int(lx, &ival, &vnum);
 			{
-				Variable* v = ensure_var(name, 1);
-				if (!v) return -1;
-				if (v->str) free(v->str); v->str = strdup_c(lx.cur.text); lx_next(&lx);
+				Array* a = array_find_at(site, name); if (!a) { printf("ERROR: UNDIM'D ARRAY %s\n", name); return -1; }
+				if (exact) array_set_int(a, subs, nsubs, ival);
+				else array_set(a, subs, nsubs, vnum);
 			}
-			else if (lx.cur.type == T_IDENT && is_string_var_name(lx.cur.text)) {
-				char sname[32]; strncpy(sname, lx.cur.text, sizeof(sname) - 1); sname[sizeof(sname) - 1] = 0; lx_next(&lx);
-				if (_stricmp(sname, "CHR$") == 0) {
-					if (lx.cur.type == T_LPAREN) { lx_next(&lx); }
-					{
-						double v = parse_rel(&lx); char ch[2]; ch[0] = (char)((int)v); ch[1] = 0;
-						Variable* dst = ensure_var(name, 1); if (dst->str) free(dst->str); dst->str = strdup_c(ch);
-					}
-					if (lx.cur.type == T_RPAREN) lx_next(&lx);
-				}
-				else if (_stricmp(sname, "STR$") == 0) {
-					if (lx.cur.type == T_LPAREN) { lx_next(&lx); }
-					{
-						double v = parse_rel(&lx); char buf[64];
-#ifdef _MSCVER
-						_snprintf(buf, sizeof(buf), "%.15g", v);
-#else
-						snprintf(buf, sizeof(buf), "%.15g", v);
-#endif
-						Variable* dst = ensure_var(name, 1); if (dst->str) free(dst->str); dst->str = strdup_c(buf);
-					}
-					if (lx.cur.type == T_RPAREN) lx_next(&lx);
-				}
-				else if (_stricmp(sname, "SEG$") == 0) {
-					if (lx.cur.type == T_LPAREN) { lx_next(&lx); }
-					{
-						const char* s = ""; int start = 1, len = 0;
-						if (lx.cur.type == T_STRING) { s = lx.cur.text; lx_next(&lx); }
-						else if (lx.cur.type == T_IDENT && is_string_var_name(lx.cur.text)) {
-							Variable* v = find_var(lx.cur.text); s = (v && v->type == VT_STR && v->str) ? v->str : ""; lx_next(&lx);
-						}
-						if (lx.cur.type == T_COMMA) { lx_next(&lx); start = (int)parse_rel(&lx); }
-						if (lx.cur.type == T_COMMA) { lx_next(&lx); len = (int)parse_rel(&lx); }
-						if (lx.cur.type == T_RPAREN) lx_next(&lx);
-						{
-							int sl = (int)strlen(s), i0 = start < 1 ? 0 : start - 1; if (i0 > sl) i0 = sl; int l = len; if (l < 0) l = 0; if (i0 + l > sl) l = sl - i0;
-							char tmp[1024]; if (l > (int)sizeof(tmp) - 1) l = (int)sizeof(tmp) - 1; memcpy(tmp, s + i0, l); tmp[l] = 0;
-							Variable* dst = ensure_var(name, 1); if (dst->str) free(dst->str); dst->str = strdup_c(tmp);
-						}
-					}
-				}
-				else if (_stricmp(sname, "TRM$") == 0) {
-					if (lx.cur.type == T_LPAREN) { lx_next(&lx); }
-					{
-						const char* s = ""; if (lx.cur.type == T_STRING) { s = lx.cur.text; lx_next(&lx); }
-						else if (lx.cur.type == T_IDENT && is_string_var_name(lx.cur.text)) {
-							Variable* v = find_var(lx.cur.text); s = (v && v->type == VT_STR && v->str) ? v->str : ""; lx_next(&lx);
-						}
-						if (lx.cur.type == T_RPAREN) lx_next(&lx);
-						{
-							size_t n = strlen(s), a = 0, b = n; while (a < b && isspace((unsigned char)s[a]))a++; while (b > a && isspace((unsigned char)s[b - 1]))b--;
-							char tmp[1024]; size_t l = b - a; if (l > sizeof(tmp) - 1) l = sizeof(tmp) - 1; memcpy(tmp, s + a, l); tmp[l] = 0;
-							Variable* dst = ensure_var(name, 1); if (dst->str) free(dst->str); dst->str = strdup_c(tmp);
-						}
-					}
-				}
-
-				else if (lx.cur.type == T_LPAREN) {
-					int s2[MAX_DIMS], n2 = 0;
-					lx_next(&lx);
-					while (lx.cur.type != T_RPAREN && lx.cur.type != T_END) {
-						if (n2 >= MAX_DIMS) { printf("ERROR: TOO MANY SUBSCRIPTS\n"); return -1; }
-						s2[n2++] = (int)parse_rel(&lx);
-						if (lx.cur.type == T_COMMA) { lx_next(&lx); continue; }
-						else break;
-					}
-					if (lx.cur.type != T_RPAREN) { printf("ERROR: missing ')'\n"); return -1; }
-					lx_next(&lx);
-					{
-						SArray* sb = sarray_find(sname); const char* sval = sb ? sarray_get(sb, s2, n2) : "";
-						Variable* dst = ensure_var(name, 1); if (dst->str) free(dst->str); dst->str = strdup_c(sval);
-					}
-				}
-				else {
-					Variable* sv = find_var(sname); const char* sval = (sv && sv->type == VT_STR && sv->str) ? sv->str : "";
-					Variable* dst = ensure_var(name, 1); if (dst->str) free(dst->str); dst->str = strdup_c(sval);
-				}
-			}
-			else { printf("ERROR: string assignment needs a string\n"); return -1; }
 		}
-		else { double vnum = parse_rel(&lx); ensure_var(name, 0)->num = vnum; }
 		return 0;
 	}
 
+	/* Scalar assignment */
+	if (lx->cur.type != T_EQ) { printf("ERROR: '=' expected at line %d\n", currentLine); return -1; }
+	lx_next(lx);
+
+	if (isStr) {
+		Value sv; int v;
+		parse_value(lx, &sv);
+		if (!sv.str) { val_free(&sv); printf("ERROR: string assignment needs a string\n"); return -1; }
+		v = ensure_var_at(site, name, 1);
+		if (v >= 0) store_str_var(v, &sv);
+		val_free(&sv);
+		if (v < 0) return -1;
+	}
+	else {
+		BasInt ival; double vnum;
+		int exact = parse_int(lx, &ival, &vnum);
+		int v = ensure_var_at(site, name, 0);
+		if (v < 0) { printf("ERROR: VARIABLE TABLE FULL\n"); return -1; }
+		if (exact) var_set_int(v, ival);
+		else if (var_set_num(v, vnum) < 0) return -1;
+	}
+	return 0;
+}
+
+/* no handler for the first token */
+static int st_syntax(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
 	if (!duringRun) { printf("ERROR: syntax\n"); return -1; }
-	printf("ERROR: syntax at line %d\n", currentLine); return -1;
+	printf("ERROR: syntax at line %d\n", currentLine);
+	return -1;
+}
+
+static int st_let(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	lx_next(lx);
+	if (lx->cur.type == T_IDENT) return st_assign(lx, duringRun, currentLine, outJump);
+	return st_syntax(lx, duringRun, currentLine, outJump);
+}
+
+/* ----------------- statement dispatch -----------------
+   One handler per statement keyword, indexed by the first token; see stmt_register. */
+static StmtHandler g_stmt_handlers[T__COUNT] = {
+	[T_REM] = st_ignore, [T_DATA] = st_ignore,
+	[T_BYE] = st_bye, [T_NEW] = st_new, [T_ONKW] = st_on, [T_HELP] = st_help, [T_DUMP] = st_dump,
+	[T_LIST] = st_list, [T_SAVE] = st_save_load, [T_LOAD] = st_save_load,
+	[T_SAVEVARS] = st_save_load_vars, [T_LOADVARS] = st_save_load_vars,
+	[T_OPEN] = st_open, [T_CLOSE] = st_close,
+	[T_RUN] = st_run, [T_ENDKW] = st_end, [T_STOP] = st_end, [T_QUIT] = st_quit, [T_RENUM] = st_renum,
+	[T_PRINT] = st_print, [T_IF] = st_if,
+	[T_GOTO] = st_goto, [T_GOSUB] = st_gosub, [T_RETURN] = st_return,
+	[T_FOR] = st_for, [T_NEXT] = st_next, [T_TRACE] = st_trace,
+	[T_DIM] = st_dim, [T_RESTORE] = st_restore, [T_READ] = st_read,
+	[T_LET] = st_let, [T_IDENT] = st_assign, [T_DEFINT] = st_defint,
+};
+
+StmtHandler stmt_register(TokType t, StmtHandler h)
+{
+	StmtHandler old;
+	if ((unsigned)t >= T__COUNT) return NULL;
+	old = g_stmt_handlers[t];
+	g_stmt_handlers[t] = h;
+	return old;
+}
 
+/* ----------------- executor ----------------- */
+int exec_statement(const char* src, int duringRun, int currentLine, int* outJump)
+{
+	/* crunched first, so handlers always see NUL-terminated token texts */
+	CrunchLine* cl = crunch_line(src);
+	Lexer lx;
+	int r;
+	if (!cl) return -1;
+	if (cl->nseg > 0) lx_init_crunched(&lx, cl, 0); else lx_init(&lx, "");
+	lx_next(&lx);
+	r = exec_statement_lx(&lx, duringRun, currentLine, outJump);
+	crunch_free(cl);
+	return r;
 }
 
+/* Same as exec_statement, but the lexer is already positioned on the first token
+   (text or crunched stream, see lx_init_crunched). */
+int exec_statement_lx(Lexer* lx, int duringRun, int currentLine, int* outJump)
+{
+	StmtHandler h = (unsigned)lx->cur.type < T__COUNT ? g_stmt_handlers[lx->cur.type] : NULL;
+	if (!h) h = st_syntax;
+	return h(lx, duringRun, currentLine, outJump);
+}
@@ -8,6 +8,38 @@ extern "C" {
 #endif
 
 int exec_statement(const char *src, int duringRun, int currentLine, int *outJump);
+int exec_statement_lx(Lexer *lx, int duringRun, int currentLine, int *outJump);
+
+/* Statement dispatch: exec_statement_lx calls the handler registered for the first
+   token (same arguments and return codes). stmt_register installs one and returns the
+   previous handler, or NULL; tokens without a handler are a syntax error. */
+typedef int (*StmtHandler)(Lexer *lx, int duringRun, int currentLine, int *outJump);
+StmtHandler stmt_register(TokType t, StmtHandler h);
+
+/* IF branch executor: THEN/ELSE <line> | GOTO | GOSUB | PRINT | assignment */
+int run_if_single_stmt(Lexer *lx, int currentLine, int *outJump);
+
+/* FOR/NEXT and GOSUB stack primitives; frames hold the PC of the statement after the
+   FOR/GOSUB that is running (g_pc_index, g_pc_seg) */
+int gosub_push(int currentLine);
+int gosub_return(int *outJump);
+int for_push(const char *vname, double start, double toVal, double step, int currentLine);
+int for_next(const char *vname, int *outJump);
+int for_int_bounds(double toVal, double step, BasInt *iend, BasInt *istep);   /* integer loop variable */
+int for_int_next(BasInt *var, BasInt iend, BasInt istep);                    /* 1 again, 0 done, -1 */
+
+/* Statement primitives shared by the interpreter and the compiled engines */
+int  on_jump(int n, int isGosub, const int *lines, int count, int currentLine, int *outJump);
+int  dim_array(const char *name, int nd, int *dims);
+int  read_into(const char *name, int *subs, int nsubs);   /* nsubs < 0: scalar */
+int  defint_letters(Lexer *lx, unsigned *letters);        /* on T_DEFINT; 0 or -1 */
+void restore_data(int line);                              /* line < 0: from the top */
+int  open_file(const char *fname, int mode, int handle);  /* mode 0 INPUT, 1 OUTPUT, 2 APPEND */
+void close_file(int handle);                              /* handle < 0: all */
+
+/* DATA pool readers used by READ */
+const char *data_next_string(void);
+double      data_next_number(void);
 
 #ifdef __cplusplus
 }